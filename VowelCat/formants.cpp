@@ -20,46 +20,68 @@ Formants::Formants(audio_t *a, sound_t *s):
     formant_opts_init(&opts);
     opts.pre_emph_factor = 1;
     opts.window_type = WINDOW_TYPE_HAMMING;
+    // Let the tracker look a few frames ahead before settling on formants,
+    // rather than deciding each chunk on its own.
+    opts.max_lag = 0.04;
+    // Follow the speaker's F0, so higher voices have their formants looked
+    // for higher up.
+    opts.adapt_ranges = true;
+    // Skip the analysis of frames of silence and noise, which is most of them
+    // while idly listening.
+    opts.vad = true;
+    opts.vad_floor = NOISE_RMS;
 
     if (!formant_opts_process(&opts))
         abort();
-}
-
-#define ABS(x) ((x) > 0 ? (x) : -(x))
-
-bool Formants::is_noise() {
-    enum { NOISE_STRIDE = SAMPLES_PER_CHUNK / NOISE_SAMPLES };
-    uintmax_t avg = 0;
 
-    for (size_t i = 0; i < sound->n_samples; i += NOISE_STRIDE)
-        avg += ABS(sound->samples[i]);
+    formant_workspace_init(&ws);
+    tracker = formant_tracker_new(&opts, SAMPLE_RATE);
 
-    return avg < NOISE_THRESHOLD * NOISE_SAMPLES;
+    if (!tracker)
+        abort();
 }
 
-bool Formants::calc() {
-    if (is_noise())
-        return false;
+Formants::~Formants() {
+    formant_tracker_destroy(tracker);
+    formant_workspace_destroy(&ws);
+}
 
-    if (!sound_calc_formants(sound, &opts))
-        abort();
+bool Formants::average(const formant_frame_t *frames, size_t n) {
+    size_t voiced = 0;
 
     f1 = 0;
+    f2 = 0;
 
-    for (size_t i = 0; i < sound->n_samples; i += 1)
-        f1 += sound_get_f1(sound, i);
+    for (size_t i = 0; i < n; i += 1) {
+        if (!frames[i].voiced)
+            continue;
 
-    f2 = 0;
+        f1 += frames[i].freq[0];
+        f2 += frames[i].freq[1];
+        voiced += 1;
+    }
 
-    for (size_t i = 0; i < sound->n_samples; i += 1)
-        f2 += sound_get_f2(sound, i);
+    if (!voiced)
+        return false;
 
-    f1 /= sound->n_samples;
-    f2 /= sound->n_samples;
+    f1 /= voiced;
+    f2 /= voiced;
 
     return f1 >= F1_MIN && f1 <= F1_MAX && f2 >= F2_MIN && f2 <= F2_MAX;
 }
 
+bool Formants::calc() {
+    chunk_frames.resize(sound_count_frames(sound, &opts));
+
+    if (chunk_frames.empty())
+        return false;
+
+    if (!sound_calc_frames(sound, &opts, &ws, chunk_frames.data()))
+        abort();
+
+    return average(chunk_frames.data(), chunk_frames.size());
+}
+
 bool Formants::calc(size_t offset) {
     reset();
 
@@ -69,6 +91,55 @@ bool Formants::calc(size_t offset) {
     return calc();
 }
 
+bool Formants::calc_frames(size_t offset, size_t n,
+                           std::vector<formant_frame_t> *frames)
+{
+    sound_reset(sound, SAMPLE_RATE, CHANNELS);
+    sound_load_samples(sound, &audio->prbuf[offset], n);
+
+    frames->resize(sound_count_frames(sound, &opts));
+
+    if (frames->empty())
+        return false;
+
+    if (!sound_calc_frames(sound, &opts, &ws, frames->data()))
+        abort();
+
+    return true;
+}
+
+double Formants::frame_dur() const {
+    return opts.frame_dur;
+}
+
+double Formants::frame_center() const {
+    return opts.window_dur / 2;
+}
+
+void Formants::restart() {
+    formant_tracker_reset(tracker);
+}
+
+bool Formants::track() {
+    const formant_frame_t *frames;
+    size_t n;
+
+    // Always feed the tracker so its state stays continuous, even through
+    // chunks that end up being ignored.
+    n = formant_tracker_push(tracker, sound->samples, sound->n_samples,
+                             &frames);
+
+    return average(frames, n);
+}
+
+const formant_stats_t *Formants::calc_stats() const {
+    return &ws.stats;
+}
+
+const formant_stats_t *Formants::track_stats() const {
+    return formant_tracker_stats(tracker);
+}
+
 void Formants::reset() {
     sound_reset(sound, SAMPLE_RATE, CHANNELS);
     sound_resize(sound, SAMPLES_PER_CHUNK);
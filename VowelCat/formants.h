@@ -7,6 +7,8 @@
 #include <assert.h>
 #include <inttypes.h>
 
+#include <vector>
+
 extern "C" {
 #include "audio.h"
 #include "formant.h"
@@ -19,15 +21,17 @@ private:
     audio_t *audio;
     sound_t *sound;
     formant_opts_t opts;
+    // Scratch memory reused across calls to calc.
+    formant_workspace_t ws;
+    // Tracker for audio that arrives as a continuous stream.
+    formant_tracker_t *tracker;
 
-    // Number of samples to take into account when checking for noise.
-    static const uint32_t NOISE_SAMPLES = 4;
-    // If recorded samples have an average value less than this, then consider
-    // them noise.
-    static const uint32_t NOISE_THRESHOLD = 100;
+    // Frames of the last call to calc.
+    std::vector<formant_frame_t> chunk_frames;
 
-    static_assert(NOISE_SAMPLES > 0 && NOISE_SAMPLES < SAMPLES_PER_CHUNK,
-                  "NOISE_SAMPLES is within bounds");
+    // If a frame has an RMS amplitude less than this, then consider it
+    // silence.
+    static constexpr double NOISE_RMS = 125;
 
 public:
     // Store these as unsigned since they are calculated as averages and may
@@ -35,16 +39,47 @@ public:
     uintmax_t f1, f2;
 
     Formants(audio_t *a, sound_t *s);
+    ~Formants();
 
     void reset();
     bool calc();
 
-    // Get the F1 and F2 values at the given sample offset. Return true if the
-    // chunk is valid audio and false if it's noise.
+    // Get the F1 and F2 values at the given sample offset, averaged over the
+    // voiced frames of the chunk there. Return true if the chunk is valid
+    // audio and false if it's noise.
     bool calc(size_t offset);
 
+    // Analyse the n samples of the recording starting at the given offset in a
+    // single pass and store every frame found, with its bandwidths, level,
+    // cost, and voicing, in frames. Return false if there's too little audio
+    // for a single frame.
+    bool calc_frames(size_t offset, size_t n,
+                     std::vector<formant_frame_t> *frames);
+
+    // Get the duration in seconds of the frames stored by calc_frames, and
+    // the time from the start of each frame to its center.
+    double frame_dur() const;
+    double frame_center() const;
+
+    // Forget the stream fed to track so far. Call this whenever the audio
+    // source changes.
+    void restart();
+
+    // Feed the current chunk to the streaming tracker and get the average F1
+    // and F2 values of the voiced frames it decides, which trail the chunk by
+    // up to 40ms. Return true if the chunk is valid audio and false if it's
+    // noise.
+    bool track();
+
+    // Get the stats of the last call to calc or track. They're only kept when
+    // libformant is built with STATS=1.
+    const formant_stats_t *calc_stats() const;
+    const formant_stats_t *track_stats() const;
+
 private:
-    bool is_noise();
+    // Average F1 and F2 over the voiced frames among the n at frames. Return
+    // false if there are none or the averages are out of range.
+    bool average(const formant_frame_t *frames, size_t n);
 };
 
 #endif
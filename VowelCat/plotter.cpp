@@ -30,6 +30,8 @@ void Plotter::listen_run() {
     if (!audio_record(audio))
         abort();
 
+    formants->restart();
+
     while(run) {
         formants->reset();
 
@@ -38,7 +40,7 @@ void Plotter::listen_run() {
             break;
         //***********************
 
-        if(!formants->calc())
+        if(!formants->track())
            continue;
 
         emit newFormant(formants->f1, formants->f2);
@@ -49,6 +51,8 @@ void Plotter::record_run() {
     if (!audio_record(audio))
         abort();
 
+    formants->restart();
+
     while(run) { //Pa_IsStreamActive does not seem to work quick enough
         formants->reset();
 
@@ -59,7 +63,7 @@ void Plotter::record_run() {
 
         emit newSamples(audio->prbuf_offset - audio->samples_per_chunk);
 
-        if(!formants->calc())
+        if(!formants->track())
             continue;
 
         emit newFormant(formants->f1, formants->f2);
@@ -70,6 +74,8 @@ void Plotter::play_run() {
     if (!audio_play(audio))
         abort();
 
+    formants->restart();
+
     while(run) { //Pa_IsStreamActive does not seem to work quick enough
         formants->reset();
 
@@ -80,7 +86,7 @@ void Plotter::play_run() {
 
         emit newSamples(audio->prbuf_offset - audio->samples_per_chunk);
 
-        if(!formants->calc())
+        if(!formants->track())
             continue;
 
         emit newFormant(formants->f1, formants->f2);
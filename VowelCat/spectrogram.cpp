@@ -19,6 +19,7 @@ Spectrogram::Spectrogram(audio_t *audio):
     QWidget(NULL),
     audio(audio),
     formants(audio, &sound),
+    rms_max(0),
     prev(0),
     pos(0)
 {
@@ -75,15 +76,86 @@ void Spectrogram::update(size_t offset) {
     QWidget::update(pos, 0, PIXELS_PER_CHUNK, height());
 }
 
+void Spectrogram::analyse() {
+    size_t start = columns.size() * SAMPLES_PER_CHUNK;
+    size_t n;
+
+    // The recording was replaced without a reset.
+    if (audio->prbuf_size < start) {
+        columns.clear();
+        rms_max = 0;
+        start = 0;
+    }
+
+    n = (audio->prbuf_size - start) / SAMPLES_PER_CHUNK * SAMPLES_PER_CHUNK;
+
+    if (!n)
+        return;
+
+    // Analyse everything new at once, so painting never has to analyse a
+    // chunk again and the tracker sees the chunks in context.
+    if (!formants.calc_frames(start, n, &frames)) {
+        columns.resize(columns.size() + n / SAMPLES_PER_CHUNK, Column());
+        return;
+    }
+
+    for (size_t c = 0; c < n / SAMPLES_PER_CHUNK; c += 1) {
+        // Take the frames centered within the chunk.
+        double l = (double)c * SAMPLES_PER_CHUNK / SAMPLE_RATE -
+                   formants.frame_center();
+        double r = l + (double)SAMPLES_PER_CHUNK / SAMPLE_RATE;
+        size_t first = MAX(0, ceil(l / formants.frame_dur()));
+        size_t last = MAX(0, ceil(r / formants.frame_dur()));
+
+        columns.push_back(summarize(MIN(first, frames.size()),
+                                    MIN(last, frames.size())));
+        rms_max = MAX(rms_max, columns.back().rms);
+    }
+}
+
+Spectrogram::Column Spectrogram::summarize(size_t first, size_t last) const {
+    Column col = Column();
+    double f1 = 0, f2 = 0, cost = 0;
+    size_t voiced = 0;
+
+    for (size_t i = first; i < last; i += 1) {
+        col.rms = MAX(col.rms, frames[i].rms);
+
+        if (!frames[i].voiced)
+            continue;
+
+        f1 += frames[i].freq[0];
+        f2 += frames[i].freq[1];
+        cost += frames[i].cost;
+        voiced += 1;
+    }
+
+    if (!voiced || voiced * 2 < last - first)
+        return col;
+
+    f1 /= voiced;
+    f2 /= voiced;
+
+    col.voiced = f1 >= F1_MIN && f1 <= F1_MAX && f2 >= F2_MIN && f2 <= F2_MAX;
+    col.f1 = f1;
+    col.f2 = f2;
+    col.fit = 1 / (1 + cost / voiced);
+
+    return col;
+}
+
 void Spectrogram::draw_chunk(QPainter *paint, int l, int r, int h) {
     // Convert a pixel offset to a bin index.
     auto pixel_to_freq = [=] (int p) -> formant_sample_t {
         return FREQ_START + p * FREQ_RANGE / h;
     };
 
-    size_t sample = pixel_to_offset(l);
+    size_t chunk = pixel_to_offset(l) / SAMPLES_PER_CHUNK;
+
+    if (chunk >= columns.size())
+        analyse();
 
-    if (audio->samples_per_chunk + sample > audio->prbuf_size || !formants.calc(sample)) {
+    if (chunk >= columns.size() || !columns[chunk].voiced) {
         paint->setPen(Qt::NoPen);
         paint->fillRect(l, 0, r - l + 1, h, QColor(BACKGROUND));
 
@@ -92,22 +164,25 @@ void Spectrogram::draw_chunk(QPainter *paint, int l, int r, int h) {
 
     for (int p = 1; p <= h; p += 1) {
         paint->setPen(QPen(QColor(freq_argb(pixel_to_freq(p),
-            formants.f1, formants.f2))));
+            columns[chunk]))));
         paint->drawLine(l, h - p, r, h - p);
     }
 }
 
-uint8_t Spectrogram::freq_byte(formant_sample_t dist) {
+uint8_t Spectrogram::freq_byte(formant_sample_t dist, double weight) {
     if (dist >= RADIUS)
         return GREY_MAX;
 
-    return GREY_MIN + GREY_RANGE * pow(dist, 1) / RADIUS;
+    return GREY_MAX - (GREY_RANGE - GREY_RANGE * pow(dist, 1) / RADIUS) *
+                      weight;
 }
 
-QRgb Spectrogram::freq_argb(formant_sample_t f, formant_sample_t f1,
-                            formant_sample_t f2)
-{
-    uint8_t byte = freq_byte(MIN(ABS(f - f1), ABS(f - f2)));
+QRgb Spectrogram::freq_argb(formant_sample_t f, const Column &col) const {
+    // Fade columns by how quiet they are and how poorly the formants fit.
+    double db = 20 * log10(col.rms / rms_max);
+    double level = MAX(0, 1 + db / LEVEL_RANGE);
+    uint8_t byte = freq_byte(MIN(ABS(f - col.f1), ABS(f - col.f2)),
+                             (.25 + .75 * level) * (.25 + .75 * col.fit));
 
     return ALPHA << 24 | byte << 16 | byte << 8 | byte;
 }
@@ -117,6 +192,8 @@ void Spectrogram::mouseReleaseEvent(QMouseEvent *event) {
 }
 
 void Spectrogram::reset() {
+    columns.clear();
+    rms_max = 0;
     prev = pos = 0;
     QWidget::update();
 }
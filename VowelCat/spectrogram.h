@@ -6,6 +6,8 @@
 
 #include <stdlib.h>
 
+#include <vector>
+
 #include <QPainter>
 #include <QWidget>
 
@@ -39,10 +41,32 @@ private:
 
     enum { RADIUS = 300 };
 
+    // Columns quieter than this many dB below the loudest are drawn faintest.
+    enum { LEVEL_RANGE = 30 };
+
+    // The formants found in one chunk of the recording.
+    struct Column {
+        // Whether most frames of the chunk were voiced.
+        bool voiced;
+        // Average F1 and F2 of the voiced frames.
+        formant_sample_t f1, f2;
+        // How well the formants fit, from 0 for not at all to 1.
+        double fit;
+        // RMS amplitude of the loudest frame.
+        double rms;
+    };
+
     audio_t *audio;
     sound_t sound;
     Formants formants;
 
+    // The columns of every whole chunk of the recording analysed so far, and
+    // the loudest frame among them.
+    std::vector<Column> columns;
+    double rms_max;
+    // Frames of the last analysis.
+    std::vector<formant_frame_t> frames;
+
     // The previous offset of the playback indicator.
     int prev;
     // Where the playback indicator should be drawn.
@@ -65,6 +89,11 @@ protected:
 private:
     void paintEvent(QPaintEvent *event);
 
+    // Analyse the chunks recorded since the last call into columns.
+    void analyse();
+    // Summarize the frames between first and last into a column.
+    Column summarize(size_t first, size_t last) const;
+
     void draw_chunk(QPainter *paint, int l, int r, int h);
     void update_pos(size_t offset);
 
@@ -73,11 +102,10 @@ private:
     // Convert a pixel offset to a sample offset.
     static size_t pixel_to_offset(int pixel);
 
-    // Create a shade of grey for the given bin amplitude as a fraction of the
-    // given max amplitude.
-    static uint8_t freq_byte(formant_sample_t dist);
-    static QRgb freq_argb(formant_sample_t f, formant_sample_t f1,
-                          formant_sample_t f2);
+    // Create a shade of grey for a frequency the given distance from the
+    // nearest formant, faded by the given weight from 0 to 1.
+    static uint8_t freq_byte(formant_sample_t dist, double weight);
+    QRgb freq_argb(formant_sample_t f, const Column &col) const;
 };
 
 #endif
@@ -0,0 +1,253 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <stdlib.h>
+
+#include "batch.h"
+#include "bench.h"
+#include "stats.h"
+#include "tracker.h"
+#include "workspace.h"
+
+#ifdef LIBFORMANT_TEST
+#include <math.h>
+#include <stdbool.h>
+
+#include "greatest.h"
+#include "synth.h"
+#endif
+
+struct formant_batch {
+    size_t n_streams;
+    formant_tracker_t **trackers;
+
+    // The samples of the last push, one stream after another.
+    formant_sample_t *buf;
+    size_t buf_cap;
+
+    // Scratch memory for the frames analysed across the streams.
+    formant_workspace_t ws;
+
+    // Stats of the last push or flush, summed over the streams.
+    formant_stats_t stats;
+};
+
+formant_batch_t *formant_batch_new(const formant_opts_t *opts,
+                                   size_t sample_rate, size_t n_streams)
+{
+    formant_batch_t *b;
+
+    if (!n_streams)
+        return NULL;
+
+    b = malloc(sizeof(formant_batch_t));
+
+    *b = (formant_batch_t) {
+        .n_streams = n_streams,
+        .trackers = calloc(n_streams, sizeof(formant_tracker_t *)),
+    };
+
+    formant_workspace_init(&b->ws);
+
+    for (size_t i = 0; i < n_streams; i += 1) {
+        b->trackers[i] = formant_tracker_new(opts, sample_rate);
+
+        if (!b->trackers[i]) {
+            formant_batch_destroy(b);
+            return NULL;
+        }
+    }
+
+    formant_stats_clear(&b->stats);
+
+    return b;
+}
+
+void formant_batch_destroy(formant_batch_t *b) {
+    if (!b)
+        return;
+
+    for (size_t i = 0; i < b->n_streams; i += 1)
+        formant_tracker_destroy(b->trackers[i]);
+
+    free(b->trackers);
+    free(b->buf);
+    formant_workspace_destroy(&b->ws);
+    free(b);
+}
+
+size_t formant_batch_streams(const formant_batch_t *b) {
+    return b->n_streams;
+}
+
+void formant_batch_reset(formant_batch_t *b) {
+    for (size_t i = 0; i < b->n_streams; i += 1)
+        formant_tracker_reset(b->trackers[i]);
+
+    formant_stats_clear(&b->stats);
+}
+
+void formant_batch_push(formant_batch_t *b, const formant_sample_t *samples,
+                        size_t n_samples, size_t *counts,
+                        const formant_frame_t **frames)
+{
+    size_t n = b->n_streams, ready = 0;
+
+    if (n_samples * n > b->buf_cap) {
+        b->buf_cap = n_samples * n;
+        b->buf = realloc(b->buf, sizeof(formant_sample_t) * b->buf_cap);
+        BENCH_ALLOC();
+    }
+
+    // Pull the streams apart in a single pass over the samples.
+    for (size_t i = 0; i < n_samples; i += 1)
+        for (size_t j = 0; j < n; j += 1)
+            b->buf[j * n_samples + i] = samples[i * n + j];
+
+    formant_stats_clear(&b->ws.stats);
+
+    // The streams are filled alike, so they all have the same frames ready.
+    for (size_t j = 0; j < n; j += 1)
+        ready = tracker_fill(b->trackers[j], b->buf + j * n_samples, n_samples);
+
+    for (size_t i = 0; i < ready; i += 1)
+        tracker_lanes(b->trackers, n, i, &b->ws);
+
+    b->stats = b->ws.stats;
+
+    for (size_t j = 0; j < n; j += 1) {
+        counts[j] = tracker_finish(b->trackers[j], &frames[j]);
+        formant_stats_add(&b->stats, formant_tracker_stats(b->trackers[j]));
+    }
+}
+
+void formant_batch_flush(formant_batch_t *b, size_t *counts,
+                         const formant_frame_t **frames)
+{
+    formant_stats_clear(&b->stats);
+
+    for (size_t j = 0; j < b->n_streams; j += 1) {
+        counts[j] = formant_tracker_flush(b->trackers[j], &frames[j]);
+        formant_stats_add(&b->stats, formant_tracker_stats(b->trackers[j]));
+    }
+}
+
+const formant_stats_t *formant_batch_stats(const formant_batch_t *b) {
+    return &b->stats;
+}
+
+#ifdef LIBFORMANT_TEST
+// Check that the n frames at a have the same formants as those at b, but for
+// rounding.
+static bool frames_match(const formant_frame_t *a, const formant_frame_t *b,
+                         size_t n, size_t nform)
+{
+    for (size_t i = 0; i < n; i += 1) {
+        for (size_t j = 0; j < nform; j += 1) {
+            if (fabs(a[i].freq[j] - b[i].freq[j]) > 1e-6 * b[i].freq[j] ||
+                fabs(a[i].band[j] - b[i].band[j]) > 1e-6 * b[i].band[j])
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+TEST test_formant_batch() {
+    enum { RATE = 16000, N = RATE / 2, STREAMS = 3 };
+    static const size_t chunks[] = {160, 7, 1000, 333};
+    // The first two formants and the F0 of every stream.
+    static const double vowels[STREAMS][3] = {
+        {700, 1200, 110}, {300, 2300, 210}, {500, 900, 160},
+    };
+    static const double band[] = {80, 80};
+
+    formant_sample_t *x = malloc(sizeof(formant_sample_t) * N * STREAMS);
+    formant_sample_t *one = malloc(sizeof(formant_sample_t) * N);
+    const formant_frame_t *got[STREAMS], *want;
+    formant_tracker_t *t[STREAMS];
+    size_t counts[STREAMS], total = 0;
+    formant_batch_t *b;
+    formant_opts_t opts;
+
+    formant_opts_init(&opts);
+    opts.max_lag = 0.03;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+
+    for (size_t j = 0; j < STREAMS; j += 1) {
+        synth_voice(one, N, RATE, vowels[j][2], vowels[j], band, 2, 8000);
+
+        for (size_t i = 0; i < N; i += 1)
+            x[i * STREAMS + j] = one[i];
+
+        t[j] = formant_tracker_new(&opts, RATE);
+    }
+
+    b = formant_batch_new(&opts, RATE, STREAMS);
+    GREATEST_ASSERT(b != NULL);
+    GREATEST_ASSERT_EQ(formant_batch_streams(b), STREAMS);
+
+    // Every stream comes out as it would from a tracker of its own, pushed
+    // the same way, but for the order the lanes sum in.
+    for (size_t round = 0; round < 2; round += 1) {
+        for (size_t pos = 0, k = 0; pos < N; k += 1) {
+            size_t n = chunks[k % 4] < N - pos ? chunks[k % 4] : N - pos;
+            size_t frames = 0;
+
+            formant_batch_push(b, x + pos * STREAMS, n, counts, got);
+
+            for (size_t j = 0; j < STREAMS; j += 1) {
+                for (size_t i = 0; i < n; i += 1)
+                    one[i] = x[(pos + i) * STREAMS + j];
+
+                GREATEST_ASSERT_EQ(formant_tracker_push(t[j], one, n, &want),
+                                   counts[j]);
+                GREATEST_ASSERT(frames_match(got[j], want, counts[j],
+                                             opts.n_formants));
+                frames += formant_tracker_stats(t[j])->frames;
+                total += counts[j];
+            }
+
+            GREATEST_ASSERT_EQ(formant_batch_stats(b)->frames, frames);
+            pos += n;
+        }
+
+        formant_batch_flush(b, counts, got);
+
+        for (size_t j = 0; j < STREAMS; j += 1) {
+            GREATEST_ASSERT_EQ(formant_tracker_flush(t[j], &want), counts[j]);
+            GREATEST_ASSERT(frames_match(got[j], want, counts[j],
+                                         opts.n_formants));
+            total += counts[j];
+            formant_tracker_reset(t[j]);
+        }
+
+        // The voices aren't mixed up.
+        GREATEST_ASSERT(counts[0] > 0 && counts[1] > 0);
+        GREATEST_ASSERT(got[1][0].freq[0] < got[0][0].freq[0] - 200);
+
+        formant_batch_reset(b);
+    }
+
+    GREATEST_ASSERT(total > 0);
+
+    GREATEST_ASSERT_EQ(formant_batch_new(&opts, RATE, 0), NULL);
+    GREATEST_ASSERT_EQ(formant_batch_new(&opts, 0, STREAMS), NULL);
+
+    formant_batch_destroy(b);
+
+    for (size_t j = 0; j < STREAMS; j += 1)
+        formant_tracker_destroy(t[j]);
+
+    free(x);
+    free(one);
+
+    PASS();
+}
+
+SUITE(batch_suite) {
+    RUN_TEST(test_formant_batch);
+}
+#endif
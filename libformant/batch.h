@@ -0,0 +1,54 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#include "formant.h"
+
+// A set of formant trackers with the same options that consume as many
+// independent streams in lockstep, such as one microphone per speaker. The
+// frames of the streams line up, so each frame is windowed and its LPC
+// coefficients worked out for several streams at once, a vector lane per
+// stream. Every stream keeps its own root-search and DP state, and is tracked
+// as a tracker of its own would track it but for rounding in the last bits.
+// Only LPC by autocorrelation in double precision is done in lanes; the
+// other methods are run a stream at a time.
+typedef struct formant_batch formant_batch_t;
+
+// Create a batch of n_streams streams at the given sample rate. The options
+// must have been processed by formant_opts_process. Return NULL on failure.
+formant_batch_t *formant_batch_new(const formant_opts_t *opts,
+                                   size_t sample_rate, size_t n_streams);
+
+// Release the memory held by the given batch.
+void formant_batch_destroy(formant_batch_t *b);
+
+// Get the number of streams of the given batch.
+size_t formant_batch_streams(const formant_batch_t *b);
+
+// Forget all audio pushed so far, as if the batch were newly created.
+void formant_batch_reset(formant_batch_t *b);
+
+// Push the next n_samples samples of every stream into the batch. The samples
+// are interleaved as the channels of a sound are, so there are n_samples times
+// the number of streams of them. The number of frames decided in stream i is
+// stored in counts[i] and the frames themselves in frames[i], which remain
+// valid until the next call to push, flush, or reset, as for
+// formant_tracker_push.
+void formant_batch_push(formant_batch_t *b, const formant_sample_t *samples,
+                        size_t n_samples, size_t *counts,
+                        const formant_frame_t **frames);
+
+// Decide every frame that's been put off in every stream, as at the end of the
+// streams, and store the frames as for push.
+void formant_batch_flush(formant_batch_t *b, size_t *counts,
+                         const formant_frame_t **frames);
+
+// Get the stats of the last push into or flush of the given batch, summed over
+// its streams, which remain valid until the next call to either.
+const formant_stats_t *formant_batch_stats(const formant_batch_t *b);
+
+#endif
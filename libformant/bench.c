@@ -0,0 +1,101 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifdef LIBFORMANT_BENCH
+#ifdef __linux__
+// Ask for syscall, which isn't part of C11.
+#define _GNU_SOURCE
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "bench.h"
+
+static bench_stat_t stats[BENCH_N_STAGES];
+static size_t current = BENCH_OTHER;
+
+// The cache miss counter, or -1 if misses aren't counted, along with its value
+// at the start of the current stage.
+static int misses_fd = -1;
+static uint64_t misses_start;
+
+// Get the cache misses counted so far.
+static uint64_t misses_now(void) {
+    uint64_t n = 0;
+
+#ifdef __linux__
+    if (misses_fd >= 0 && read(misses_fd, &n, sizeof(n)) != sizeof(n))
+        n = 0;
+#endif
+
+    return n;
+}
+
+bool bench_count_misses(void) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    if (misses_fd >= 0)
+        return true;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    misses_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+
+    return misses_fd >= 0;
+}
+
+const char *bench_name(size_t stage) {
+    static const char *const names[] = {
+        [FORMANT_STAGE_DOWNSAMPLE] = "downsample",
+        [FORMANT_STAGE_HIGHPASS] = "highpass",
+        [FORMANT_STAGE_VAD] = "vad",
+        [FORMANT_STAGE_LPC] = "lpc",
+        [FORMANT_STAGE_ROOTS] = "roots",
+        [FORMANT_STAGE_PITCH] = "pitch",
+        [FORMANT_STAGE_DP] = "dp",
+        [BENCH_OTHER] = "other",
+    };
+
+    return stage < BENCH_N_STAGES ? names[stage] : "";
+}
+
+double bench_now(void) {
+    return stats_now() * 1e-9;
+}
+
+void bench_reset(void) {
+    for (size_t i = 0; i < BENCH_N_STAGES; i += 1)
+        stats[i] = (bench_stat_t) { .secs = 0, .allocs = 0, .misses = 0 };
+
+    current = BENCH_OTHER;
+}
+
+bench_stat_t bench_stat(size_t stage) {
+    return stats[stage];
+}
+
+void bench_begin(size_t stage) {
+    current = stage;
+    misses_start = misses_now();
+}
+
+void bench_end(size_t stage, uint64_t ns) {
+    stats[stage].secs += ns * 1e-9;
+    stats[stage].misses += misses_now() - misses_start;
+    current = BENCH_OTHER;
+}
+
+void bench_alloc(void) {
+    stats[current].allocs += 1;
+}
+#endif
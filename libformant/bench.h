@@ -0,0 +1,67 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+// Benchmark builds, made by defining LIBFORMANT_BENCH, measure the stages of
+// formant analysis the same way for every call, along with anything outside
+// them, which the library itself never times.
+enum {
+    BENCH_OTHER = FORMANT_N_STAGES,
+
+    BENCH_N_STAGES,
+};
+
+// Time, heap allocations, and cache misses spent in a stage. Cache misses are
+// only counted once bench_count_misses has succeeded.
+typedef struct {
+    double secs;
+    size_t allocs;
+    uint64_t misses;
+} bench_stat_t;
+
+#ifdef LIBFORMANT_BENCH
+// Get the name of the given stage.
+const char *bench_name(size_t stage);
+
+// Get the current time in seconds from an arbitrary starting point.
+double bench_now(void);
+
+// Forget the measurements made so far.
+void bench_reset(void);
+
+// Get the measurements of the given stage since the last reset.
+bench_stat_t bench_stat(size_t stage);
+
+// Mark the start of the given stage, and its end after the given number of
+// nanoseconds. Nothing is synchronized, so benchmarks must analyse on a single
+// thread.
+void bench_begin(size_t stage);
+void bench_end(size_t stage, uint64_t ns);
+
+// Count a heap allocation toward the current stage.
+void bench_alloc(void);
+
+// Start counting the cache misses of every stage from now on, using the
+// hardware counters where the system offers them. Return true if they can be
+// counted and false otherwise. Reading the counters takes a system call at
+// every start and end of a stage, which skews short stages.
+bool bench_count_misses(void);
+
+#define BENCH_BEGIN(stage) bench_begin(stage)
+#define BENCH_END(stage, ns) bench_end(stage, ns)
+#define BENCH_ALLOC() bench_alloc()
+#else
+#define BENCH_BEGIN(stage) ((void)0)
+#define BENCH_END(stage, ns) ((void)0)
+#define BENCH_ALLOC() ((void)0)
+#endif
+
+#endif
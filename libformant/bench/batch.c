@@ -0,0 +1,99 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+// Measure how many voices a single core can track live at once. Every stream
+// is a different synthetic speaker saying a sequence of vowels, pushed into a
+// batch 10ms at a time as a sound card would deliver it. One JSON object is
+// printed per number of streams, with the total throughput as the seconds of
+// audio tracked per second, which is the number of voices that could be
+// tracked in real time.
+// Build with optimizations, e.g. CFLAGS=-O2 make bench.
+
+// The library is built with the stage measurements, so declare them here too.
+#define LIBFORMANT_BENCH
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "batch.h"
+#include "bench.h"
+#include "formant.h"
+#include "synth.h"
+
+enum { RATE = 16000 };
+// Length of every stream in seconds.
+enum { SECS = 10 };
+// Samples per push, per stream.
+enum { CHUNK = RATE / 100 };
+enum { ROUNDS = 3 };
+
+// Length of each vowel in seconds.
+static const double VOWEL_SECS = 0.3;
+
+int main(void) {
+    static const size_t streams[] = {1, 8, 16, 32};
+
+    const size_t n = RATE * SECS;
+    formant_opts_t opts;
+
+    formant_opts_init(&opts);
+    opts.max_lag = 0.03;
+
+    if (!formant_opts_process(&opts)) {
+        fprintf(stderr, "bad options\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); s += 1) {
+        size_t m = streams[s], frames = 0;
+        formant_sample_t *x = malloc(sizeof(formant_sample_t) * n * m);
+        const formant_frame_t **out = malloc(sizeof(formant_frame_t *) * m);
+        size_t *counts = malloc(sizeof(size_t) * m);
+        formant_batch_t *b = formant_batch_new(&opts, RATE, m);
+        double start, secs = 0;
+
+        if (!b) {
+            fprintf(stderr, "couldn't create batch\n");
+            return EXIT_FAILURE;
+        }
+
+        for (size_t j = 0; j < m; j += 1)
+            synth_vowels(x + j, n, m, RATE, SYNTH_VOWELS, SYNTH_N_VOWELS,
+                         VOWEL_SECS, j);
+
+        // The first round grows the buffers, so keep it out of the numbers.
+        for (int r = -1; r < ROUNDS; r += 1) {
+            formant_batch_reset(b);
+            start = bench_now();
+
+            for (size_t pos = 0; pos + CHUNK <= n; pos += CHUNK) {
+                formant_batch_push(b, x + pos * m, CHUNK, counts, out);
+
+                for (size_t j = 0; j < m && r == 0; j += 1)
+                    frames += counts[j];
+            }
+
+            formant_batch_flush(b, counts, out);
+
+            for (size_t j = 0; j < m && r == 0; j += 1)
+                frames += counts[j];
+
+            if (r >= 0)
+                secs += bench_now() - start;
+        }
+
+        secs /= ROUNDS;
+
+        printf("{\"streams\": %zu, \"frames\": %zu, \"secs\": %.4f, "
+               "\"us_per_frame\": %.2f, \"realtime_voices\": %.0f}\n",
+               m, frames, secs, secs * 1e6 / frames, m * SECS / secs);
+        fflush(stdout);
+
+        formant_batch_destroy(b);
+        free(counts);
+        free(out);
+        free(x);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+// Weigh the speed of the beam-pruned formant tracker against its accuracy. A
+// sequence of synthetic vowels with known formants is tracked at several LPC
+// orders, once with the exhaustive lattice and then with a range of beam
+// widths, and one JSON object is printed per run. Build with optimizations,
+// e.g. CFLAGS=-O2 make bench.
+
+// The library is built with the stage measurements, so declare them here too.
+#define LIBFORMANT_BENCH
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "formant.h"
+#include "synth.h"
+
+enum { RATE = 16000 };
+// Length of the signal in seconds.
+enum { SECS = 30 };
+// Length of each vowel in milliseconds.
+enum { VOWEL_MS = 300 };
+// Frames this close to a change of vowel aren't scored.
+enum { EDGE_MS = 40 };
+enum { ROUNDS = 3 };
+
+// Get the vowel spoken at the given time in milliseconds.
+static size_t vowel_at(size_t ms) {
+    return synth_vowel_at(ms / 1000.0, SYNTH_N_VOWELS, VOWEL_MS / 1000.0, 0);
+}
+
+// Track the formants of the signal, timing the dynamic programming.
+static bool track(const formant_sample_t *samples, size_t n,
+                  const formant_opts_t *opts, formant_workspace_t *ws,
+                  sound_t *s, double *secs, double *dp_secs)
+{
+    double start;
+
+    *secs = 0;
+
+    for (int r = -1; r < ROUNDS; r += 1) {
+        if (r == 0)
+            bench_reset();
+
+        sound_reset(s, RATE, 1);
+        sound_load_samples(s, samples, n);
+
+        start = bench_now();
+
+        if (!sound_calc_formants(s, opts, ws))
+            return false;
+
+        if (r >= 0)
+            *secs += bench_now() - start;
+    }
+
+    *secs /= ROUNDS;
+    *dp_secs = bench_stat(FORMANT_STAGE_DP).secs / ROUNDS;
+
+    return true;
+}
+
+int main(void) {
+    static const size_t orders[] = {12, 16, 20, 24};
+    static const size_t beams[] = {0, 50, 20, 10, 5, 2};
+
+    const size_t n = RATE * SECS;
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * n);
+    formant_workspace_t ws;
+    sound_t want, got;
+
+    synth_vowels(samples, n, 1, RATE, SYNTH_VOWELS, SYNTH_N_VOWELS,
+                 VOWEL_MS / 1000.0, 0);
+
+    formant_workspace_init(&ws);
+    sound_init(&want);
+    sound_init(&got);
+
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); o += 1)
+    for (size_t b = 0; b < sizeof(beams) / sizeof(beams[0]); b += 1) {
+        double secs, dp_secs, err = 0;
+        size_t scored = 0, same = 0;
+        formant_opts_t opts;
+        sound_t *s = b ? &got : &want;
+
+        formant_opts_init(&opts);
+        opts.lpc_order = orders[o];
+        opts.beam_width = beams[b];
+
+        if (!formant_opts_process(&opts) ||
+            !track(samples, n, &opts, &ws, s, &secs, &dp_secs))
+        {
+            fprintf(stderr, "analysis failed\n");
+            return EXIT_FAILURE;
+        }
+
+        for (size_t i = 0; i < s->n_samples; i += 1) {
+            // Frames are centered half a window past their start.
+            size_t ms = i * 1000 * opts.frame_dur + 500 * opts.window_dur;
+            size_t v = vowel_at(ms);
+
+            if (ms < EDGE_MS || vowel_at(ms - EDGE_MS) != v ||
+                vowel_at(ms + EDGE_MS) != v)
+            {
+                continue;
+            }
+
+            for (size_t j = 0; j < 2; j += 1) {
+                err += fabs(sound_get_sample(s, j, i) - SYNTH_VOWELS[v][j]);
+                same += sound_get_sample(s, j, i) ==
+                        sound_get_sample(&want, j, i);
+            }
+
+            scored += 2;
+        }
+
+        printf("{\"lpc_order\": %zu, \"beam_width\": %zu, "
+               "\"frames_per_sec\": %.0f, \"dp_ns_per_frame\": %.1f, "
+               "\"mean_error_hz\": %.1f, \"agreement\": %.4f}\n",
+               opts.lpc_order, opts.beam_width, s->n_samples / secs,
+               dp_secs * 1e9 / s->n_samples, err / scored,
+               (double)same / scored);
+        fflush(stdout);
+    }
+
+    sound_destroy(&want);
+    sound_destroy(&got);
+    formant_workspace_destroy(&ws);
+    free(samples);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+// Compare the throughput of the FIR engine against the shift-register filter it
+// replaced, running the 101-tap highpass used before LPC analysis. Build with
+// optimizations, e.g. CFLAGS=-O2 make bench.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fir.h"
+#include "kernels.h"
+
+#define PI 3.14159265358979323846
+
+enum { TAPS = 101 };
+// Ten seconds of audio at the analysis rate.
+enum { N_SAMPLES = 100000 };
+enum { ROUNDS = 20 };
+
+// The previous filter: shift the whole delay line for every output and round
+// each product separately.
+static void legacy_fir(const short *co, short *mem, const short *in, size_t n,
+                       short *out)
+{
+    for (size_t i = 0; i < n; i += 1) {
+        int sum = 0;
+
+        memmove(mem, mem + 1, sizeof(short) * (TAPS - 1));
+        mem[TAPS - 1] = in[i];
+
+        for (int k = 0; k < TAPS; k += 1)
+            sum += (co[k] * mem[k] + 16384) >> 15;
+
+        out[i] = sum;
+    }
+}
+
+static double now(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int main(void) {
+    static short in[N_SAMPLES], out[N_SAMPLES];
+    short co[TAPS], mem[TAPS] = {0};
+    double start, legacy, engine;
+    fir_t f;
+
+    // Any filter within the engine's gain limit costs the same.
+    for (int k = 0; k < TAPS; k += 1)
+        co[k] = 600 * (.5 - .5 * cos(2 * PI * k / (TAPS - 1)));
+
+    srand(1);
+
+    for (size_t i = 0; i < N_SAMPLES; i += 1)
+        in[i] = rand() % 20000 - 10000;
+
+    if (!fir_init(&f, co, TAPS))
+        return EXIT_FAILURE;
+
+    start = now();
+
+    for (int r = 0; r < ROUNDS; r += 1)
+        legacy_fir(co, mem, in, N_SAMPLES, out);
+
+    legacy = now() - start;
+    start = now();
+
+    for (int r = 0; r < ROUNDS; r += 1)
+        fir_run(&f, in, N_SAMPLES, out);
+
+    engine = now() - start;
+
+    printf("%d taps, kernel %s\n", TAPS, kern_best()->name);
+    printf("legacy  %12.0f samples/sec\n", ROUNDS * N_SAMPLES / legacy);
+    printf("engine  %12.0f samples/sec (%.1fx)\n",
+           ROUNDS * N_SAMPLES / engine, legacy / engine);
+
+    return EXIT_SUCCESS;
+}
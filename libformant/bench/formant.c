@@ -0,0 +1,354 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+// Measure the throughput of each stage of formant analysis over a matrix of LPC
+// and pole types, orders, and window sizes, and print the results as JSON, one
+// object per line. Pole types other than roots are timed as the roots stage.
+// Synthetic vowels are always measured, along with how far their F1 and F2 are
+// tracked from the true formants and how much the tracks jitter from frame to
+// frame while each vowel is held. Any 16-bit PCM WAV files given on the
+// command line are measured after them, with null for the accuracy.
+// Build with optimizations, e.g. CFLAGS=-O2 make bench.
+
+// The library is built with the stage measurements, so declare them here too.
+#define LIBFORMANT_BENCH
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "formant.h"
+#include "kernels.h"
+#include "synth.h"
+
+// Length of each synthetic signal in seconds.
+enum { SYNTH_SECS = 20 };
+// Number of timed analyses of each signal.
+enum { ROUNDS = 5 };
+// Frames whose windows come this close to a change of vowel aren't scored, to
+// give the tracks time to settle.
+static const double SETTLE_SECS = 0.02;
+
+// Formants of /a/, /i/, and /u/, which the synthetic signals hold for
+// VOWEL_SECS each in turn.
+static const double formants[][3] = {
+    {730, 1090, 2440},
+    {270, 2290, 3010},
+    {300, 870, 2240},
+};
+static const double VOWEL_SECS = 0.3;
+
+// An input signal to analyse.
+typedef struct {
+    char name[64];
+    size_t sample_rate;
+    size_t n_samples;
+    formant_sample_t *samples;
+    // Whether the signal is made of the vowels above.
+    bool synth;
+} signal_t;
+
+// Make a signal of the vowels above at the given sample rate.
+static void synth_signal(signal_t *sig, size_t sample_rate) {
+    snprintf(sig->name, sizeof(sig->name), "synth-%zu", sample_rate);
+    sig->sample_rate = sample_rate;
+    sig->n_samples = SYNTH_SECS * sample_rate;
+    sig->synth = true;
+    sig->samples = malloc(sizeof(formant_sample_t) * sig->n_samples);
+
+    synth_vowels(sig->samples, sig->n_samples, 1, sample_rate, formants, 3,
+                 VOWEL_SECS, 0);
+}
+
+static uint32_t le32(const unsigned char *b) {
+    return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static uint16_t le16(const unsigned char *b) {
+    return b[0] | b[1] << 8;
+}
+
+// Load the first channel of the 16-bit PCM WAV file at the given path. Return
+// true on success and false otherwise.
+static bool load_wav(signal_t *sig, const char *path) {
+    unsigned char hdr[12], chunk[8], fmt[16];
+    size_t n_channels = 0;
+    bool ok = false;
+    FILE *f;
+
+    if (!(f = fopen(path, "rb")))
+        return false;
+
+    if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) ||
+        memcmp(hdr + 8, "WAVE", 4))
+    {
+        goto out;
+    }
+
+    while (fread(chunk, 1, 8, f) == 8) {
+        uint32_t size = le32(chunk + 4);
+
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            if (fread(fmt, 1, 16, f) != 16)
+                goto out;
+
+            // Only integer PCM with 16-bit samples.
+            if (le16(fmt) != 1 || le16(fmt + 14) != 16)
+                goto out;
+
+            n_channels = le16(fmt + 2);
+            sig->sample_rate = le32(fmt + 4);
+            size -= 16;
+        } else if (!memcmp(chunk, "data", 4) && n_channels) {
+            size_t n = size / 2 / n_channels;
+            unsigned char *raw = malloc(size);
+
+            if (fread(raw, 1, size, f) != size) {
+                free(raw);
+                goto out;
+            }
+
+            sig->n_samples = n;
+            sig->samples = malloc(sizeof(formant_sample_t) * n);
+
+            for (size_t i = 0; i < n; i += 1)
+                sig->samples[i] = (int16_t)le16(raw + 2 * i * n_channels);
+
+            free(raw);
+            ok = true;
+            break;
+        }
+
+        // Chunks are padded to an even size.
+        if (fseek(f, size + (size & 1), SEEK_CUR))
+            goto out;
+    }
+
+out:
+    fclose(f);
+
+    if (ok)
+        snprintf(sig->name, sizeof(sig->name), "%s", path);
+
+    return ok;
+}
+
+static const char *lpc_name(const formant_opts_t *opts) {
+    switch (opts->lpc_type) {
+    case LPC_TYPE_NORMAL:
+        return opts->precision == PRECISION_FLOAT ? "normal-float" : "normal";
+    case LPC_TYPE_BSA:
+        return "bsa";
+    case LPC_TYPE_COVAR:
+        return "covar";
+    case LPC_TYPE_BURG:
+        return "burg";
+    case LPC_TYPE_INVALID:
+        break;
+    }
+
+    return "";
+}
+
+// Score the formants s tracked in the synthetic vowels with the given options,
+// storing the mean distance of F1 and F2 from the true formants in err and the
+// mean change of F1 and F2 from one frame to the next in jitter, both in Hz.
+static void score(const sound_t *s, const formant_opts_t *opts, double *err,
+                  double *jitter)
+{
+    size_t n_err = 0, n_jitter = 0;
+
+    *err = *jitter = 0;
+
+    for (size_t i = 0; i < s->n_samples; i += 1) {
+        double start = i * opts->frame_dur - SETTLE_SECS;
+        double end = i * opts->frame_dur + opts->window_dur + SETTLE_SECS;
+        size_t v = (size_t)(start / VOWEL_SECS);
+
+        if (start < 0 || (size_t)(end / VOWEL_SECS) != v)
+            continue;
+
+        *err += fabs(sound_get_f1(s, i) - formants[v % 3][0]) +
+                fabs(sound_get_f2(s, i) - formants[v % 3][1]);
+        n_err += 2;
+
+        // The frame before must be scored too.
+        if (start - opts->frame_dur >= v * VOWEL_SECS) {
+            *jitter += abs(sound_get_f1(s, i) - sound_get_f1(s, i - 1)) +
+                       abs(sound_get_f2(s, i) - sound_get_f2(s, i - 1));
+            n_jitter += 2;
+        }
+    }
+
+    *err /= n_err ? n_err : 1;
+    *jitter /= n_jitter ? n_jitter : 1;
+}
+
+// Print the given string as a JSON string, quoted and escaped.
+static void print_json_str(const char *s) {
+    putchar('"');
+
+    for (; *s; s += 1) {
+        unsigned char c = *s;
+
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+
+    putchar('"');
+}
+
+// Analyse the given signal with the given options and print one line of
+// results. Return false if the analysis failed.
+static bool run(const signal_t *sig, const formant_opts_t *opts,
+                formant_workspace_t *ws)
+{
+    sound_t s;
+    size_t frames = 0;
+    double start = 0, total = 0, staged = 0, err = 0, jitter = 0;
+    bool ok = true;
+
+    sound_init(&s);
+
+    // The first analysis grows the workspace and fills the caches, so keep it
+    // out of the numbers.
+    for (int r = -1; r < ROUNDS && ok; r += 1) {
+        if (r == 0)
+            bench_reset();
+
+        sound_reset(&s, sig->sample_rate, 1);
+        sound_load_samples(&s, sig->samples, sig->n_samples);
+
+        start = bench_now();
+        ok = sound_calc_formants(&s, opts, ws);
+
+        if (r >= 0) {
+            total += bench_now() - start;
+            frames += s.n_samples;
+        }
+    }
+
+    if (ok && sig->synth)
+        score(&s, opts, &err, &jitter);
+
+    sound_destroy(&s);
+
+    if (!ok || !frames)
+        return false;
+
+    // Whatever the stages didn't measure goes to the other stage.
+    for (size_t i = 0; i < BENCH_N_STAGES; i += 1)
+        staged += bench_stat(i).secs;
+
+    printf("{\"signal\": ");
+    print_json_str(sig->name);
+    printf(", \"sample_rate\": %zu, \"kernel\": \"%s\", "
+           "\"lpc_type\": \"%s\", \"pole_type\": \"%s\", \"pitch\": %s, "
+           "\"lpc_order\": %zu, \"window_dur\": %g, \"frames\": %zu, "
+           "\"frames_per_sec\": %.0f, \"stages\": {",
+           sig->sample_rate, kern_best()->name, lpc_name(opts),
+           opts->pole_type == POLE_TYPE_PEAKS ? "peaks" : "roots",
+           opts->pitch ? "true" : "false", opts->lpc_order, opts->window_dur,
+           frames / ROUNDS, frames / total);
+
+    for (size_t i = 0; i < BENCH_N_STAGES; i += 1) {
+        bench_stat_t st = bench_stat(i);
+
+        if (i == BENCH_OTHER)
+            st.secs = total > staged ? total - staged : 0;
+
+        printf("%s\"%s\": {\"ns_per_frame\": %.1f, \"frames_per_sec\": %.0f, "
+               "\"allocs_per_frame\": %.4f}",
+               i ? ", " : "", bench_name(i), st.secs * 1e9 / frames,
+               st.secs ? frames / st.secs : 0, (double)st.allocs / frames);
+    }
+
+    printf("}, ");
+
+    if (sig->synth)
+        printf("\"f1_f2_err_hz\": %.1f, \"f1_f2_jitter_hz\": %.1f}\n", err,
+               jitter);
+    else
+        printf("\"f1_f2_err_hz\": null, \"f1_f2_jitter_hz\": null}\n");
+    fflush(stdout);
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const size_t rates[] = {10000, 16000, 44100};
+    static const size_t orders[] = {10, 12, 16};
+    static const double windows[] = {0.015, 0.02, 0.025, 0.049};
+    static const struct {
+        int lpc_type;
+        precision_t precision;
+        bool pitch;
+        int pole_type;
+    } types[] = {
+        {LPC_TYPE_NORMAL, PRECISION_DOUBLE, false, POLE_TYPE_ROOTS},
+        {LPC_TYPE_NORMAL, PRECISION_DOUBLE, true, POLE_TYPE_ROOTS},
+        {LPC_TYPE_NORMAL, PRECISION_FLOAT, false, POLE_TYPE_ROOTS},
+        {LPC_TYPE_NORMAL, PRECISION_DOUBLE, false, POLE_TYPE_PEAKS},
+        {LPC_TYPE_BSA, PRECISION_DOUBLE, false, POLE_TYPE_ROOTS},
+        {LPC_TYPE_COVAR, PRECISION_DOUBLE, false, POLE_TYPE_ROOTS},
+        {LPC_TYPE_BURG, PRECISION_DOUBLE, false, POLE_TYPE_ROOTS},
+    };
+
+    size_t n_rates = sizeof(rates) / sizeof(rates[0]);
+    size_t n_sigs = n_rates + argc - 1;
+    signal_t *sigs = calloc(n_sigs, sizeof(signal_t));
+    formant_workspace_t ws;
+    int ret = EXIT_SUCCESS;
+
+    for (size_t i = 0; i < n_rates; i += 1)
+        synth_signal(&sigs[i], rates[i]);
+
+    for (int i = 1; i < argc; i += 1) {
+        if (!load_wav(&sigs[n_rates + i - 1], argv[i])) {
+            fprintf(stderr, "unable to load %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    formant_workspace_init(&ws);
+
+    for (size_t i = 0; i < n_sigs; i += 1)
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t += 1)
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); o += 1)
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w += 1) {
+        formant_opts_t opts;
+
+        formant_opts_init(&opts);
+        opts.lpc_type = types[t].lpc_type;
+        opts.precision = types[t].precision;
+        opts.pitch = types[t].pitch;
+        opts.pole_type = types[t].pole_type;
+        opts.lpc_order = orders[o];
+        opts.window_dur = windows[w];
+
+        // Higher formants need a higher order.
+        if (opts.n_formants > (opts.lpc_order - 4) / 2)
+            opts.n_formants = (opts.lpc_order - 4) / 2;
+
+        if (!formant_opts_process(&opts) || !run(&sigs[i], &opts, &ws)) {
+            fprintf(stderr, "analysis of %s failed\n", sigs[i].name);
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    formant_workspace_destroy(&ws);
+
+    for (size_t i = 0; i < n_sigs; i += 1)
+        free(sigs[i].samples);
+
+    free(sigs);
+
+    return ret;
+}
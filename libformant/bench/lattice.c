@@ -0,0 +1,103 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+// Measure how the dynamic programming of the formant tracker holds up over a
+// recording long enough that its lattice spills out of the caches: two minutes
+// of synthetic vowels, which make twelve thousand frames. One JSON object is
+// printed per LPC order and beam width, with the cache misses of the stage
+// where the hardware counters can be read and null otherwise. The program only
+// uses the public interface, so building it against an older library compares
+// lattice layouts. Build with optimizations, e.g. CFLAGS=-O2 make bench.
+
+// The library is built with the stage measurements, so declare them here too.
+#define LIBFORMANT_BENCH
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "formant.h"
+#include "synth.h"
+
+enum { RATE = 16000 };
+// Length of the signal in seconds.
+enum { SECS = 120 };
+enum { ROUNDS = 3 };
+
+// Formants of the vowels the signal is made of, each held for VOWEL_SECS in
+// turn.
+static const double vowels[][3] = {
+    {730, 1090, 2440}, {440, 1020, 2240}, {570, 840, 2410},
+    {530, 1840, 2480}, {300, 870, 2240}, {270, 2290, 3010},
+};
+static const double VOWEL_SECS = 0.3;
+
+enum { N_VOWELS = sizeof(vowels) / sizeof(vowels[0]) };
+
+int main(void) {
+    static const size_t orders[] = {12, 16, 20};
+    static const size_t beams[] = {0, 20};
+
+    const size_t n = RATE * SECS;
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * n);
+    bool misses = bench_count_misses();
+    formant_workspace_t ws;
+    sound_t s;
+
+    synth_vowels(samples, n, 1, RATE, vowels, N_VOWELS, VOWEL_SECS, 0);
+
+    formant_workspace_init(&ws);
+    sound_init(&s);
+
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); o += 1)
+    for (size_t b = 0; b < sizeof(beams) / sizeof(beams[0]); b += 1) {
+        formant_opts_t opts;
+        bench_stat_t dp;
+
+        formant_opts_init(&opts);
+        opts.lpc_order = orders[o];
+        opts.beam_width = beams[b];
+
+        if (!formant_opts_process(&opts)) {
+            fprintf(stderr, "bad options\n");
+            return EXIT_FAILURE;
+        }
+
+        // The first analysis grows the workspace, so keep it out of the
+        // numbers.
+        for (int r = -1; r < ROUNDS; r += 1) {
+            if (r == 0)
+                bench_reset();
+
+            sound_reset(&s, RATE, 1);
+            sound_load_samples(&s, samples, n);
+
+            if (!sound_calc_formants(&s, &opts, &ws)) {
+                fprintf(stderr, "analysis failed\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        dp = bench_stat(FORMANT_STAGE_DP);
+
+        printf("{\"lpc_order\": %zu, \"beam_width\": %zu, \"frames\": %zu, "
+               "\"dp_ns_per_frame\": %.1f, \"dp_allocs_per_frame\": %.4f, "
+               "\"dp_cache_misses_per_frame\": ",
+               opts.lpc_order, opts.beam_width, s.n_samples,
+               dp.secs * 1e9 / ROUNDS / s.n_samples,
+               (double)dp.allocs / ROUNDS / s.n_samples);
+
+        if (misses)
+            printf("%.2f}\n", (double)dp.misses / ROUNDS / s.n_samples);
+        else
+            printf("null}\n");
+
+        fflush(stdout);
+    }
+
+    sound_destroy(&s);
+    formant_workspace_destroy(&ws);
+    free(samples);
+
+    return EXIT_SUCCESS;
+}
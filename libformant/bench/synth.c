@@ -0,0 +1,63 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "synth.h"
+
+#define PI 3.14159265358979323846
+
+const double SYNTH_VOWELS[SYNTH_N_VOWELS][3] = {
+    {270, 2290, 3010}, {390, 1990, 2550}, {530, 1840, 2480},
+    {660, 1720, 2410}, {730, 1090, 2440}, {570, 840, 2410},
+    {440, 1020, 2240}, {300, 870, 2240}, {490, 1350, 1690},
+    {640, 1190, 2390},
+};
+
+size_t synth_vowel_at(double t, size_t n_vowels, double vowel_secs,
+                      size_t voice)
+{
+    return ((size_t)(t / vowel_secs) + voice) % n_vowels;
+}
+
+void synth_vowels(formant_sample_t *x, size_t n, size_t stride,
+                  size_t sample_rate, const double (*vowels)[3],
+                  size_t n_vowels, double vowel_secs, size_t voice)
+{
+    double *y = malloc(sizeof(double) * n);
+    double res[3][2] = {{0}}, phase = 0, peak = 0;
+    double f0 = 120 + 13 * (voice % 16);
+    uint32_t seed = voice + 1;
+
+    for (size_t i = 0; i < n; i += 1) {
+        double t = (double)i / sample_rate;
+        const double *f = vowels[synth_vowel_at(t, n_vowels, vowel_secs,
+                                                voice)];
+
+        phase += f0 * (1 + sin(2 * PI * 0.5 * t) / 6) / sample_rate;
+        y[i] = phase >= 1;
+        phase -= phase >= 1;
+
+        seed = seed * 1664525 + 1013904223;
+        y[i] += ((double)(seed >> 16) / 65536 - .5) * 2e-2;
+
+        for (size_t k = 0; k < 3; k += 1) {
+            double r = exp(-PI * (60 + 20 * k) / sample_rate);
+            double c = 2 * r * cos(2 * PI * f[k] / sample_rate);
+
+            y[i] += c * res[k][0] - r * r * res[k][1];
+            res[k][1] = res[k][0];
+            res[k][0] = y[i];
+        }
+
+        if (fabs(y[i]) > peak)
+            peak = fabs(y[i]);
+    }
+
+    for (size_t i = 0; i < n; i += 1)
+        x[i * stride] = y[i] * 16384 / peak;
+
+    free(y);
+}
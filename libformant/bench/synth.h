@@ -0,0 +1,30 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef BENCH_SYNTH_H
+#define BENCH_SYNTH_H
+
+#include <stddef.h>
+
+#include "formant.h"
+
+// The first three formants in Hz of the vowels of American English in heed,
+// hid, head, had, hod, hawed, hood, who'd, heard, and hud, as spoken by men.
+enum { SYNTH_N_VOWELS = 10 };
+extern const double SYNTH_VOWELS[SYNTH_N_VOWELS][3];
+
+// Get the index of the vowel the given voice is speaking at t seconds, out of
+// n_vowels vowels held for vowel_secs each, as synthesized by synth_vowels.
+size_t synth_vowel_at(double t, size_t n_vowels, double vowel_secs,
+                      size_t voice);
+
+// Synthesize n samples at the given sample rate into every stride'th sample at
+// x: the given vowels, each held for vowel_secs in turn, spoken as a glottal
+// pulse train with a wandering pitch through two-pole resonators at their three
+// formants, with a little noise on top, and scaled to half of full scale. Each
+// voice starts on a vowel, and speaks at a pitch and with noise, of its own.
+void synth_vowels(formant_sample_t *x, size_t n, size_t stride,
+                  size_t sample_rate, const double (*vowels)[3],
+                  size_t n_vowels, double vowel_secs, size_t voice);
+
+#endif
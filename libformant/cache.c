@@ -0,0 +1,72 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "cache.h"
+
+typedef struct cache_entry {
+    struct cache_entry *next;
+
+    cache_kind_t kind;
+    int a, b;
+
+    // Table contents, aligned for any type.
+    union {
+        double d;
+        void *p;
+    } data[];
+} cache_entry_t;
+
+// Entries are only ever pushed onto the front of this list and never removed,
+// so readers can walk it without locking once they've loaded the head.
+static cache_entry_t *cache_head;
+
+static cache_entry_t *cache_find(cache_entry_t *e, cache_kind_t kind, int a,
+                                 int b)
+{
+    for (; e; e = e->next) {
+        if (e->kind == kind && e->a == a && e->b == b)
+            return e;
+    }
+
+    return NULL;
+}
+
+const void *cache_get(cache_kind_t kind, int a, int b, size_t size,
+                      cache_build_t build)
+{
+    cache_entry_t *head, *e, *found;
+
+    head = __atomic_load_n(&cache_head, __ATOMIC_ACQUIRE);
+
+    if ((found = cache_find(head, kind, a, b)))
+        return found->data;
+
+    if (!(e = malloc(sizeof(cache_entry_t) + size)))
+        return NULL;
+
+    BENCH_ALLOC();
+
+    e->kind = kind;
+    e->a = a;
+    e->b = b;
+    build(e->data, a, b);
+
+    e->next = head;
+
+    while (!__atomic_compare_exchange_n(&cache_head, &e->next, e, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        // Another thread pushed entries in the meantime, which may include
+        // this one.
+        if ((found = cache_find(e->next, kind, a, b))) {
+            free(e);
+            return found->data;
+        }
+    }
+
+    return e->data;
+}
@@ -0,0 +1,40 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+// Kinds of tables held in the cache.
+typedef enum {
+    // Analysis window, keyed by (window type, length).
+    CACHE_WINDOW,
+    // Analysis window in single precision, keyed likewise.
+    CACHE_WINDOW_FLOAT,
+    // Hamming window of BSA analysis, keyed by (length, 0).
+    CACHE_BSA_WINDOW,
+    // Polyphase resampling filter bank, keyed by (up, down).
+    CACHE_LOWPASS,
+    // Highpass coefficients, keyed by (length, 0).
+    CACHE_HIGHPASS,
+    // FFT twiddle factors, keyed by (length, 0).
+    CACHE_FFT,
+    // Cosines of the frequencies the LPC envelope is evaluated at by
+    // formant_peaks, keyed by (points, 0).
+    CACHE_PEAKS_COS,
+} cache_kind_t;
+
+// Fill the size bytes at data with the table for the given key.
+typedef void (*cache_build_t)(void *data, int a, int b);
+
+// Get the table of the given kind and key, building it with the given function
+// the first time it's requested. The table is shared by every caller in the
+// process and remains valid until exit, so it must not be modified.
+//
+// This is safe to call from multiple threads at once. If two threads race to
+// build the same table, one of them wins and the other's copy is discarded.
+const void *cache_get(cache_kind_t kind, int a, int b, size_t size,
+                      cache_build_t build);
+
+#endif
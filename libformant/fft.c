@@ -0,0 +1,79 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache.h"
+#include "fft.h"
+
+#define PI 3.14159265358979323846
+
+size_t fft_size(size_t n) {
+    size_t size = 1;
+
+    while (size < n)
+        size <<= 1;
+
+    return size;
+}
+
+// Build the n/2 twiddle factors exp(-2πik/n), as cosines followed by sines.
+static void twiddle_build(void *data, int n, int unused) {
+    double *tw = data;
+
+    (void)unused;
+
+    for (int k = 0; k < n / 2; k += 1) {
+        tw[k] = cos(2 * PI * k / n);
+        tw[n / 2 + k] = -sin(2 * PI * k / n);
+    }
+}
+
+void fft(double *re, double *im, size_t n, bool inverse) {
+    const double *cs, *sn;
+    double sign = inverse ? -1 : 1;
+
+    if (n < 2)
+        return;
+
+    cs = cache_get(CACHE_FFT, n, 0, n * sizeof(double), twiddle_build);
+    sn = cs + n / 2;
+
+    // Put the input in bit-reversed order.
+    for (size_t i = 1, j = 0; i < n; i += 1) {
+        size_t bit = n >> 1;
+
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+
+        j |= bit;
+
+        if (i < j) {
+            double t;
+
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len / 2, stride = n / len;
+
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t k = 0; k < half; k += 1) {
+                double wr = cs[k * stride], wi = sign * sn[k * stride];
+                size_t a = i + k, b = a + half;
+
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
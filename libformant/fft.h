@@ -0,0 +1,18 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Get the smallest power of two that's at least n.
+size_t fft_size(size_t n);
+
+// Replace the n complex values with real parts in re and imaginary parts in im
+// by their discrete Fourier transform, or by their unscaled inverse transform
+// if inverse is true. The length n must be a power of two.
+void fft(double *re, double *im, size_t n, bool inverse);
+
+#endif
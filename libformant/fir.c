@@ -0,0 +1,150 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fir.h"
+#include "kernels.h"
+
+#ifdef LIBFORMANT_TEST
+#include "greatest.h"
+#endif
+
+bool fir_init(fir_t *f, const short *co, int taps) {
+    long gain = 0;
+
+    if (taps < 1 || taps > FIR_TAPS_MAX)
+        return false;
+
+    // Full-scale input mustn't be able to overflow the sum.
+    for (int i = 0; i < taps; i += 1)
+        gain += abs(co[i]);
+
+    if (gain > INT_MAX / 32768)
+        return false;
+
+    f->taps = taps;
+    memcpy(f->co, co, sizeof(short) * taps);
+    fir_reset(f);
+
+    return true;
+}
+
+void fir_reset(fir_t *f) {
+    memset(f->hist, 0, sizeof(f->hist));
+    f->head = 0;
+}
+
+// Scale the sum of the filter back to a sample.
+static short fir_out(int sum) {
+    sum = (sum + 16384) >> 15;
+
+    return sum > SHRT_MAX ? SHRT_MAX : sum < SHRT_MIN ? SHRT_MIN : sum;
+}
+
+void fir_run(fir_t *f, const short *in, size_t n, short *out) {
+    int (*dot16)(const short *, const short *, size_t) = kern_best()->dot16;
+
+    for (size_t i = 0; i < n; i += 1) {
+        f->hist[f->head] = f->hist[f->head + f->taps] = in[i];
+        f->head = f->head + 1 == f->taps ? 0 : f->head + 1;
+
+        out[i] = fir_out(dot16(f->co, f->hist + f->head, f->taps));
+    }
+}
+
+void fir_range(const fir_t *f, const short *in, size_t n, size_t first,
+               size_t count, short *out)
+{
+    int (*dot16)(const short *, const short *, size_t) = kern_best()->dot16;
+    short win[FIR_TAPS_MAX];
+    size_t taps = f->taps;
+
+    for (size_t end = first + 1; end <= first + count; end += 1) {
+        const short *x = win;
+
+        // Build the delay line by hand where it runs off either end.
+        if (end >= taps && end <= n) {
+            x = in + end - taps;
+        } else {
+            for (size_t k = 0; k < taps; k += 1) {
+                win[k] = end + k >= taps && end + k - taps < n ?
+                         in[end + k - taps] : 0;
+            }
+        }
+
+        *out++ = fir_out(dot16(f->co, x, taps));
+    }
+}
+
+#ifdef LIBFORMANT_TEST
+TEST test_fir_run() {
+    enum { N = 1000, TAPS = 31 };
+    short co[TAPS], in[N], whole[N], parts[N];
+    fir_t f;
+
+    srand(8);
+
+    for (size_t i = 0; i < TAPS; i += 1)
+        co[i] = rand() % 4000 - 2000;
+
+    for (size_t i = 0; i < N; i += 1)
+        in[i] = rand() % 65536 - 32768;
+
+    GREATEST_ASSERT(fir_init(&f, co, TAPS));
+    fir_run(&f, in, N, whole);
+
+    // Check against direct convolution, with the input zero before the start.
+    for (int i = 0; i < N; i += 1) {
+        int sum = 0;
+
+        for (int k = 0; k < TAPS; k += 1) {
+            if (i - k >= 0)
+                sum += co[TAPS - 1 - k] * in[i - k];
+        }
+
+        sum = (sum + 16384) >> 15;
+        sum = sum > SHRT_MAX ? SHRT_MAX : sum < SHRT_MIN ? SHRT_MIN : sum;
+        GREATEST_ASSERT_EQ(sum, whole[i]);
+    }
+
+    // Filtering in pieces, in place, gives the same result.
+    memcpy(parts, in, sizeof(parts));
+    fir_reset(&f);
+
+    for (size_t i = 0, len; i < N; i += len) {
+        len = rand() % 100;
+        len = N - i < len ? N - i : len;
+        fir_run(&f, parts + i, len, parts + i);
+    }
+
+    GREATEST_ASSERT(memcmp(whole, parts, sizeof(whole)) == 0);
+
+    // So does computing ranges of outputs separately, in any order.
+    memset(parts, 0, sizeof(parts));
+
+    for (size_t i = N, len; i > 0; i -= len) {
+        len = rand() % 100;
+        len = i < len ? i : len;
+        fir_range(&f, in, N, i - len, len, parts + i - len);
+    }
+
+    GREATEST_ASSERT(memcmp(whole, parts, sizeof(whole)) == 0);
+
+    // Filters whose gain could overflow are refused.
+    for (size_t i = 0; i < TAPS; i += 1)
+        co[i] = 32767;
+
+    GREATEST_ASSERT_FALSE(fir_init(&f, co, TAPS));
+    GREATEST_ASSERT_FALSE(fir_init(&f, co, FIR_TAPS_MAX + 1));
+
+    PASS();
+}
+
+SUITE(fir_suite) {
+    RUN_TEST(test_fir_run);
+}
+#endif
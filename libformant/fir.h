@@ -0,0 +1,45 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef FIR_H
+#define FIR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Most taps a filter may have.
+enum { FIR_TAPS_MAX = 256 };
+
+// Fixed-point FIR filter with Q15 coefficients. State carries over from one
+// call to the next, so a signal can be filtered in arbitrary pieces.
+typedef struct {
+    int taps;
+    // Coefficients, ordered to match the delay line, oldest sample first.
+    short co[FIR_TAPS_MAX];
+
+    // Last taps input samples, stored twice so the newest taps of them are
+    // always contiguous starting at hist + head.
+    short hist[2 * FIR_TAPS_MAX];
+    int head;
+} fir_t;
+
+// Initialize the given filter with the taps coefficients at co. Return true if
+// the filter was initialized and false if it's too long or its gain is too
+// large for the accumulator.
+bool fir_init(fir_t *f, const short *co, int taps);
+
+// Forget the signal seen so far.
+void fir_reset(fir_t *f);
+
+// Filter the n samples at in into out, which may be the same buffer. Output i
+// is the filter centered (taps / 2) samples behind input i.
+void fir_run(fir_t *f, const short *in, size_t n, short *out);
+
+// Compute the count outputs starting with output first that a freshly reset
+// filter would produce from the n samples at in followed by silence, and store
+// them in out, which mustn't overlap in. The filter itself is left alone, so
+// separate ranges of a signal may be computed at once.
+void fir_range(const fir_t *f, const short *in, size_t n, size_t first,
+               size_t count, short *out);
+
+#endif
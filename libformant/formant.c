@@ -12,22 +12,38 @@
 // Revised by: John Shore
 
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bench.h"
+#include "cache.h"
+#include "fft.h"
+#include "fir.h"
 #include "formant.h"
+#include "kernels.h"
+#include "pitch.h"
 #include "processing.h"
+#include "resample.h"
+#include "tracker.h"
+#include "vad.h"
 
 #ifdef LIBFORMANT_TEST
 #include "greatest.h"
+#include "synth.h"
 #endif
 
-enum { MAX_FORMANTS = 7 };
-
 enum { LPC_ORDER_MIN = 2 };
 enum { LPC_ORDER_MAX = 30 };
+/* stabilizing factor for autocorrelation LPC, in dB below the peak */
+enum { LPC_STABLE = 70 };
+
+/* length of the highpass filter run before LPC analysis */
+enum { HIGHPASS_LEN = 101 };
 
 #define PI 3.14159265358979323846
 
@@ -49,14 +65,51 @@ static const double BAND_FACT = 0.002;
 static const double F_BIAS = 0.000;
 /* cost of mapping f1 and f2 to same frequency */
 static const double F_MERGE = 2000.0;
+/* quietest voiced frame relative to the loudest one (-30 dB) */
+static const double VOICED_RMS = 0.0316;
+/* F0 of the speakers the formant ranges are set for; those of others are
+   scaled by the ratio of their F0 to the power of F0_EXP, within F0_SCALE_MIN
+   and F0_SCALE_MAX.  Formants rise about with the fourth root of F0 from men
+   to women to children. */
+static const double F0_NOMINAL = 120.0;
+static const double F0_EXP = 0.25;
+static const double F0_SCALE_MIN = 0.85;
+static const double F0_SCALE_MAX = 1.4;
+/* seconds of a stream averaged over for its speaker's F0 */
+static const double F0_ADAPT_SECS = 2.0;
+
+/* The candidate mappings of a run of frames of the dp lattice, stored flat so
+   that connecting one frame to the next streams through memory.  The arrays
+   with a row per formant hold row l at l * cap, and every array is indexed by
+   the lattice-wide number of a candidate. */
+typedef struct {
+    size_t n;		/* # of candidates stored */
+    size_t cap;		/* # of candidates there's room for */
+    short *cand;	/* pole mapped to each formant, or -1 if it's missing */
+    double *freq;	/* frequency of that pole, or 0 if it's missing */
+    int64_t *local;	/* local cost of each cand. */
+    int64_t *cumerr;	/* cum. errors associated with each cand. */
+    short *prept;	/* best cand. of the previous frame, within that frame */
+    short *beam;	/* cands. the next frame may connect to, in each frame */
+} lattice_t;
 
 typedef struct { /* structure of a DP lattice node for formant tracking */
-    size_t ncand; /* # of candidate mappings for this frame */
-    short **cand;      /* pole-to-formant map-candidate array */
-    short *prept;	 /* backpointer array for each frame */
-    double *cumerr; 	 /* cum. errors associated with each cand. */
+    lattice_t *lat;	/* the lattice holding the candidates of this frame */
+    size_t first;	/* number of its first cand. in the lattice */
+    size_t ncand;	/* # of candidate mappings for this frame */
+    size_t nbeam;	/* # of cands. the next frame may connect to */
 } form_t;
 
+/* Get the poles mapped to formant l by the candidates of frame f. */
+static inline short *form_cand(const form_t *f, size_t l) {
+    return f->lat->cand + l * f->lat->cap + f->first;
+}
+
+/* Get the frequencies mapped to formant l by the candidates of frame f. */
+static inline double *form_freq(const form_t *f, size_t l) {
+    return f->lat->freq + l * f->lat->cap + f->first;
+}
+
 typedef struct {   /* structure to hold raw LPC analysis data */
     double rms;    /* rms for current LPC analysis frame */
     double rms2;    /* rms for current F0 analysis frame */
@@ -82,6 +135,19 @@ void formant_opts_init(formant_opts_t *opts) {
         .lpc_type = LPC_TYPE_NORMAL,
         .lpc_order = 12,
         .nom_freq = -10,
+        .pole_type = POLE_TYPE_ROOTS,
+
+        .precision = PRECISION_DOUBLE,
+        .beam_width = 0,
+        .max_lag = 0,
+
+        .pitch = false,
+        .adapt_ranges = false,
+
+        .vad = false,
+        .vad_floor = 100,
+
+        .channels = CHANNELS_FIRST,
     };
 }
 
@@ -95,6 +161,21 @@ bool formant_opts_process(formant_opts_t *opts) {
     if (opts->n_formants > MAX_FORMANTS)
         return false;
 
+    if (!(opts->max_lag >= 0))
+        return false;
+
+    if (!(opts->vad_floor >= 0))
+        return false;
+
+    if (opts->precision >= PRECISION_INVALID)
+        return false;
+
+    if (opts->pole_type >= POLE_TYPE_INVALID)
+        return false;
+
+    if (opts->channels >= CHANNELS_INVALID)
+        return false;
+
     /* force "standard" stabilized covariance (ala bsa) */
     if (opts->lpc_type == LPC_TYPE_BSA) {
         opts->window_dur = 0.025;
@@ -102,6 +183,9 @@ bool formant_opts_process(formant_opts_t *opts) {
         opts->pre_emph_factor = exp(-62.831853 * 90 / opts->downsample_rate);
     }
 
+    if (opts->adapt_ranges)
+        opts->pitch = true;
+
     return true;
 }
 
@@ -113,6 +197,26 @@ TEST test_formant_opts_process() {
     GREATEST_ASSERTm("default options should validate",
         formant_opts_process(&opts));
 
+    // Options out of range are rejected.
+    opts.precision = PRECISION_INVALID;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    formant_opts_init(&opts);
+    opts.pole_type = POLE_TYPE_INVALID;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    formant_opts_init(&opts);
+    opts.channels = CHANNELS_INVALID;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    formant_opts_init(&opts);
+    opts.max_lag = -0.01;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    formant_opts_init(&opts);
+    opts.vad_floor = -1;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
     PASS();
 }
 #endif
@@ -136,8 +240,10 @@ void sound_destroy(sound_t *s) {
 }
 
 void sound_resize(sound_t *s, size_t n_samples) {
-    if (n_samples > s->n_samples * s->n_channels)
+    if (n_samples > s->n_samples * s->n_channels) {
         s->samples = realloc(s->samples, n_samples * sizeof(formant_sample_t));
+        BENCH_ALLOC();
+    }
 
     // The rest of the processing functions expect n_samples to be the number of
     // samples per channel.
@@ -188,334 +294,628 @@ static inline void sound_set_sample(sound_t *s, size_t chan, size_t i,
    best candidate mappings, starting at end of utterance (or current frame).
    */
 
-/* can this pole be this freq.? */
-static int canbe(const double *fmins, const double *fmaxs, const double *fre,
-                 int pnumb, int fnumb)
+/* find the maximum in the "stationarity" function (stored in rms) */
+static double get_stat_max(pole_t **poles, int nframes) {
+    int i;
+    double amax, t;
+
+    for(i=1, amax = (*poles++)->rms; i++ < nframes; )
+        if((t = (*poles++)->rms) > amax) amax = t;
+
+    return(amax);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* find the median F0 of the voiced frames, or 0 if there are none */
+static double get_f0_median(formant_workspace_t *ws, pole_t **poles,
+                            size_t nframes)
+{
+    formant_workspace_mark_t mark = formant_workspace_mark(ws);
+    double *f0 = formant_workspace_alloc(ws, sizeof(double) * nframes), med;
+    size_t n = 0;
+
+    for (size_t i = 0; i < nframes; i++)
+        if (poles[i]->f0 > 0)
+            f0[n++] = poles[i]->f0;
+
+    qsort(f0, n, sizeof(double), cmp_double);
+    med = !n ? 0 : n % 2 ? f0[n / 2] : (f0[n / 2 - 1] + f0[n / 2]) / 2;
+    formant_workspace_release(ws, mark);
+
+    return med;
+}
+
+typedef struct { /* working values of the cost weights for the dp tracker */
+    size_t nform;   /* # of formants to track */
+    bool domerge;   /* allow f1 and f2 to map to the same pole? */
+    double merge_cost;
+    double fnom[MAX_FORMANTS];  /* "nominal" freqs. */
+    double fmins[MAX_FORMANTS]; /* frequency bounds */
+    double fmaxs[MAX_FORMANTS];
+    double dffact, bfact, ffact, fbias;
+    double maxpferr; /* largest change in frequency between two mappings */
+    bool adapting;  /* may the scale change from one frame to the next? */
+    size_t beam;    /* # of paths kept per frame, or 0 for all of them */
+    double nom_f1;  /* nominal F1 the frequencies are derived from, if > 0 */
+} dp_t;
+
+/* Set the nominal frequencies and the bounds of each formant, scaled by the
+   given factor for the speaker. */
+static void dp_scale(dp_t *dp, double scale) {
+    static const double
+        fnom[]  = {  500, 1500, 2500, 3500, 4500, 5500, 6500},
+        fmins[] = {   50,  400, 1000, 2000, 2000, 3000, 3000},
+        fmaxs[] = { 1500, 3500, 4500, 5000, 6000, 6000, 8000};
+
+    memcpy(dp->fnom, fnom, sizeof(fnom));
+    memcpy(dp->fmins, fmins, sizeof(fmins));
+    memcpy(dp->fmaxs, fmaxs, sizeof(fmaxs));
+
+    if(dp->nom_f1 > 0.0) {
+        for(size_t i=0; i < MAX_FORMANTS; i++) {
+            dp->fnom[i] = ((i * 2) + 1) * dp->nom_f1;
+            dp->fmins[i] = dp->fnom[i] - ((i+1) * dp->nom_f1) + 50.0;
+            dp->fmaxs[i] = dp->fnom[i] + (i * dp->nom_f1) + 1000.0;
+        }
+    }
+
+    if(scale != 1.0) {
+        for(size_t i=0; i < MAX_FORMANTS; i++) {
+            dp->fnom[i] *= scale;
+            dp->fmins[i] *= scale;
+            dp->fmaxs[i] *= scale;
+        }
+    }
+
+    /* Two poles mapped to the same formant are at most as far apart as the
+       bounds of the formant.  If the bounds follow the speaker, the pole of
+       one frame may be mapped under any scale and that of the next under
+       another. */
+    dp->maxpferr = 0;
+    for(size_t i = 0; i < dp->nform; i++) {
+        double lo = dp->fmins[i], hi = dp->fmaxs[i], ftemp = 2.0;
+
+        if (dp->adapting) {
+            lo *= F0_SCALE_MIN / scale;
+            hi *= F0_SCALE_MAX / scale;
+        }
+
+        if (lo > 0.0)
+            ftemp = 2.0 * (hi - lo) / (hi + lo);
+
+        dp->maxpferr += ftemp * ftemp > MISSING ? ftemp * ftemp : MISSING;
+    }
+}
+
+/* Set up the dp cost weights for nform formants tracked at the given frame
+   rate.  If nom_f1 > 0, the nominal frequencies are derived from it.  If beam
+   is nonzero, only that many of the best paths are extended at each frame. */
+static void dp_init(dp_t *dp, size_t nform, double nom_f1, double frame_rate,
+                    size_t beam)
 {
-    return((fre[pnumb] >= fmins[fnumb])&&(fre[pnumb] <= fmaxs[fnumb]));
-}
-
-/* This does the real work of mapping frequencies to formants. */
-/* cand: candidate number being considered */
-/* pnumb: pole number under consideration */
-/* fnumb: formant number under consideration */
-/* maxp: number of poles to consider */
-/* maxf: number of formants to find */
-static int candy(short **pc, double *fre, int maxp, int maxf, bool domerge,
-                 int ncan, int cand, int pnumb, int fnumb,
-                 const double *fmins, const double *fmaxs)
+    dp->nform = nform;
+    dp->beam = beam;
+    dp->nom_f1 = nom_f1;
+    dp->adapting = false;
+
+    dp_scale(dp, 1.0);
+
+    dp->fbias = F_BIAS /(.01 * frame_rate);
+    dp->dffact = (DF_FACT * .01) * frame_rate; /* keep dffact scaled to frame rate */
+    dp->bfact = BAND_FACT /(.01 * frame_rate);
+    dp->ffact = DFN_FACT /(.01 * frame_rate);
+    dp->merge_cost = F_MERGE;
+    dp->domerge = !(dp->merge_cost > 1000.0);
+}
+
+/* Get the factor the formant ranges are scaled by for a speaker with the
+   given F0. */
+static double f0_scale(double f0) {
+    double scale = pow(f0 / F0_NOMINAL, F0_EXP);
+
+    return scale < F0_SCALE_MIN ? F0_SCALE_MIN :
+           scale > F0_SCALE_MAX ? F0_SCALE_MAX : scale;
+}
+
+/* Costs are summed in fixed point, so that two lattices whose paths have
+   come together differ by exactly the same amount at every mapping, no matter
+   where each was started. */
+static const double COST_SCALE = 1 << 20;
+
+static int64_t dp_cost(double cost) {
+    return llrint(cost * COST_SCALE);
+}
+
+#ifdef LIBFORMANT_TEST
+/* Let the tests keep every mapping, to check that the slack drops none that
+   matter. */
+static bool dp_unpruned = false;
+#endif
+
+/* Get the cost a mapping in a frame with the given rmsdffact may have above the
+   cheapest one and still be on the best path, given the rmsdffact of the next
+   frame. */
+static int64_t dp_slack(const dp_t *dp, double rmsdffact, double next) {
+#ifdef LIBFORMANT_TEST
+    if (dp_unpruned)
+        return INT64_MAX;
+#endif
+
+    /* Allow for rounding in the costs that are summed along the way. */
+    return dp_cost(rmsdffact * dp->maxpferr) + dp_cost(next * dp->maxpferr) + 2;
+}
+
+/* The local costs of the formants mapped so far by a candidate. */
+typedef struct {
+    double berr, ferr, fbias, merger;
+} dp_local_t;
+
+static int64_t dp_local_cost(const dp_t *dp, const dp_local_t *c) {
+    return dp_cost((dp->fbias * c->fbias) + (dp->bfact * c->berr) +
+                   c->merger + (dp->ffact * c->ferr));
+}
+
+/* A step left to take in the search for mappings: map formant f of candidate
+   cand, trying poles from p up.  If fresh is set, cand is yet to be created
+   as a copy of the formants below f of candidate src. */
+typedef struct {
+    short cand, src;
+    signed char p, f;
+    bool fresh;
+    dp_local_t cost;
+} dp_step_t;
+
+/* Get all likely mappings of the poles onto formants for a frame, with the
+   local cost of each, into f, whose lattice must have room for MAX_CANDIDATES
+   more of them from its first.  The poles are ordered by increasing frequency,
+   and every formant is mapped to a higher pole than the one below it or left
+   missing.
+
+   A mapping is dropped as soon as its cost exceeds that of the best mapping by
+   more than slack.  With slack as large as the cost of connecting to this
+   frame and to the next one could ever be, such a mapping can't be on the best
+   path through the lattice, so the tracks are as if nothing were dropped. */
+static void dp_candidates(const dp_t *dp, form_t *f, const pole_t *pole,
+                          int64_t slack)
 {
-    int i,j;
-
-    if(fnumb < maxf) pc[cand][fnumb] = -1;
-    if((pnumb < maxp)&&(fnumb < maxf)){
-        if(canbe(fmins, fmaxs, fre, pnumb,fnumb)){
-            pc[cand][fnumb] = pnumb;
-            if(domerge && fnumb == 0 && canbe(fmins, fmaxs, fre, pnumb, fnumb+1)){ /* allow for f1,f2 merger */
-                ncan++;
-                pc[ncan][0] = pc[cand][0];
-                ncan = candy(pc, fre, maxp, maxf, domerge, ncan, ncan,pnumb,fnumb+1,
-                             fmins, fmaxs); /* same pole, next formant */
+    enum { MAX_STEPS = 2 * MAX_CANDIDATES };
+
+    dp_step_t steps[MAX_STEPS];
+    short *cand[MAX_FORMANTS];
+    int64_t *local = f->lat->local + f->first;
+    int64_t best = INT64_MAX;
+    size_t n_steps = 0, ncand = 0, n = 0;
+    int maxp = pole->npoles, maxf = dp->nform;
+
+    f->ncand = 0;
+
+    for (int l = 0; l < maxf; l++)
+        cand[l] = form_cand(f, l);
+
+    if (!pole->npoles)	/* no pole frequencies available */
+        return;
+
+    steps[n_steps++] = (dp_step_t) { .cand = 0, .p = 0, .f = 0 };
+    ncand = 1;
+
+    while (n_steps) {
+        dp_step_t st = steps[--n_steps];
+        short c = st.cand;
+
+        if (st.fresh) {
+            if (ncand >= MAX_CANDIDATES)
+                continue;
+
+            c = ncand++;
+            for (int l = 0; l < st.f; l++)
+                cand[l][c] = cand[l][st.src];
+        }
+
+        local[c] = INT64_MAX;
+
+        for (int p = st.p, k = st.f;;) {
+            int64_t cost;
+
+            if (k >= maxf) {	/* every formant is mapped */
+                local[c] = dp_local_cost(dp, &st.cost);
+                if (local[c] < best)
+                    best = local[c];
+                break;
             }
-            ncan = candy(pc, fre, maxp, maxf, domerge, ncan, cand,pnumb+1,fnumb+1,
-                         fmins, fmaxs); /* next formant; next pole */
-            if(((pnumb+1) < maxp) && canbe(fmins, fmaxs, fre, pnumb+1,fnumb)){
-                /* try other frequencies for this formant */
-                ncan++;			/* add one to the candidate index/tally */
-                for(i=0; i<fnumb; i++)	/* clone the lower formants */
-                    pc[ncan][i] = pc[cand][i];
-                ncan = candy(pc, fre, maxp, maxf, domerge, ncan, ncan,pnumb+1,fnumb,
-                             fmins, fmaxs);
+
+            if (p >= maxp) {	/* no pole left for this formant */
+                int j;
+
+                cand[k][c] = -1;
+                st.cost.fbias += dp->fnom[k];
+                st.cost.berr += NOBAND;
+                st.cost.ferr += MISSING;
+
+                /* Go on to the next formant, starting from the pole of the
+                   highest formant mapped so far. */
+                for (j = k - 1; j > 0 && cand[j][c] < 0; j--)
+                    ;
+                p = (k && cand[j][c] >= 0) ? cand[j][c] : 0;
+                k++;
+            } else if (pole->freq[p] < dp->fmins[k] ||
+                       pole->freq[p] > dp->fmaxs[k]) {
+                p++;	/* this pole can't be this formant */
+                continue;
+            } else {
+                dp_local_t before = st.cost;
+
+                cand[k][c] = p;
+
+                if (k == 1 && dp->domerge && cand[0][c] >= 0 &&
+                    pole->freq[cand[0][c]] == pole->freq[p])
+                    st.cost.merger = dp->merge_cost;
+
+                st.cost.berr += pole->band[p];
+                st.cost.ferr += fabs(pole->freq[p] - dp->fnom[k]) / dp->fnom[k];
+                st.cost.fbias += pole->freq[p];
+
+                /* Later, try the next pole for this formant instead. */
+                if (p + 1 < maxp && n_steps < MAX_STEPS &&
+                    pole->freq[p + 1] >= dp->fmins[k] &&
+                    pole->freq[p + 1] <= dp->fmaxs[k])
+                {
+                    steps[n_steps++] = (dp_step_t) {
+                        .src = c, .p = p + 1, .f = k, .fresh = true,
+                        .cost = before,
+                    };
+                }
+
+                /* allow for f1,f2 merger: the same pole, next formant */
+                if (k == 0 && dp->domerge && pole->freq[p] <= dp->fmaxs[1] &&
+                    pole->freq[p] >= dp->fmins[1] && n_steps + 1 < MAX_STEPS)
+                {
+                    steps[n_steps++] = (dp_step_t) {
+                        .cand = c, .p = p + 1, .f = k + 1, .cost = st.cost,
+                    };
+                    steps[n_steps++] = (dp_step_t) {
+                        .src = c, .p = p, .f = k + 1, .fresh = true,
+                        .cost = st.cost,
+                    };
+                    break;
+                }
+
+                p++;
+                k++;
             }
-        } else {
-            ncan = candy(pc, fre, maxp, maxf, domerge, ncan, cand,pnumb+1,fnumb,
-                         fmins, fmaxs);
+
+            /* A mapping costs at least as much as its formants so far. */
+            cost = dp_local_cost(dp, &st.cost);
+            if (best < INT64_MAX && cost - best > slack)
+                break;
         }
     }
-    /* If all pole frequencies have been examined without finding one which
-       will map onto the current formant, go on to the next formant leaving the
-       current formant null. */
-    if((pnumb >= maxp) && (fnumb < maxf-1) && (pc[cand][fnumb] < 0)){
-        if(fnumb){
-            j=fnumb-1;
-            while((j>0) && pc[cand][j] < 0) j--;
-            i = ((j=pc[cand][j]) >= 0)? j : 0;
-        } else i = 0;
-        ncan = candy(pc, fre, maxp, maxf, domerge, ncan, cand,i,fnumb+1,
-                     fmins, fmaxs);
+
+    /* Keep the mappings that are cheap enough, in the order they were
+       found. */
+    for (size_t j = 0; j < ncand; j++) {
+        if (local[j] == INT64_MAX || local[j] - best > slack)
+            continue;
+
+        for (int l = 0; l < maxf; l++) {
+            short p = cand[l][j];
+
+            cand[l][n] = p;
+            form_freq(f, l)[n] = p >= 0 ? pole->freq[p] : 0;
+        }
+        local[n++] = local[j];
     }
 
-    return ncan;
+    f->ncand = n;
 }
 
-/* Given a set of pole frequencies and allowable formant frequencies
-   for nform formants, calculate all possible mappings of pole frequencies
-   to formants, including, possibly, mappings with missing formants. */
-/* freq: poles ordered by increasing FREQUENCY */
-static int get_fcand(int npole, double *freq, int nform, short **pcan,
-                     bool domerge, const double *fmins, const double *fmaxs)
-{
-    return candy(pcan, freq, npole, nform, domerge, 0, 0, 0, 0, fmins, fmaxs) + 1;
+/* Order candidates i and j of a frame by their cumulative costs, breaking
+   ties by index. */
+static bool dp_better(const int64_t *cumerr, short i, short j) {
+    return cumerr[i] < cumerr[j] || (cumerr[i] == cumerr[j] && i < j);
 }
 
-/* find the maximum in the "stationarity" function (stored in rms) */
-static double get_stat_max(pole_t **poles, int nframes) {
-    int i;
-    double amax, t;
+/* Choose the candidates of f that the next frame connects to: the dp->beam
+   with the lowest cumulative cost, or all of them if the beam is off.  The
+   choice depends only on the order of the costs, so lattices whose costs
+   differ by a constant choose alike. */
+static void dp_prune(const dp_t *dp, form_t *f) {
+    const int64_t *cumerr = f->lat->cumerr + f->first;
+    short *beam = f->lat->beam + f->first;
+    short sel[MAX_CANDIDATES], last = -1;
+    size_t lo = 0, hi = f->ncand, n = 0;
 
-    for(i=1, amax = (*poles++)->rms; i++ < nframes; )
-        if((t = (*poles++)->rms) > amax) amax = t;
+    if (!dp->beam || f->ncand <= dp->beam) {
+        for (size_t j = 0; j < f->ncand; j++)
+            beam[j] = j;
 
-    return(amax);
-}
+        f->nbeam = f->ncand;
 
-static void dpform(sound_t *ps, pole_t **poles, size_t nform, double nom_f1) {
-    double pferr, conerr, minerr, dffact, ftemp, berr, ferr, bfact, ffact,
-           rmsmax, fbias, **fr, **ba, rmsdffact, merger=0.0, merge_cost,
-           FBIAS;
-    int	ic, ip, mincan=0;
-    short	**pcan;
-    form_t	**fl;
-    int dmaxc,dminc,dcountf;
-    bool domerge;
+        return;
+    }
 
-    double	fnom[]  = {  500, 1500, 2500, 3500, 4500, 5500, 6500},/*  "nominal" freqs.*/
-                fmins[] = {   50,  400, 1000, 2000, 2000, 3000, 3000}, /* frequency bounds */
-                fmaxs[] = { 1500, 3500, 4500, 5000, 6000, 6000, 8000}; /* for 1st 5 formants */
+    for (size_t j = 0; j < f->ncand; j++)
+        sel[j] = j;
 
-    if(nom_f1 > 0.0) {
-        for(size_t i=0; i < MAX_FORMANTS; i++) {
-            fnom[i] = ((i * 2) + 1) * nom_f1;
-            fmins[i] = fnom[i] - ((i+1) * nom_f1) + 50.0;
-            fmaxs[i] = fnom[i] + (i * nom_f1) + 1000.0;
-        }
-    }
-    rmsmax = get_stat_max(poles, ps->n_samples);
-    FBIAS = F_BIAS /(.01 * ps->sample_rate);
-    /* Setup working values of the cost weights. */
-    dffact = (DF_FACT * .01) * ps->sample_rate; /* keep dffact scaled to frame rate */
-    bfact = BAND_FACT /(.01 * ps->sample_rate);
-    ffact = DFN_FACT /(.01 * ps->sample_rate);
-    merge_cost = F_MERGE;
-    if(merge_cost > 1000.0) domerge = false;
-
-    /* Allocate space for the formant and bandwidth arrays to be passed back. */
-    fr = malloc(sizeof(double*) * nform * 2);
-    ba = fr + nform;
-    for(size_t i=0;i < nform*2; i++){
-        fr[i] = malloc(sizeof(double) * ps->n_samples);
-    }
-
-    /* Allocate space for the raw candidate array. */
-    pcan = malloc(sizeof(short*) * MAX_CANDIDATES);
-    for(size_t i=0;i<MAX_CANDIDATES;i++)
-        pcan[i] = malloc(sizeof(short) * nform);
-
-    /* Allocate space for the dp lattice */
-    fl = malloc(sizeof(form_t*) * ps->n_samples);
-    for(size_t i=0;i < ps->n_samples; i++)
-        fl[i] = malloc(sizeof(form_t));
-
-    /* main formant tracking loop */
-    for(size_t i = 0; i < ps->n_samples; i++) {	/* for all analysis frames... */
-        size_t ncan = 0;		/* initialize candidate mapping count to 0 */
-
-        /* moderate the cost of frequency jumps by the relative amplitude */
-        rmsdffact = poles[i]->rms;
-        rmsdffact = rmsdffact/rmsmax;
-        rmsdffact = rmsdffact * dffact;
-
-        /* Get all likely mappings of the poles onto formants for this frame. */
-        if(poles[i]->npoles){	/* if there ARE pole frequencies available... */
-            ncan = get_fcand(poles[i]->npoles,poles[i]->freq,nform,pcan, domerge,
-                             fmins, fmaxs);
-
-            /* Allocate space for this frame's candidates in the dp lattice. */
-            fl[i]->prept =  malloc(sizeof(short) * ncan);
-            fl[i]->cumerr = malloc(sizeof(double) * ncan);
-            fl[i]->cand =   malloc(sizeof(short*) * ncan);
-
-            for(size_t j = 0; j < ncan; j++){	/* allocate cand. slots and install candidates */
-                fl[i]->cand[j] = malloc(sizeof(short) * nform);
-
-                for(size_t k = 0; k < nform; k++)
-                    fl[i]->cand[j][k] = pcan[j][k];
+    /* Quickselect the last candidate in the beam.  Everything in sel before
+       lo is better than it and everything from hi on is worse. */
+    while (last < 0) {
+        short pivot = sel[lo + (hi - lo) / 2], tmp;
+        size_t store = lo;
+
+        if (hi - lo == 1) {
+            last = sel[lo];
+            break;
+        }
+
+        for (size_t j = lo; j < hi; j++) {
+            if (dp_better(cumerr, sel[j], pivot)) {
+                tmp = sel[j];
+                sel[j] = sel[store];
+                sel[store++] = tmp;
             }
         }
-        fl[i]->ncand = ncan;
-        /* compute the distance between the current and previous mappings */
-        for(size_t j = 0; j < ncan; j++) {	/* for each CURRENT mapping... */
-            if( i ){		/* past the first frame? */
-                minerr = 0;
-                if(fl[i-1]->ncand) minerr = 2.0e30;
-                mincan = -1;
-                for(size_t k = 0; k < fl[i-1]->ncand; k++){ /* for each PREVIOUS map... */
-                    pferr = 0.0;
-                    for(size_t l = 0; l < nform; l++){
-                        ic = fl[i]->cand[j][l];
-                        ip = fl[i-1]->cand[k][l];
-                        if((ic >= 0)	&& (ip >= 0)){
-                            ftemp = 2.0 * fabs(poles[i]->freq[ic] - poles[i-1]->freq[ip])/
-                                (poles[i]->freq[ic] + poles[i-1]->freq[ip]);
-                            /* cost prop. to SQUARE of deviation to discourage large jumps */
-                            pferr += ftemp * ftemp;
-                        }
-                        else pferr += MISSING;
-                    }
-                    /* scale delta-frequency cost and add in prev. cum. cost */
-                    conerr = (rmsdffact * pferr) + fl[i-1]->cumerr[k];
-                    if(conerr < minerr){
-                        minerr = conerr;
-                        mincan = k;
-                    }
-                }			/* end for each PREVIOUS mapping... */
-            }	else {		/* (i.e. if this is the first frame... ) */
-                minerr = 0;
+
+        if (store == dp->beam - 1) {
+            last = pivot;
+        } else if (store > dp->beam - 1) {
+            hi = store;
+        } else {
+            /* Everything before store is kept, and the pivot is among the
+               rest, so move it to the front of them and skip past it. */
+            for (size_t j = store; j < hi; j++) {
+                if (sel[j] == pivot) {
+                    sel[j] = sel[store];
+                    sel[store] = pivot;
+                    break;
+                }
             }
 
-            fl[i]->prept[j] = mincan; /* point to best previous mapping */
-            /* (Note that mincan=-1 if there were no candidates in prev. fr.) */
-            /* Compute the local costs for this current mapping. */
-            berr = 0;
-            ferr = 0;
-            fbias = 0;
-            for(size_t k = 0; k < nform; k++){
-                ic = fl[i]->cand[j][k];
-                if(ic >= 0){
-                    if( !k ){		/* F1 candidate? */
-                        ftemp = poles[i]->freq[ic];
-                        merger = (domerge &&
-                                (ftemp == poles[i]->freq[fl[i]->cand[j][1]]))?
-                            merge_cost: 0.0;
-                    }
-                    berr += poles[i]->band[ic];
-                    ferr += (fabs(poles[i]->freq[ic]-fnom[k])/fnom[k]);
-                    fbias += poles[i]->freq[ic];
-                } else {		/* if there was no freq. for this formant */
-                    fbias += fnom[k];
-                    berr += NOBAND;
-                    ferr += MISSING;
+            lo = store + 1;
+        }
+    }
+
+    /* Keep the candidates no worse than the last one in the beam, in order. */
+    for (size_t j = 0; j < f->ncand; j++)
+        if (!dp_better(cumerr, last, j))
+            beam[n++] = j;
+
+    f->nbeam = n;
+}
+
+/* Connect each candidate mapping in cur to the best mapping in the previous
+   frame (prev, which is NULL at start of utterance) and compute its cumulative
+   cost.  rmsdffact scales the cost of frequency changes between frames. */
+static void dp_connect(const dp_t *dp, form_t *cur, const form_t *prev,
+                       double rmsdffact)
+{
+    /* the frequencies and costs of the previous mappings in the beam, if it
+       leaves any out, so the loops below run through them in a row */
+    double beamfreq[MAX_FORMANTS][MAX_CANDIDATES];
+    int64_t beamerr[MAX_CANDIDATES];
+    double pferr[MAX_CANDIDATES];
+    const double *pfreq[MAX_FORMANTS], *cfreq[MAX_FORMANTS];
+    const int64_t *perr = NULL;
+    const short *pbeam = NULL;
+    const kern_impl_t *kern = kern_best();
+    int64_t *cumerr = cur->lat->cumerr + cur->first;
+    const int64_t *local = cur->lat->local + cur->first;
+    short *prept = cur->lat->prept + cur->first;
+    size_t np = prev ? prev->nbeam : 0;
+    int64_t conerr, minerr;
+    int mincan;
+
+    for (size_t l = 0; l < dp->nform; l++)
+        cfreq[l] = form_freq(cur, l);
+
+    if (prev && prev->nbeam < prev->ncand) {
+        pbeam = prev->lat->beam + prev->first;
+
+        for (size_t b = 0; b < np; b++)
+            beamerr[b] = prev->lat->cumerr[prev->first + pbeam[b]];
+
+        for (size_t l = 0; l < dp->nform; l++) {
+            const double *f = form_freq(prev, l);
+
+            for (size_t b = 0; b < np; b++)
+                beamfreq[l][b] = f[pbeam[b]];
+
+            pfreq[l] = beamfreq[l];
+        }
+
+        perr = beamerr;
+    } else if (prev) {
+        for (size_t l = 0; l < dp->nform; l++)
+            pfreq[l] = form_freq(prev, l);
+
+        perr = prev->lat->cumerr + prev->first;
+    }
+
+    /* compute the distance between the current and previous mappings */
+    for(size_t j = 0; j < cur->ncand; j++) {	/* for each CURRENT mapping... */
+        minerr = 0;
+        mincan = -1;
+        if( prev ){		/* past the first frame? */
+            if(np) minerr = INT64_MAX;
+            for(size_t b = 0; b < np; b++)
+                pferr[b] = 0.0;
+            for(size_t l = 0; l < dp->nform; l++){	/* for each formant... */
+                double cf = cfreq[l][j];
+
+                if(!(cf > 0)){	/* missing formants all cost the same */
+                    for(size_t b = 0; b < np; b++)
+                        pferr[b] += MISSING;
+                    continue;
                 }
+
+                /* add the cost of the jump from each PREVIOUS map, prop. to
+                   the SQUARE of deviation to discourage large jumps */
+                kern->jump(cf, pfreq[l], pferr, np, MISSING);
             }
+            for(size_t b = 0; b < np; b++){
+                /* scale delta-frequency cost and add in prev. cum. cost */
+                conerr = dp_cost(rmsdffact * pferr[b]) + perr[b];
+                if(conerr < minerr){
+                    minerr = conerr;
+                    mincan = pbeam ? pbeam[b] : (int) b;
+                }
+            }			/* end for each PREVIOUS mapping... */
+        }
 
-            /* Compute the total cost of this mapping and best previous. */
-            fl[i]->cumerr[j] = (FBIAS * fbias) + (bfact * berr) + merger +
-                (ffact * ferr) + minerr;
-        }			/* end for each CURRENT mapping... */
-    }				/* end for all analysis frames... */
-
-    /* Pick the candidate in the final frame with the lowest cost. */
-    /* Starting with that min.-cost cand., work back thru the lattice. */
-    dmaxc = 0;
-    dminc = 100;
-    dcountf = 0;
-    mincan = -1;
-    for (size_t m = 1; m <= ps->n_samples; m += 1) {
-        size_t i = ps->n_samples - m;
+        prept[j] = mincan; /* point to best previous mapping */
+        /* (Note that mincan=-1 if there were no candidates in prev. fr.) */
+
+        /* Compute the total cost of this mapping and best previous. */
+        cumerr[j] = local[j] + minerr;
+    }			/* end for each CURRENT mapping... */
+
+    dp_prune(dp, cur);
+}
+
+/* Pick the candidate in the final frame with the lowest cost.  Starting with
+   that min.-cost cand., work back thru the n frames of the lattice, storing the
+   chosen formants in frames.  rmsmax is the rms of the loudest frame. */
+static void dp_backtrack(const dp_t *dp, const form_t *fl, pole_t **poles,
+                         size_t n, double rmsmax, formant_frame_t *frames)
+{
+    int64_t minerr;
+    int mincan = -1;
+
+    for (size_t m = 1; m <= n; m += 1) {
+        size_t i = n - m;
+        const int64_t *cumerr = fl[i].lat->cumerr + fl[i].first;
         if(mincan < 0)		/* need to find best starting candidate? */
-            if(fl[i]->ncand){	/* have candidates at this frame? */
-                minerr = fl[i]->cumerr[0];
+            if(fl[i].ncand){	/* have candidates at this frame? */
+                minerr = cumerr[0];
                 mincan = 0;
-                for(size_t j=1; j<fl[i]->ncand; j++)
-                    if( fl[i]->cumerr[j] < minerr ){
-                        minerr = fl[i]->cumerr[j];
+                for(size_t j=1; j<fl[i].ncand; j++)
+                    if( cumerr[j] < minerr ){
+                        minerr = cumerr[j];
                         mincan = j;
                     }
             }
+        frames[i].rms = poles[i]->rms;
+        frames[i].f0 = poles[i]->f0;
+        frames[i].pv = poles[i]->pv;
+        frames[i].voiced = false;
         if(mincan >= 0){	/* if there is a "best" candidate at this frame */
-            int j;
-            if((j = fl[i]->ncand) > dmaxc) dmaxc = j;
-            else
-                if( j < dminc) dminc = j;
-            dcountf++;
-            for(size_t j=0; j<nform; j++){
-                int k = fl[i]->cand[mincan][j];
+            for(size_t j=0; j<dp->nform; j++){
+                int k = form_cand(&fl[i], j)[mincan];
                 if(k >= 0){
-                    fr[j][i] = poles[i]->freq[k];
-                    ba[j][i] = poles[i]->band[k];
+                    frames[i].freq[j] = poles[i]->freq[k];
+                    frames[i].band[j] = poles[i]->band[k];
                 } else {		/* IF FORMANT IS MISSING... */
-                    if(i < ps->n_samples - 1){
-                        fr[j][i] = fr[j][i+1]; /* replicate backwards */
-                        ba[j][i] = ba[j][i+1];
+                    if(i < n - 1){
+                        frames[i].freq[j] = frames[i+1].freq[j]; /* replicate backwards */
+                        frames[i].band[j] = frames[i+1].band[j];
                     } else {
-                        fr[j][i] = fnom[j]; /* or insert neutral values */
-                        ba[j][i] = NOBAND;
+                        frames[i].freq[j] = dp->fnom[j]; /* or insert neutral values */
+                        frames[i].band[j] = NOBAND;
                     }
                 }
             }
-            mincan = fl[i]->prept[mincan];
+            frames[i].cost = fl[i].lat->local[fl[i].first + mincan] /
+                             COST_SCALE;
+            frames[i].voiced = form_cand(&fl[i], 0)[mincan] >= 0 &&
+                               poles[i]->rms >= rmsmax * VOICED_RMS;
+            mincan = fl[i].lat->prept[fl[i].first + mincan];
         } else {		/* if no candidates, fake with "nominal" frequencies. */
-            for(size_t j = 0; j < nform; j++){
-                fr[j][i] = fnom[j];
-                ba[j][i] = NOBAND;
+            for(size_t j = 0; j < dp->nform; j++){
+                frames[i].freq[j] = dp->fnom[j];
+                frames[i].band[j] = NOBAND;
             }
+            frames[i].cost = INFINITY;
         }			/* note that mincan will remain =-1 if no candidates */
     }				/* end unpacking formant tracks from the dp lattice */
-    /* Deallocate all the DP lattice work space. */
-    for (size_t m = 1; m <= ps->n_samples; m += 1) {
-        size_t i = ps->n_samples - m;
-        if(fl[i]->ncand){
-            if(fl[i]->cand) {
-                for(size_t j = 0; j < fl[i]->ncand; j++)
-                    free(fl[i]->cand[j]);
-                free(fl[i]->cand);
-                free(fl[i]->cumerr);
-                free(fl[i]->prept);
-            }
-        }
-    }
-    for(size_t i=0; i<ps->n_samples; i++)
-        free(fl[i]);
-    free(fl);
-    fl = 0;
+}
 
-    for(size_t i=0; i<ps->n_samples; i++) {
-        free(poles[i]->freq);
-        free(poles[i]->band);
-        free(poles[i]);
-    }
-    free(poles);
+/* Number of samples read by LPC analysis of a window of size samples: the
+   window plus one sample for preemphasis, and BSA reads another lpc_order + 1
+   past that. */
+static size_t lpc_span(const formant_opts_t *opts, size_t size) {
+    if (opts->lpc_type == LPC_TYPE_BSA)
+        return size + opts->lpc_order + 2;
+
+    return size + 1;
+}
+
+/* Number of bytes of scratch taken from the workspace to analyse one frame of
+   size samples. Every allocation is held until the frame is done and may be
+   rounded up, so there's some slack for each. */
+static size_t lpc_scratch(const formant_opts_t *opts, size_t size) {
+    enum { ALLOCS = 16, ALIGN = 16 };
+
+    size_t span = lpc_span(opts, size), m = opts->lpc_order, n = 0;
+
+    switch (opts->lpc_type) {
+    case LPC_TYPE_NORMAL:
+        /* the window, the widened one of single precision, and the transform
+           of the autocorrelation */
+        n = 2 * span + 2 * fft_size(span + m);
+    break;
 
-    /* Deallocate space for the raw candidate aray. */
-    for(size_t i=0;i<MAX_CANDIDATES;i++) free(pcan[i]);
-    free(pcan);
+    case LPC_TYPE_BSA:
+        n = span;
+    break;
 
-    ps->n_channels = nform * 2;
+    case LPC_TYPE_COVAR:
+        n = span + (m + 1) * (m + 1) / 2 + 3 * (m + 3);
+    break;
 
-    for (size_t i = 0; i < ps->n_samples; i++)
-        for (size_t j = 0; j < ps->n_channels; j++)
-            sound_set_sample(ps, j, i, fr[j][i]);
+    case LPC_TYPE_BURG:
+        /* the forward and backward errors */
+        n = 2 * span;
+    break;
 
-    for(size_t i = 0; i < nform*2; i++) free(fr[i]);
-    free(fr);
+    case LPC_TYPE_INVALID:
+    break;
+    }
+
+    if (opts->vad)
+        n += size;
+
+    /* the frame, its energies, and those of its decimated copy, the lags and
+       their peaks, and the transform of the lags */
+    if (opts->pitch)
+        n += 6 * size + 4 + 2 * fft_size(2 * size);
+
+    return sizeof(double) * n + ALLOCS * ALIGN;
 }
 
 /* computation and I/O routines for dealing with LPC poles */
-static double frand() {
-    return (((double)rand())/(double)RAND_MAX);
+
+/* Build the Hamming window of n points used by bsa, which unlike the others
+   starts at its edge rather than half a point in. */
+static void bsa_window(void *data, int n, int unused) {
+    double *w = data, fham = 6.28318506 / n;
+
+    (void)unused;
+
+    for(int i=0; i < n; i++)
+        w[i] = .54 - .46 * cos(i * fham);
 }
 
 /* a quick and dirty interface to bsa's stabilized covariance LPC */
-static int lpcbsa(int np, int wind, short *data, double *lpc, double *energy,
-                  double preemp)
+static int lpcbsa(formant_workspace_t *ws, int np, int wind, short *data,
+                  double *lpc, double *energy, double preemp)
 {
-    int i, owind=0, wind1;
-    double w[1000];
-    double rc[LPC_ORDER_MAX],phi[LPC_ORDER_MAX*LPC_ORDER_MAX],shi[LPC_ORDER_MAX],sig[1000];
-    double xl = .09, fham, amax;
-    double *psp1, *psp3, *pspl;
-
-    if(owind != wind) {		/* need to compute a new window? */
-        fham = 6.28318506 / wind;
-        for(psp1=w,i=0;i<wind;i++,psp1++)
-            *psp1 = .54 - .46 * cos(i * fham);
-        owind = wind;
-    }
+    int owind = wind, wind1;
+    const double *w = cache_get(CACHE_BSA_WINDOW, wind, 0,
+                                sizeof(double) * wind, bsa_window);
+    double rc[LPC_ORDER_MAX],phi[LPC_ORDER_MAX*LPC_ORDER_MAX],shi[LPC_ORDER_MAX],*sig;
+    double xl = .09, amax;
+    double *psp3, *pspl;
+
     wind += np + 1;
     wind1 = wind-1;
+    sig = formant_workspace_alloc(ws, sizeof(double) * wind);
 
     for(psp3=sig,pspl=sig+wind; psp3 < pspl; )
-        *psp3++ = (double)(*data++) + .016 * frand() - .008;
+        *psp3++ = (double)(*data++) + .016 * formant_workspace_rand(ws) - .008;
     for(psp3=sig+1,pspl=sig+wind;psp3<pspl;psp3++)
         *(psp3-1) = *psp3 - preemp * *(psp3-1);
     for(amax = 0.,psp3=sig+np,pspl=sig+wind1;psp3<pspl;psp3++)
@@ -529,107 +929,134 @@ static int lpcbsa(int np, int wind, short *data, double *lpc, double *energy,
     return dlpcwtd(sig,&wind1,lpc,&np,rc,phi,shi,&xl,w) == np;
 }
 
-static pole_t **lpc_poles(sound_t *sp, const formant_opts_t *opts) {
-    enum { LPC_STABLE = 70 };
-
-    int size, step, nform, init;
-    size_t nfrm;
-    pole_t **poles;
-    double energy, lpca[LPC_ORDER_MAX], normerr, *bap, *frp, *rhp;
-    double rr[LPC_ORDER_MAX], ri[LPC_ORDER_MAX];
-    short *datap, *dporg;
-    int ord;
+/* Run LPC analysis on the size samples at data and find the resulting pole
+   frequencies and bandwidths, storing them in pole.  rr and ri carry the
+   root-search starting points from one frame to the next, and init is set
+   whenever the search should restart in a neutral zone near the unit circle.
+   If given is set, it holds the LPC coefficients of the frame as worked out
+   beforehand, and given_rms its rms, so only the rest is done here. */
+static void lpc_frame(formant_workspace_t *ws, const formant_opts_t *opts,
+                      double sample_rate, short *data, int size,
+                      const double *given, double given_rms, pole_t *pole,
+                      double *rr, double *ri, bool *init)
+{
+    double energy = 0, lpca[LPC_ORDER_MAX+1], normerr;
     double alpha, r0;
-    double flo;
-    double x;
-
-    // Duration of the given samples in seconds.
-    double samples_dur;
-
-    bap = NULL;
-    frp = NULL;
-    rhp = NULL;
-
-    x = PI / (opts->lpc_order + 1);
+    double flo, x;
+    int ord, nform;
 
-    samples_dur = (double)(sp->n_samples) / sp->sample_rate;
+    STATS_ADD(ws, frames, 1);
 
-    if (samples_dur < opts->window_dur)
-        return NULL;
-
-    nfrm = 1 + (int)((samples_dur - opts->window_dur) / opts->frame_dur);
-    size = (int)(.5 + opts->window_dur * sp->sample_rate);
-    step = (int)(.5 + opts->frame_dur * sp->sample_rate);
-    poles = malloc(nfrm * sizeof(pole_t *));
-    dporg = malloc(sizeof(short) * sp->n_samples);
-    datap = dporg;
+    /* don't even window frames of silence or noise */
+    if (opts->vad) {
+        vad_t v;
 
-    for (size_t i = 0; i < sp->n_samples; i++)
-        datap[i] = (short) sound_get_sample(sp, 0, i);
+        STATS_BEGIN(ws, FORMANT_STAGE_VAD);
+        vad_measure(ws, data, size, &v);
+        STATS_END(ws, FORMANT_STAGE_VAD);
 
-    init = true;
+        if (!vad_is_voiced(&v, opts->vad_floor)) {
+            STATS_ADD(ws, skipped, 1);
+            pole->rms = pole->rms2 = pole->f0 = pole->pv = pole->change = 0.0;
+            pole->npoles = 0;
+            *init = true;
+            return;
+        }
+    }
 
-    for (size_t j = 0; j < nfrm; j += 1) {
-        poles[j] = malloc(sizeof(pole_t));
-        poles[j]->freq = frp = malloc(sizeof(double)*opts->lpc_order);
-        poles[j]->band = bap = malloc(sizeof(double)*opts->lpc_order);
+    if (given) {
+        memcpy(lpca, given, sizeof(double) * (opts->lpc_order + 1));
+        energy = given_rms;
+    } else {
+        STATS_BEGIN(ws, FORMANT_STAGE_LPC);
 
         switch(opts->lpc_type) {
         case LPC_TYPE_NORMAL:
-            lpc(opts->lpc_order, LPC_STABLE, size, datap, lpca, rhp, NULL, &normerr,
-                &energy, opts->pre_emph_factor, opts->window_type);
+            lpc(ws, opts->lpc_order, LPC_STABLE, size, data, lpca, NULL, NULL,
+                &normerr, &energy, opts->pre_emph_factor, opts->window_type,
+                opts->precision);
         break;
 
         case LPC_TYPE_BSA:
-            lpcbsa(opts->lpc_order, size, datap, lpca, &energy, opts->pre_emph_factor);
+            lpcbsa(ws, opts->lpc_order, size, data, lpca, &energy,
+                   opts->pre_emph_factor);
         break;
 
         case LPC_TYPE_COVAR:
             ord = opts->lpc_order;
-            w_covar(datap, &ord, size, 0, lpca, &alpha, &r0, opts->pre_emph_factor, 0);
+            w_covar(ws, data, &ord, size, 0, lpca, &alpha, &r0,
+                    opts->pre_emph_factor, 0);
             energy = sqrt(r0 / (size - ord));
         break;
 
+        case LPC_TYPE_BURG:
+            lpc_burg(ws, opts->lpc_order, size, data, lpca, &energy,
+                     opts->pre_emph_factor, opts->window_type);
+        break;
+
         case LPC_TYPE_INVALID:
         break;
         }
-        poles[j]->change = 0.0;
 
-        /* set up starting points for the root search near unit circle */
-        if (init) {
-            for (size_t i = 0; i <= opts->lpc_order; i += 1) {
-                flo = opts->lpc_order - i;
-                rr[i] = 2.0 * cos((flo + 0.5) * x);
-                ri[i] = 2.0 * sin((flo + 0.5) * x);
-            }
-        }
+        STATS_END(ws, FORMANT_STAGE_LPC);
+    }
 
-        poles[j]->rms = energy;
+    pole->change = 0.0;
 
-        /* don't waste time on low energy frames */
-        if (energy > 1.0) {
-            formant(opts->lpc_order, sp->sample_rate, lpca, &nform, frp, bap, rr, ri);
-            poles[j]->npoles = nform;
-            init=false;		/* use old poles to start next search */
-        } else {			/* write out no pole frequencies */
-            poles[j]->npoles = 0;
-            init = true;		/* restart root search in a neutral zone */
-        }
+    if (opts->pitch) {
+        pitch_t p;
+
+        STATS_BEGIN(ws, FORMANT_STAGE_PITCH);
+        pitch_estimate(ws, data, size, sample_rate, &p);
+        STATS_END(ws, FORMANT_STAGE_PITCH);
 
-        datap += step;
+        pole->f0 = p.f0;
+        pole->pv = p.pv;
+        pole->rms2 = p.rms;
+    } else {
+        pole->f0 = pole->pv = pole->rms2 = 0.0;
+    }
+
+    /* set up starting points for the root search near unit circle */
+    if (*init) {
+        x = PI / (opts->lpc_order + 1);
+        for (size_t i = 0; i <= opts->lpc_order; i += 1) {
+            flo = opts->lpc_order - i;
+            rr[i] = 2.0 * cos((flo + 0.5) * x);
+            ri[i] = 2.0 * sin((flo + 0.5) * x);
+        }
     }
 
-    free(dporg);
+    pole->rms = energy;
 
-    sp->sample_rate = (size_t)(1.0 / opts->frame_dur);
-    sp->n_channels = opts->lpc_order;
-    sp->n_samples = nfrm;
+    /* don't waste time on low energy frames */
+    if (energy > 1.0) {
+        STATS_BEGIN(ws, FORMANT_STAGE_ROOTS);
 
-    for (size_t i = 0; i < nfrm; i++)
-        for (size_t j = 0; j < opts->lpc_order; j++)
-            sound_set_sample(sp, j, i, poles[i]->freq[j]);
+        switch (opts->pole_type) {
+        case POLE_TYPE_ROOTS:
+            formant(ws, opts->lpc_order, sample_rate, lpca, &nform,
+                    pole->freq, pole->band, rr, ri, *init);
+        break;
+
+        case POLE_TYPE_PEAKS:
+            formant_peaks(opts->lpc_order, sample_rate, lpca, &nform,
+                          pole->freq, pole->band);
+        break;
+
+        case POLE_TYPE_INVALID:
+            nform = 0;
+        break;
+        }
 
-    return poles;
+        STATS_END(ws, FORMANT_STAGE_ROOTS);
+        pole->npoles = nform;
+        *init = false;		/* use old poles to start next search */
+    } else {			/* write out no pole frequencies */
+        STATS_ADD(ws, skipped, 1);
+        pole->npoles = 0;
+        *init = true;		/* restart root search in a neutral zone */
+    }
 }
 
 /*	Copyright (c) 1987, 1988, 1989 AT&T	*/
@@ -639,41 +1066,13 @@ static pole_t **lpc_poles(sound_t *sp, const formant_opts_t *opts) {
 /*	The copyright notice above does not evidence any	*/
 /*	actual or intended publication of such source code.	*/
 
-/* create the coefficients for a symmetric FIR lowpass filter using the
-   window technique with a Hanning window. */
-static void lc_lin_fir(double fc, int *nf, double *coef) {
-    int	i, n;
-    double	twopi, fn, c;
-
-    if(((*nf % 2) != 1) || (*nf > 127)) {
-        if(*nf <= 126) *nf = *nf + 1;
-        else *nf = 127;
-    }
-    n = (*nf + 1)/2;
-
-    /*  compute part of the ideal impulse response */
-    twopi = PI * 2.0;
-    coef[0] = 2.0 * fc;
-    c = PI;
-    fn = twopi * fc;
-    for(i=1;i < n; i++) coef[i] = sin(i * fn)/(c * i);
-
-    /* Now apply a Hanning window to the (infinite) impulse response. */
-    fn = twopi/((double)(*nf - 1));
-    for(i=0;i<n;i++)
-        coef[i] *= (.5 + (.5 * cos(fn * ((double)i))));
-}
-
-/* ic contains 1/2 the coefficients of a symmetric FIR filter with unity
-   passband gain.  This filter is convolved with the signal in buf.
-   The output is placed in buf2.  If invert != 0, the filter magnitude
+/* Expand the half filter in ic into the full symmetric filter co, which holds
+   (ncoef * 2) - 1 coefficients.  If invert != 0, the filter magnitude
    response will be inverted. */
-static void do_fir(short *buf, int in_samps, short *bufo, int ncoef,
-                   short *ic, int invert)
-{
-    short  *buft, *bufp, *bufp2, stem;
-    short co[256], mem[256];
-    int i, j, k, l, m, sum, integral;
+static void fir_expand(const short *ic, int ncoef, int invert, short *co) {
+    const short *bufp;
+    short *buft, *bufp2, stem;
+    int i, integral;
 
     bufp = ic + ncoef - 1;
     bufp2 = co;
@@ -704,263 +1103,2133 @@ static void do_fir(short *buf, int in_samps, short *bufo, int ncoef,
         integral += *bufp;
         *buft = integral - *bufp;
     }
+}
+
+/* Half of a fixed-point symmetric FIR filter, as shared through the cache. */
+typedef struct {
+    int ncoef;          /* number of coefficients used */
+    short ic[128];
+} fir_coefs_t;
+
+/* Set up f to run the full symmetric filter whose half is in fc.  If
+   invert != 0, the filter magnitude response will be inverted. */
+static void fir_init_half(fir_t *f, const fir_coefs_t *fc, int invert) {
+    short co[FIR_TAPS_MAX];
+    bool ok;
+
+    fir_expand(fc->ic, fc->ncoef, invert, co);
+    ok = fir_init(f, co, (fc->ncoef << 1) - 1);
+    assert(ok);
+    (void)ok;
+}
 
-    buft = mem;
+/* Build half of the highpass filter run by highpass().  This assumes the
+   sampling frequency is 10kHz and that the FIR is a Hanning function of
+   (n/10)ms duration. */
+static void highpass_build(void *data, int n, int unused) {
+    fir_coefs_t *fc = data;
+    double scale, fn;
 
-    for (i = ncoef - 1; i > 0; i -= 1)
-        *buft++ = 0;
+    (void)unused;
 
-    for (i = ncoef; i > 0; i -= 1)
-        *buft++ = *buf++;
+    fc->ncoef = 1 + (n/2);
+    fn = PI * 2.0 / (n - 1);
+    scale = 32767.0/(.5 * n);
+    for(int i=0; i < fc->ncoef; i++)
+        fc->ic[i] = (short) (scale * (.5 + (.4 * cos(fn * ((double)i)))));
+}
 
-    l = 16384;
-    m = 15;
-    k = (ncoef << 1) - 1;
+/* Get half of the highpass filter run by highpass(). */
+static const fir_coefs_t *highpass_coefs(void) {
+    return cache_get(CACHE_HIGHPASS, HIGHPASS_LEN, 0, sizeof(fir_coefs_t),
+                     highpass_build);
+}
 
-    for (i = in_samps - ncoef; i > 0; i -= 1) {
-        buft = mem;
-        bufp = co;
-        bufp2 = mem + 1;
-        sum = 0;
+/* Number of frames whose root searches are chained, each starting from the
+   roots found in the last.  The search restarts at the start of every block,
+   so blocks can be analysed independently. */
+enum { ROOT_BLOCK = 64 };
+/* number of samples filtered as a unit of work */
+enum { FILTER_BLOCK = 1 << 14 };
+/* fewest frames worth giving a segment of the dp lattice of its own */
+enum { DP_SEGMENT_MIN = 1000 };
+/* candidates per frame to make room for up front in a segment of the lattice,
+   which holds most frames up to order 14 */
+enum { DP_CANDIDATES_GUESS = 16 };
+
+typedef struct analysis analysis_t;
+
+/* Do unit of work number i of a pass over the analysis, taking scratch memory
+   from ws. */
+typedef void (*analysis_pass_t)(analysis_t *a, formant_workspace_t *ws,
+                                size_t i);
+
+typedef struct {
+    analysis_t *a;
+    formant_workspace_t *ws;
+} analysis_worker_t;
+
+/* The state shared by the threads analysing a sound.  Every unit of work
+   depends only on its number, so the results don't depend on how the units
+   are spread across the threads. */
+struct analysis {
+    const formant_opts_t *opts;
+    dp_t dp;
+
+    /* the track being analysed at the rate of the sound */
+    const short *in;
+    size_t n_in;
+
+    /* the sound at the analysis rate, before and after highpass filtering,
+       and the filters used to get there */
+    resampler_t rs;
+    short *ds;
+    fir_t hp;
+    short *data;
+    size_t n;
+    size_t sample_rate;
+
+    /* analysis window and step between frames, in samples */
+    int size, step;
 
-        for (j = k; j > 0; j -= 1) {
-            sum += (*bufp * *buft + l) >> m;
-            *buft = *bufp2;
+    size_t nfrm;
+    pole_t **poles;
+    double rmsmax;
 
-            bufp += 1;
-            buft += 1;
-            bufp2 += 1;
-        }
+    /* the dp lattice, split into n_seg segments with segment i holding
+       frames seg[i] until seg[i+1] and their candidates in lat[i] */
+    form_t *fl;
+    lattice_t *lat;
+    size_t n_seg, *seg;
 
-        buft -= 1;
+    /* the pass being run and its next unit of work */
+    analysis_pass_t pass;
+    size_t n_units, next;
 
-        *buft = *buf;		/* new data to memory */
-        *bufo = sum;
+    size_t n_workers;
+    analysis_worker_t *workers;
+    pthread_t *threads;
+};
 
-        buf += 1;
-        bufo += 1;
-    }
+static void *analysis_work(void *arg) {
+    analysis_worker_t *w = arg;
+    analysis_t *a = w->a;
+    size_t i;
 
-    for (i = ncoef; i > 0; i -= 1) {	/* pad data end with zeros */
-        buft = mem;
-        bufp = co;
-        bufp2 = mem + 1;
-        sum = 0;
+    while ((i = __atomic_fetch_add(&a->next, 1, __ATOMIC_RELAXED)) < a->n_units)
+        a->pass(a, w->ws, i);
 
-        for (j = k; j > 0; j -= 1) {
-            sum += (*bufp * *buft + l) >> m;
-            *buft = *bufp2;
+    return NULL;
+}
 
-            bufp += 1;
-            buft += 1;
-            bufp2 += 1;
-        }
-        *--buft = 0;
-        *bufo++ = sum;
+/* Run the n_units units of work of the given pass across the workers, and
+   return once they're all done.  If a thread can't be started, the calling
+   thread takes up its share. */
+static void analysis_run(analysis_t *a, analysis_pass_t pass, size_t n_units) {
+    size_t started = 1;
+
+    a->pass = pass;
+    a->n_units = n_units;
+    a->next = 0;
+
+    while (started < a->n_workers && started < n_units &&
+           !pthread_create(&a->threads[started], NULL, analysis_work,
+                           &a->workers[started]))
+    {
+        started += 1;
     }
+
+    analysis_work(&a->workers[0]);
+
+    for (size_t i = 1; i < started; i += 1)
+        pthread_join(a->threads[i], NULL);
 }
 
-static int get_abs_maximum(short *d, int n) {
-    int i;
-    short amax, t;
+/* Resample a block of the sound to the analysis rate. */
+static void pass_downsample(analysis_t *a, formant_workspace_t *ws, size_t i) {
+    size_t first = i * FILTER_BLOCK;
+    size_t count = a->n - first < FILTER_BLOCK ? a->n - first : FILTER_BLOCK;
+
+    STATS_BEGIN(ws, FORMANT_STAGE_DOWNSAMPLE);
+    resampler_range(&a->rs, a->in, a->n_in, first, count, a->ds + first);
+    STATS_END(ws, FORMANT_STAGE_DOWNSAMPLE);
+}
 
-    if((t = *d++) >= 0) amax = t;
-    else amax = -t;
+/* Highpass filter a block of the sound, dropping the filter's delay. */
+static void pass_highpass(analysis_t *a, formant_workspace_t *ws, size_t i) {
+    size_t first = i * FILTER_BLOCK;
+    size_t count = a->n - first < FILTER_BLOCK ? a->n - first : FILTER_BLOCK;
 
-    for(i = n-1; i-- > 0; ) {
-        if((t = *d++) > amax) amax = t;
-        else {
-            if(-t > amax) amax = -t;
-        }
+    STATS_BEGIN(ws, FORMANT_STAGE_HIGHPASS);
+    fir_range(&a->hp, a->ds, a->n, first + a->hp.taps / 2, count,
+              a->data + first);
+    STATS_END(ws, FORMANT_STAGE_HIGHPASS);
+}
+
+/* Run LPC analysis and find the poles of a block of frames. */
+static void pass_poles(analysis_t *a, formant_workspace_t *ws, size_t i) {
+    size_t first = i * ROOT_BLOCK;
+    size_t end = a->nfrm - first < ROOT_BLOCK ? a->nfrm : first + ROOT_BLOCK;
+    double rr[LPC_ORDER_MAX+1], ri[LPC_ORDER_MAX+1];
+    bool init = true;
+
+    for (size_t j = first; j < end; j += 1) {
+        formant_workspace_mark_t mark = formant_workspace_mark(ws);
+
+        /* Give every frame its own random numbers, so they don't depend on
+           which frames were analysed before it. */
+        formant_workspace_seed(ws, (j + 1) * UINT64_C(0x9e3779b97f4a7c15));
+        lpc_frame(ws, a->opts, a->sample_rate, a->data + j * a->step,
+                  a->size, NULL, 0, a->poles[j], rr, ri, &init);
+        formant_workspace_release(ws, mark);
     }
-    return((int)amax);
 }
 
-static void dwnsamp(short *buf, int in_samps, short **buf2, size_t *out_samps,
-                    int insert, int decimate, int ncoef, short *ic, int *smin,
-                    int *smax)
-{
-    short  *bufp, *bufp2;
-    short	*buft;
-    int i, j, k, l, m;
-    int imax, imin;
-
-    *buf2 = buft = malloc(sizeof(short)*insert*in_samps);
-
-    k = imax = get_abs_maximum(buf,in_samps);
-    if (k == 0) k = 1;
-    if(insert > 1) k = (32767 * 32767)/k;	/*  prepare to scale data */
-    else k = (16384 * 32767)/k;
-    l = 16384;
-    m = 15;
-
-    /* Insert zero samples to boost the sampling frequency and scale the
-       signal to maintain maximum precision. */
-    for(i=0, bufp=buft, bufp2=buf; i < in_samps; i++) {
-        *bufp++ = ((k * (*bufp2++)) + l) >> m ;
-        for(j=1; j < insert; j++) *bufp++ = 0;
-    }
-
-    do_fir(buft,in_samps*insert,buft,ncoef,ic,0);
-
-    /*	Finally, decimate and return the downsampled signal. */
-    *out_samps = j = (in_samps * insert)/decimate;
-    k = decimate;
-    for(i=0, bufp=buft, imax = imin = *bufp; i < j; bufp += k,i++) {
-        *buft++ = *bufp;
-        if(imax < *bufp) imax = *bufp;
-        else
-            if(imin > *bufp) imin = *bufp;
-    }
-    *smin = imin;
-    *smax = imax;
-    *buf2 = realloc(*buf2,sizeof(short) * (*out_samps));
-}
-
-static int ratprx(double a, int *k, int *l, int qlim) {
-    double aa, af, q, em, qq = 0, pp = 0, ps, e;
-    int	ai, ip, i;
-
-    aa = fabs(a);
-    ai = (int) aa;
-    /*    af = fmod(aa,1.0); */
-    i = (int) aa;
-    af = aa - i;
-    q = 0;
-    em = 1.0;
-    while(++q <= qlim) {
-        ps = q * af;
-        ip = (int) (ps + 0.5);
-        e = fabs((ps - (double)ip)/q);
-        if(e < em) {
-            em = e;
-            pp = ip;
-            qq = q;
-        }
-    };
-    *k = (int) ((ai * qq) + pp);
-    *k = (a > 0)? *k : -(*k);
-    *l = (int) qq;
-    return(true);
+/* moderate the cost of frequency jumps by the relative amplitude */
+static double analysis_rmsdffact(const analysis_t *a, size_t i) {
+    return a->rmsmax > 0 ? a->poles[i]->rms / a->rmsmax * a->dp.dffact : 0;
 }
 
-static void Fdownsample(sound_t *s, double freq2) {
-    enum { N_BITS = 15 };
+/* Get the number of bytes a lattice with room for cap candidates of nform
+   formants takes up. */
+static size_t lattice_size(size_t nform, size_t cap) {
+    return cap * (nform * (sizeof(double) + sizeof(short)) +
+                  2 * sizeof(int64_t) + 2 * sizeof(short));
+}
+
+/* Move lat into mem, which is lattice_size(nform, cap) bytes long, making room
+   for cap candidates.  The candidates already stored come along, and freq
+   ends up at the start of mem. */
+static void lattice_move(lattice_t *lat, size_t nform, size_t cap, void *mem) {
+    lattice_t old = *lat;
+    char *p = mem;
+
+    lat->cap = cap;
+    lat->freq = (double *) p;
+    p += sizeof(double) * nform * cap;
+    lat->local = (int64_t *) p;
+    p += sizeof(int64_t) * cap;
+    lat->cumerr = (int64_t *) p;
+    p += sizeof(int64_t) * cap;
+    lat->cand = (short *) p;
+    p += sizeof(short) * nform * cap;
+    lat->prept = (short *) p;
+    p += sizeof(short) * cap;
+    lat->beam = (short *) p;
+
+    if (!old.n)
+        return;
 
-    short	*bufin, **bufout;
-    double	beta = 0.0, b[256];
-    double	tratio, maxi, ratio, beta_new, freq1;
-    int	ncoeff = 127;
-    short	ic[256];
-    int	insert, decimate, smin, smax;
+    for (size_t l = 0; l < nform; l += 1) {
+        memcpy(lat->freq + l * cap, old.freq + l * old.cap,
+               sizeof(double) * old.n);
+        memcpy(lat->cand + l * cap, old.cand + l * old.cap,
+               sizeof(short) * old.n);
+    }
 
-    size_t out_samps;
-    size_t j;
-    size_t ncoefft;
+    memcpy(lat->local, old.local, sizeof(int64_t) * old.n);
+    memcpy(lat->cumerr, old.cumerr, sizeof(int64_t) * old.n);
+    memcpy(lat->prept, old.prept, sizeof(short) * old.n);
+    memcpy(lat->beam, old.beam, sizeof(short) * old.n);
+}
 
-    freq1 = s->sample_rate;
-    ratio = freq2/freq1;
-    ratprx(ratio,&insert,&decimate,10);
-    tratio = ((double)insert)/((double)decimate);
+/* Make sure lat has room for n more candidates, taking any memory it needs
+   from ws. */
+static void lattice_grow(formant_workspace_t *ws, lattice_t *lat, size_t nform,
+                         size_t n)
+{
+    size_t cap = lat->cap ? lat->cap : n;
 
-    if(tratio > .99)
+    if (lat->n + n <= lat->cap)
         return;
 
-    ncoefft = 0;
+    while (cap < lat->n + n)
+        cap *= 2;
 
-    bufout = malloc(sizeof(short*));
-    bufin = malloc(sizeof(short) * s->n_samples);
+    lattice_move(lat, nform, cap,
+                 formant_workspace_alloc(ws, lattice_size(nform, cap)));
+}
 
-    for (size_t i = 0; i < s->n_samples; i++) {
-        bufin[i] = (short) sound_get_sample(s, 0, i);
-    }
+/* Start frame f at the end of the candidates stored in lat. */
+static void lattice_push(formant_workspace_t *ws, lattice_t *lat, size_t nform,
+                         form_t *f)
+{
+    lattice_grow(ws, lat, nform, MAX_CANDIDATES);
 
-    freq2 = tratio * freq1;
-    beta_new = (.5 * freq2)/(insert * freq1);
+    *f = (form_t) { .lat = lat, .first = lat->n };
+}
 
-    if(beta != beta_new){
-        beta = beta_new;
-        lc_lin_fir(beta,&ncoeff,b);
-        maxi = (1 << N_BITS) - 1;
-        j = (ncoeff/2) + 1;
-        for(size_t i = 0; i < j; i++){
-            ic[i] = (int) (0.5 + (maxi * b[i]));
-            if(ic[i]) ncoefft = i+1;
-        }
-    }				/*  endif new coefficients need to be computed */
+/* Build a segment of the dp lattice as if the utterance started at its first
+   frame. */
+static void pass_lattice(analysis_t *a, formant_workspace_t *ws, size_t i) {
+    const dp_t *dp = &a->dp;
+    lattice_t *lat = &a->lat[i];
+
+    STATS_BEGIN(ws, FORMANT_STAGE_DP);
+    *lat = (lattice_t) { .n = 0 };
+    lattice_grow(ws, lat, dp->nform,
+                 (a->seg[i + 1] - a->seg[i]) * DP_CANDIDATES_GUESS);
+
+    for (size_t j = a->seg[i]; j < a->seg[i + 1]; j++) {
+        double next = j + 1 < a->nfrm ? analysis_rmsdffact(a, j + 1) : 0;
+        form_t *cur = &a->fl[j];
+
+        lattice_push(ws, lat, dp->nform, cur);
+        dp_candidates(dp, cur, a->poles[j],
+                      dp_slack(dp, analysis_rmsdffact(a, j), next));
+        lat->n += cur->ncand;
+        STATS_ADD(ws, candidates, cur->ncand);
+
+        if (j > a->seg[i])
+            dp_connect(dp, cur, &a->fl[j - 1], analysis_rmsdffact(a, j));
+        else
+            dp_connect(dp, cur, NULL, 0);
+    }
 
-    dwnsamp(bufin, s->n_samples, bufout, &out_samps, insert, decimate, ncoefft, ic,
-            &smin, &smax);
+    STATS_END(ws, FORMANT_STAGE_DP);
+}
 
-    for (size_t i = 0; i < out_samps; i++) {
-        sound_set_sample(s, 0, i, (*bufout)[i]);
+#ifdef LIBFORMANT_TEST
+TEST test_dp_candidates() {
+    double freq[LPC_ORDER_MAX], band[LPC_ORDER_MAX];
+    pole_t pole = { .npoles = LPC_ORDER_MAX / 2, .freq = freq, .band = band };
+    formant_workspace_t ws;
+    lattice_t lat = { .n = 0 };
+    form_t frame, *f = &frame;
+    dp_t dp;
+
+    formant_workspace_init(&ws);
+    dp_init(&dp, 4, -10, 100, 0);
+    lattice_push(&ws, &lat, dp.nform, f);
+
+    // Crowd every pole into the ranges of F2 and F3, so there are far more
+    // mappings than room for them.
+    for (size_t i = 0; i < pole.npoles; i += 1) {
+        freq[i] = 1100 + 100 * i;
+        band[i] = 50 + 10 * i;
     }
 
-    s->n_samples = out_samps;
-    s->sample_rate = (int)freq2;
+    dp_candidates(&dp, f, &pole, INT64_MAX / 2);
+    GREATEST_ASSERT(f->ncand > 0 && f->ncand <= MAX_CANDIDATES);
 
-    free(*bufout);
-    free(bufout);
-    free(bufin);
-}
+    // Every mapping assigns increasing poles within the formant ranges.
+    for (size_t j = 0; j < f->ncand; j += 1) {
+        int last = -1;
 
-static void highpass(sound_t *s) {
-    /* This assumes the sampling frequency is 10kHz and that the FIR
-       is a Hanning function of (LCSIZ/10)ms duration. */
-    enum { LCSIZ = 101 };
+        for (size_t l = 0; l < dp.nform; l += 1) {
+            int p = form_cand(f, l)[j];
 
-    short *datain, *dataout;
-    short *lcf;
-    size_t len;
-    double scale, fn;
+            if (p < 0) {
+                GREATEST_ASSERT_EQ(form_freq(f, l)[j], 0);
+                continue;
+            }
 
-    datain = malloc(sizeof(short) * s->n_samples);
-    dataout = malloc(sizeof(short) * s->n_samples);
-    for (size_t i = 0; i < s->n_samples; i++) {
-        datain[i] = (short) sound_get_sample(s, 0, i);
+            GREATEST_ASSERT_EQ(form_freq(f, l)[j], freq[p]);
+
+            GREATEST_ASSERT(freq[p] >= dp.fmins[l] && freq[p] <= dp.fmaxs[l]);
+            GREATEST_ASSERT(p > last);
+            last = p;
+        }
     }
 
-    lcf = malloc(sizeof(short) * LCSIZ);
-    len = 1 + (LCSIZ/2);
-    fn = PI * 2.0 / (LCSIZ - 1);
-    scale = 32767.0/(.5 * LCSIZ);
-    for(size_t i=0; i < len; i++)
-        lcf[i] = (short) (scale * (.5 + (.4 * cos(fn * ((double)i)))));
+    // Without any slack, just the cheapest mappings are left.
+    dp_candidates(&dp, f, &pole, 0);
+    GREATEST_ASSERT(f->ncand >= 1);
 
-    do_fir(datain,s->n_samples,dataout,len,lcf,1); /* in downsample.c */
+    for (size_t j = 1; j < f->ncand; j += 1)
+        GREATEST_ASSERT_EQ(lat.local[j], lat.local[0]);
 
-    for (size_t i = 0; i < s->n_samples; i++) {
-        sound_set_sample(s, 0, i, dataout[i]);
-    }
+    formant_workspace_destroy(&ws);
 
-    free(lcf);
-    free(dataout);
-    free(datain);
+    PASS();
 }
+#endif
 
-bool sound_calc_formants(sound_t *s, const formant_opts_t *opts) {
-    pole_t **poles;
+/* Connect segment i of the dp lattice to the end of the one before, whose
+   costs are known to be true up to the same amount at every mapping.  The
+   paths to every mapping soon come together, and from the first frame where
+   the new costs are all shifted from the old ones by the same amount, the
+   rest of the segment connects just as it did already. */
+static void dp_mend(analysis_t *a, size_t i) {
+    int64_t old[MAX_CANDIDATES];
 
-    if (opts->downsample_rate < s->sample_rate)
-        Fdownsample(s, opts->downsample_rate);
+    for (size_t j = a->seg[i]; j < a->seg[i + 1]; j++) {
+        form_t *cur = &a->fl[j];
+        const int64_t *cumerr = cur->lat->cumerr + cur->first;
+        bool even = true;
+
+        memcpy(old, cumerr, sizeof(int64_t) * cur->ncand);
+        dp_connect(&a->dp, cur, &a->fl[j - 1], analysis_rmsdffact(a, j));
+
+        for (size_t k = 1; k < cur->ncand; k++)
+            even = even && cumerr[k] - old[k] == cumerr[0] - old[0];
+
+        if (even)
+            return;
+    }
+}
+
+/* Get the number of frames in n samples at the given rate, or 0 if there's
+   not enough of them for a single window. */
+static size_t frame_count(const formant_opts_t *opts, double rate, size_t n) {
+    if ((double)n / rate < opts->window_dur)
+        return 0;
+
+    return 1 + (int)(((double)n / rate - opts->window_dur) / opts->frame_dur);
+}
+
+/* Analyse the n_in samples at in, taken at the given rate, into the formants
+   of each frame, stored in frames, with everything that lasts the whole
+   analysis taken from ws. */
+static bool analyse(analysis_t *a, const short *in, size_t n_in, size_t rate,
+                    formant_workspace_t *ws, formant_frame_t *frames)
+{
+    const formant_opts_t *opts = a->opts;
+    size_t nform = opts->n_formants, pad;
+    pole_t *pp;
+    double *fbp;
+
+    a->in = in;
+    a->n_in = n_in;
+    a->ds = (short *) a->in;
+    a->n = a->n_in;
+    a->sample_rate = rate;
+
+    if (opts->downsample_rate < rate) {
+        if (!resampler_init(&a->rs, rate, opts->downsample_rate))
+            return false;
+
+        a->sample_rate = opts->downsample_rate;
+        a->n = a->n_in * a->rs.up / a->rs.down;
+        a->ds = formant_workspace_alloc(ws, sizeof(short) * a->n);
+        analysis_run(a, pass_downsample,
+                     (a->n + FILTER_BLOCK - 1) / FILTER_BLOCK);
+    }
+
+    a->nfrm = frame_count(opts, a->sample_rate, a->n);
+
+    if (!a->nfrm)
+        return false;
+
+    a->size = (int)(.5 + opts->window_dur * a->sample_rate);
+    a->step = (int)(.5 + opts->frame_dur * a->sample_rate);
+
+    /* The last frame may read past the end of the samples, so pad them. */
+    pad = lpc_span(opts, a->size) - a->size;
+    a->data = formant_workspace_alloc(ws, sizeof(short) * (a->n + pad));
+    memset(a->data + a->n, 0, sizeof(short) * pad);
 
     /* be sure DC and rumble are gone! */
-    if (opts->pre_emph_factor < 1.0)
-        highpass(s);
+    if (opts->pre_emph_factor < 1.0) {
+        fir_init_half(&a->hp, highpass_coefs(), 1);
+        analysis_run(a, pass_highpass,
+                     (a->n + FILTER_BLOCK - 1) / FILTER_BLOCK);
+    } else {
+        memcpy(a->data, a->ds, sizeof(short) * a->n);
+    }
+
+    a->poles = formant_workspace_alloc(ws, sizeof(pole_t *) * a->nfrm);
+    pp = formant_workspace_alloc(ws, sizeof(pole_t) * a->nfrm);
+    fbp = formant_workspace_alloc(ws, sizeof(double) * a->nfrm * 2 *
+                                  opts->lpc_order);
+
+    for (size_t i = 0; i < a->nfrm; i++) {
+        a->poles[i] = &pp[i];
+        a->poles[i]->freq = fbp;
+        a->poles[i]->band = fbp + opts->lpc_order;
+        fbp += 2 * opts->lpc_order;
+    }
+
+    /* Size the other threads' workspaces for a frame up front, since they
+       are never reset and would otherwise spill every frame. */
+    for (size_t i = 1; i < a->n_workers; i++)
+        formant_workspace_reserve(a->workers[i].ws,
+                                  lpc_scratch(opts, a->size));
+
+    analysis_run(a, pass_poles, (a->nfrm + ROOT_BLOCK - 1) / ROOT_BLOCK);
+
+    dp_init(&a->dp, nform, opts->nom_freq, (size_t)(1.0 / opts->frame_dur),
+            opts->beam_width);
+    a->rmsmax = get_stat_max(a->poles, a->nfrm);
+
+    if (opts->adapt_ranges) {
+        double f0 = get_f0_median(ws, a->poles, a->nfrm);
+
+        if (f0 > 0)
+            dp_scale(&a->dp, f0_scale(f0));
+    }
+
+    /* Give every thread a few segments of the lattice, so they can even out
+       the work between them. */
+    a->n_seg = 1;
+
+    if (a->n_workers > 1) {
+        a->n_seg = a->n_workers * 4;
+
+        if (a->n_seg > a->nfrm / DP_SEGMENT_MIN)
+            a->n_seg = a->nfrm / DP_SEGMENT_MIN ? a->nfrm / DP_SEGMENT_MIN : 1;
+    }
+
+    a->seg = formant_workspace_alloc(ws, sizeof(size_t) * (a->n_seg + 1));
+
+    for (size_t i = 0; i <= a->n_seg; i++)
+        a->seg[i] = a->nfrm * i / a->n_seg;
+
+    a->fl = formant_workspace_alloc(ws, sizeof(form_t) * a->nfrm);
+    a->lat = formant_workspace_alloc(ws, sizeof(lattice_t) * a->n_seg);
+
+    analysis_run(a, pass_lattice, a->n_seg);
+
+    STATS_BEGIN(ws, FORMANT_STAGE_DP);
+
+    for (size_t i = 1; i < a->n_seg; i++)
+        dp_mend(a, i);
+
+    dp_backtrack(&a->dp, a->fl, a->poles, a->nfrm, a->rmsmax, frames);
+    STATS_END(ws, FORMANT_STAGE_DP);
+
+    return true;
+}
+
+/* Get the number of tracks analysed in the sound s. */
+static size_t sound_count_tracks(const sound_t *s, const formant_opts_t *opts) {
+    return opts->channels == CHANNELS_EACH ? s->n_channels : 1;
+}
+
+/* Get the number of frames in each track of the sound s. */
+static size_t sound_count_track_frames(const sound_t *s,
+                                       const formant_opts_t *opts)
+{
+    size_t rate = s->sample_rate;
+    size_t n = s->n_samples;
+    resampler_t rs;
+
+    if (opts->downsample_rate < s->sample_rate) {
+        if (!resampler_init(&rs, s->sample_rate, opts->downsample_rate))
+            return 0;
+
+        rate = opts->downsample_rate;
+        n = n * rs.up / rs.down;
+    }
+
+    return frame_count(opts, rate, n);
+}
+
+/* Get the tracks of the sound s to analyse, one after another, each of
+   n_samples samples.  Interleaved channels are pulled apart in a single pass
+   over the sound, with the copy taken from ws. */
+static const short *sound_tracks(const sound_t *s, const formant_opts_t *opts,
+                                 formant_workspace_t *ws)
+{
+    size_t n = s->n_samples, nch = s->n_channels;
+    short *in;
+
+    if (nch == 1)
+        return s->samples;
+
+    in = formant_workspace_alloc(ws, sizeof(short) *
+                                 n * sound_count_tracks(s, opts));
+
+    switch (opts->channels) {
+    case CHANNELS_FIRST:
+        for (size_t i = 0; i < n; i++)
+            in[i] = sound_get_sample(s, 0, i);
+    break;
+
+    case CHANNELS_MIX:
+        for (size_t i = 0; i < n; i++) {
+            int sum = 0;
+
+            for (size_t c = 0; c < nch; c++)
+                sum += sound_get_sample(s, c, i);
+
+            in[i] = sum / (int) nch;
+        }
+    break;
+
+    case CHANNELS_EACH:
+        for (size_t i = 0; i < n; i++)
+            for (size_t c = 0; c < nch; c++)
+                in[c * n + i] = sound_get_sample(s, c, i);
+    break;
+
+    case CHANNELS_INVALID:
+    break;
+    }
+
+    return in;
+}
 
-    poles = lpc_poles(s, opts);
+/* Analyse every track of the sound s with n_threads threads as for analyse,
+   storing the number of frames in each track in *nfrm.  The tracks are taken
+   one after another, each split across the threads.  If *frames is NULL, the
+   frames are taken from ws. */
+static bool analyse_parallel(const sound_t *s, const formant_opts_t *opts,
+                             formant_workspace_t *ws, size_t n_threads,
+                             formant_frame_t **frames, size_t *nfrm)
+{
+    analysis_t a = { .opts = opts };
+    size_t n_tracks = sound_count_tracks(s, opts);
+    const short *in;
+    bool ok = true;
+
+    formant_workspace_reset(ws);
+    formant_stats_clear(&ws->stats);
+
+    *nfrm = sound_count_track_frames(s, opts);
+
+    if (!*nfrm || !n_tracks)
+        return false;
+
+    in = sound_tracks(s, opts, ws);
+
+    if (!*frames)
+        *frames = formant_workspace_alloc(ws, sizeof(formant_frame_t) *
+                                          *nfrm * n_tracks);
+
+    a.n_workers = n_threads ? n_threads : 1;
+    a.workers = malloc(sizeof(analysis_worker_t) * a.n_workers);
+    a.threads = malloc(sizeof(pthread_t) * a.n_workers);
+    BENCH_ALLOC();
+    BENCH_ALLOC();
+
+    /* The calling thread works from ws and the others get their own. */
+    a.workers[0] = (analysis_worker_t) { .a = &a, .ws = ws };
+
+    for (size_t i = 1; i < a.n_workers; i += 1) {
+        a.workers[i] = (analysis_worker_t) {
+            .a = &a,
+            .ws = malloc(sizeof(formant_workspace_t)),
+        };
+        BENCH_ALLOC();
+
+        formant_workspace_init(a.workers[i].ws);
+    }
+
+    for (size_t t = 0; t < n_tracks && ok; t += 1) {
+        formant_workspace_mark_t mark = formant_workspace_mark(ws);
+
+        /* Start every track afresh, keeping the workers. */
+        a = (analysis_t) {
+            .opts = opts,
+            .n_workers = a.n_workers,
+            .workers = a.workers,
+            .threads = a.threads,
+        };
+
+        ok = analyse(&a, in + t * s->n_samples, s->n_samples, s->sample_rate,
+                     ws, *frames + t * *nfrm);
+        formant_workspace_release(ws, mark);
+    }
 
-    if (!poles)
+    for (size_t i = 1; i < a.n_workers; i += 1) {
+        formant_stats_add(&ws->stats, &a.workers[i].ws->stats);
+        formant_workspace_destroy(a.workers[i].ws);
+        free(a.workers[i].ws);
+    }
+
+    free(a.workers);
+    free(a.threads);
+
+    return ok;
+}
+
+bool sound_calc_formants_parallel(sound_t *s, const formant_opts_t *opts,
+                                  formant_workspace_t *ws, size_t n_threads)
+{
+    size_t nform = opts->n_formants, nfrm;
+    size_t n_tracks = sound_count_tracks(s, opts);
+    formant_frame_t *frames = NULL;
+
+    if (!analyse_parallel(s, opts, ws, n_threads, &frames, &nfrm))
         return false;
 
-    dpform(s, poles, opts->n_formants, opts->nom_freq);
+    s->sample_rate = (size_t)(1.0 / opts->frame_dur);
+    s->n_channels = nform * 2 * n_tracks;
+    s->n_samples = nfrm;
+
+    for (size_t t = 0; t < n_tracks; t++) {
+        const formant_frame_t *f = frames + t * nfrm;
+        size_t chan = t * nform * 2;
+
+        for (size_t i = 0; i < nfrm; i++) {
+            for (size_t j = 0; j < nform; j++) {
+                sound_set_sample(s, chan + j, i, f[i].freq[j]);
+                sound_set_sample(s, chan + j + nform, i, f[i].band[j]);
+            }
+        }
+    }
 
     return true;
 }
 
+bool sound_calc_formants(sound_t *s, const formant_opts_t *opts,
+                         formant_workspace_t *ws)
+{
+    return sound_calc_formants_parallel(s, opts, ws, 1);
+}
+
+size_t sound_count_frames(const sound_t *s, const formant_opts_t *opts) {
+    return sound_count_track_frames(s, opts) * sound_count_tracks(s, opts);
+}
+
+bool sound_calc_frames_parallel(const sound_t *s, const formant_opts_t *opts,
+                                formant_workspace_t *ws, size_t n_threads,
+                                formant_frame_t *frames)
+{
+    size_t nfrm;
+
+    return analyse_parallel(s, opts, ws, n_threads, &frames, &nfrm);
+}
+
+bool sound_calc_frames(const sound_t *s, const formant_opts_t *opts,
+                       formant_workspace_t *ws, formant_frame_t *frames)
+{
+    return sound_calc_frames_parallel(s, opts, ws, 1, frames);
+}
+
+struct formant_tracker {
+    formant_opts_t opts;
+
+    // Whether the stream is downsampled before analysis, along with the
+    // resampler used to do it.
+    bool downsample;
+    resampler_t ds;
+    // Resampled samples waiting to be highpass filtered.
+    short *ds_buf;
+    size_t ds_cap;
+
+    // Whether the stream is highpass filtered, along with the filter used and
+    // the number of outputs still to be dropped for its delay.
+    bool highpass;
+    fir_t hp;
+    size_t hp_skip;
+
+    // Sample rate of the analysed signal.
+    size_t sample_rate;
+    // Length of the analysis window and step between frames in samples.
+    size_t size, step;
+    // Number of samples read to analyse a frame.
+    size_t span;
+
+    // Filtered samples that haven't been consumed by analysis yet.
+    short *buf;
+    size_t buf_len, buf_cap;
+    // Number of frames of them made ready by the last fill.
+    size_t n_ready;
+
+    // Root-search starting points carried from frame to frame.
+    double rr[LPC_ORDER_MAX+1], ri[LPC_ORDER_MAX+1];
+    bool init;
+
+    dp_t dp;
+    // Largest frame rms seen so far.
+    double rmsmax;
+    // Running average of the log F0 of the voiced frames seen so far, and
+    // their number, for adapting the formant ranges.
+    double f0_log;
+    size_t n_voiced;
+
+    // DP lattice for the frames that are still undecided, followed by those
+    // completed by the current push. If primed is set, slot 0 holds the last
+    // frame decided so far, for the next frame to connect to. The n_pending
+    // undecided frames come after it. Every slot has room for MAX_CANDIDATES
+    // candidates in lat.
+    lattice_t lat;
+    form_t *fl;
+    pole_t **poles;
+    size_t n_slots;
+    bool primed;
+    size_t n_pending;
+
+    // Number of frames a decision may be put off for.
+    size_t max_lag;
+
+    // Formants chosen for the frames completed by the current push.
+    formant_frame_t *frames;
+
+    // Scratch memory for analysing a single frame.
+    formant_workspace_t ws;
+};
+
+// Make sure the tracker has at least n lattice slots, each of which can hold
+// MAX_CANDIDATES candidate mappings.
+static void tracker_reserve(formant_tracker_t *t, size_t n) {
+    size_t nform = t->opts.n_formants;
+    double *mem = t->lat.freq;
+
+    if (n <= t->n_slots)
+        return;
+
+    lattice_move(&t->lat, nform, n * MAX_CANDIDATES,
+                 malloc(lattice_size(nform, n * MAX_CANDIDATES)));
+    t->lat.n = t->lat.cap;
+    free(mem);
+
+    t->fl = realloc(t->fl, sizeof(form_t) * n);
+    t->poles = realloc(t->poles, sizeof(pole_t *) * n);
+    t->frames = realloc(t->frames, sizeof(formant_frame_t) * n);
+
+    for (size_t i = t->n_slots; i < n; i += 1) {
+        pole_t *p = malloc(sizeof(pole_t));
+
+        p->npoles = 0;
+        p->freq = malloc(sizeof(double) * t->opts.lpc_order);
+        p->band = malloc(sizeof(double) * t->opts.lpc_order);
+
+        t->fl[i] = (form_t) { .lat = &t->lat, .first = i * MAX_CANDIDATES };
+        t->poles[i] = p;
+    }
+
+    t->n_slots = n;
+}
+
+formant_tracker_t *formant_tracker_new(const formant_opts_t *opts,
+                                       size_t sample_rate)
+{
+    formant_tracker_t *t;
+
+    if (!sample_rate)
+        return NULL;
+
+    t = malloc(sizeof(formant_tracker_t));
+
+    *t = (formant_tracker_t) {
+        .opts = *opts,
+        .sample_rate = sample_rate,
+    };
+
+    if (opts->downsample_rate < sample_rate) {
+        t->downsample = true;
+        t->sample_rate = opts->downsample_rate;
+
+        if (!resampler_init(&t->ds, sample_rate, t->sample_rate)) {
+            free(t);
+            return NULL;
+        }
+    }
+
+    /* be sure DC and rumble are gone! */
+    t->highpass = opts->pre_emph_factor < 1.0;
+
+    t->size = (size_t)(.5 + opts->window_dur * t->sample_rate);
+    t->step = (size_t)(.5 + opts->frame_dur * t->sample_rate);
+    t->span = lpc_span(opts, t->size);
+
+    if (!t->size || !t->step) {
+        free(t);
+        return NULL;
+    }
+
+    dp_init(&t->dp, opts->n_formants, opts->nom_freq,
+            (size_t)(1.0 / opts->frame_dur), opts->beam_width);
+    t->dp.adapting = opts->adapt_ranges;
+    t->max_lag = (size_t)(.5 + opts->max_lag / opts->frame_dur);
+
+    formant_workspace_init(&t->ws);
+    formant_workspace_reserve(&t->ws, lpc_scratch(opts, t->size));
+    formant_tracker_reset(t);
+
+    return t;
+}
+
+void formant_tracker_destroy(formant_tracker_t *t) {
+    if (!t)
+        return;
+
+    for (size_t i = 0; i < t->n_slots; i += 1) {
+        free(t->poles[i]->freq);
+        free(t->poles[i]->band);
+        free(t->poles[i]);
+    }
+
+    // The lattice's memory starts with its frequencies.
+    free(t->lat.freq);
+    free(t->fl);
+    free(t->poles);
+    free(t->frames);
+    free(t->buf);
+    free(t->ds_buf);
+    formant_workspace_destroy(&t->ws);
+    free(t);
+}
+
+void formant_tracker_reset(formant_tracker_t *t) {
+    if (t->downsample)
+        resampler_reset(&t->ds);
+
+    formant_workspace_seed(&t->ws, 0);
+
+    if (t->highpass) {
+        fir_init_half(&t->hp, highpass_coefs(), 1);
+        t->hp_skip = t->hp.taps / 2;
+    }
+
+    t->buf_len = 0;
+    t->init = true;
+    t->rmsmax = 0;
+    t->f0_log = 0;
+    t->n_voiced = 0;
+    dp_scale(&t->dp, 1.0);
+    t->primed = false;
+    t->n_pending = 0;
+}
+
+// Pass the n samples at the analysis rate through the highpass filter and queue
+// them for analysis.
+static void tracker_put(formant_tracker_t *t, const short *samples, size_t n) {
+    short *dst = t->buf + t->buf_len;
+    size_t skip;
+
+    if (!t->highpass) {
+        memcpy(dst, samples, sizeof(short) * n);
+        t->buf_len += n;
+
+        return;
+    }
+
+    fir_run(&t->hp, samples, n, dst);
+
+    // Drop the outputs that come before the filter's delay is made up.
+    skip = t->hp_skip < n ? t->hp_skip : n;
+    memmove(dst, dst + skip, sizeof(short) * (n - skip));
+    t->hp_skip -= skip;
+    t->buf_len += n - skip;
+}
+
+// Analyse the i'th frame made ready by the last fill into its lattice slot,
+// with the LPC coefficients and rms given as for lpc_frame.
+static void tracker_frame(formant_tracker_t *t, size_t i, const double *given,
+                          double given_rms)
+{
+    size_t slot = (t->primed ? 1 : 0) + t->n_pending + i;
+    form_t *cur = &t->fl[slot];
+    pole_t *pole = t->poles[slot];
+    double rmsdffact = 0;
+
+    formant_workspace_reset(&t->ws);
+    lpc_frame(&t->ws, &t->opts, t->sample_rate, t->buf + i * t->step, t->size,
+              given, given_rms, pole, t->rr, t->ri, &t->init);
+
+    if (pole->rms > t->rmsmax)
+        t->rmsmax = pole->rms;
+
+    /* Average over every voiced frame until there are enough of them, and
+       then follow the speaker. */
+    if (t->opts.adapt_ranges && pole->f0 > 0) {
+        double w = t->opts.frame_dur / F0_ADAPT_SECS;
+
+        t->n_voiced += 1;
+
+        if (w < 1.0 / t->n_voiced)
+            w = 1.0 / t->n_voiced;
+
+        t->f0_log += (log(pole->f0) - t->f0_log) * w;
+        dp_scale(&t->dp, f0_scale(exp(t->f0_log)));
+    }
+
+    /* moderate the cost of frequency jumps by the relative amplitude */
+    if (t->rmsmax > 0)
+        rmsdffact = pole->rms / t->rmsmax * t->dp.dffact;
+
+    STATS_BEGIN(&t->ws, FORMANT_STAGE_DP);
+
+    /* The next frame is yet to come, so allow for it being as loud as can
+       be. */
+    dp_candidates(&t->dp, cur, pole,
+                  dp_slack(&t->dp, rmsdffact, t->dp.dffact));
+
+    STATS_ADD(&t->ws, candidates, cur->ncand);
+
+    if (slot)
+        dp_connect(&t->dp, cur, &t->fl[slot-1], rmsdffact);
+    else
+        dp_connect(&t->dp, cur, NULL, rmsdffact);
+
+    STATS_END(&t->ws, FORMANT_STAGE_DP);
+}
+
+// Get the number of frames from slot first on whose formants are settled out of
+// the frames up to slot n. Every path still open leads back through the same
+// candidate of a settled frame, or through no candidate at all.
+static size_t tracker_settled(const formant_tracker_t *t, size_t first,
+                              size_t n)
+{
+    bool open[2][MAX_CANDIDATES];
+    const form_t *f = &t->fl[n - 1];
+    const short *beam = f->lat->beam + f->first;
+    size_t n_open = f->nbeam, cur = 0;
+
+    memset(open[cur], 0, sizeof(open[cur]));
+
+    for (size_t b = 0; b < f->nbeam; b += 1)
+        open[cur][beam[b]] = true;
+
+    for (size_t i = n - 1; n_open > 1; i -= 1) {
+        const short *prept;
+
+        if (i == first)
+            return 0;
+
+        // Follow the open paths back to the frame before.
+        f = &t->fl[i];
+        prept = f->lat->prept + f->first;
+        memset(open[!cur], 0, sizeof(open[!cur]));
+        n_open = 0;
+
+        for (size_t j = 0; j < f->ncand; j += 1) {
+            if (open[cur][j] && prept[j] >= 0 && !open[!cur][prept[j]]) {
+                open[!cur][prept[j]] = true;
+                n_open += 1;
+            }
+        }
+
+        cur = !cur;
+        n -= 1;
+    }
+
+    return n - first;
+}
+
+// Decide the formants of the first count of the pending frames from slot first
+// on, taking the best path through all n frames analysed so far, and keep the
+// rest for later. Return count, with the decided frames stored in t->frames.
+static size_t tracker_decide(formant_tracker_t *t, size_t first, size_t count,
+                             size_t n)
+{
+    size_t keep;
+
+    if (!count) {
+        t->n_pending = n - first;
+        return 0;
+    }
+
+    STATS_BEGIN(&t->ws, FORMANT_STAGE_DP);
+    dp_backtrack(&t->dp, t->fl + first, t->poles + first, n - first,
+                 t->rmsmax, t->frames);
+    STATS_END(&t->ws, FORMANT_STAGE_DP);
+
+    // Keep the undecided frames, or else the last frame so the next one can
+    // connect to it.
+    keep = first + count < n ? first + count : n - 1;
+    t->primed = keep < first + count;
+    t->n_pending = n - first - count;
+
+    for (size_t i = keep; i < n; i += 1) {
+        form_t f = t->fl[i - keep];
+        pole_t *p = t->poles[i - keep];
+
+        t->fl[i - keep] = t->fl[i];
+        t->fl[i] = f;
+        t->poles[i - keep] = t->poles[i];
+        t->poles[i] = p;
+    }
+
+    return count;
+}
+
+size_t tracker_fill(formant_tracker_t *t, const formant_sample_t *samples,
+                    size_t n_samples)
+{
+    size_t max_new = n_samples;
+
+    formant_stats_clear(&t->ws.stats);
+
+    if (t->downsample) {
+        max_new = resampler_max_out(&t->ds, n_samples);
+
+        if (max_new > t->ds_cap) {
+            t->ds_cap = max_new;
+            t->ds_buf = realloc(t->ds_buf, sizeof(short) * t->ds_cap);
+        }
+
+        STATS_BEGIN(&t->ws, FORMANT_STAGE_DOWNSAMPLE);
+        n_samples = resampler_push(&t->ds, samples, n_samples, t->ds_buf);
+        STATS_END(&t->ws, FORMANT_STAGE_DOWNSAMPLE);
+        samples = t->ds_buf;
+    }
+
+    if (t->buf_len + max_new > t->buf_cap) {
+        t->buf_cap = t->buf_len + max_new;
+        t->buf = realloc(t->buf, sizeof(short) * t->buf_cap);
+    }
+
+    STATS_BEGIN(&t->ws, FORMANT_STAGE_HIGHPASS);
+    tracker_put(t, samples, n_samples);
+    STATS_END(&t->ws, FORMANT_STAGE_HIGHPASS);
+
+    // Every frame that's now complete is ready. Preemphasis looks one sample
+    // past the end of the window, so make sure it's available.
+    t->n_ready = 0;
+
+    if (t->buf_len >= t->span)
+        t->n_ready = (t->buf_len - t->span) / t->step + 1;
+
+    tracker_reserve(t, (t->primed ? 1 : 0) + t->n_pending + t->n_ready);
+
+    return t->n_ready;
+}
+
+void tracker_lanes(formant_tracker_t *const *t, size_t n, size_t i,
+                   formant_workspace_t *ws)
+{
+    const formant_opts_t *opts = &t[0]->opts;
+    short **data;
+    double **lpca, *rms;
+
+    // Only the autocorrelation method in double precision is worked out in
+    // lanes.
+    if (opts->lpc_type != LPC_TYPE_NORMAL ||
+        opts->precision != PRECISION_DOUBLE)
+    {
+        for (size_t j = 0; j < n; j += 1)
+            tracker_frame(t[j], i, NULL, 0);
+
+        return;
+    }
+
+    formant_workspace_reset(ws);
+    data = formant_workspace_alloc(ws, sizeof(short *) * n);
+    lpca = formant_workspace_alloc(ws, sizeof(double *) * n);
+    rms = formant_workspace_alloc(ws, sizeof(double) * n);
+
+    for (size_t j = 0; j < n; j += 1) {
+        data[j] = t[j]->buf + i * t[j]->step;
+        lpca[j] = formant_workspace_alloc(ws, sizeof(double) *
+                                              (opts->lpc_order + 1));
+    }
+
+    STATS_BEGIN(ws, FORMANT_STAGE_LPC);
+    lpc_lanes(ws, opts->lpc_order, LPC_STABLE, t[0]->size, n, data, lpca, rms,
+              opts->pre_emph_factor, opts->window_type);
+    STATS_END(ws, FORMANT_STAGE_LPC);
+
+    for (size_t j = 0; j < n; j += 1)
+        tracker_frame(t[j], i, lpca[j], rms[j]);
+}
+
+size_t tracker_finish(formant_tracker_t *t, const formant_frame_t **frames) {
+    size_t first = t->primed ? 1 : 0, n = first + t->n_pending + t->n_ready;
+    size_t pos = t->n_ready * t->step, count;
+
+    t->buf_len -= pos;
+    memmove(t->buf, t->buf + pos, sizeof(short) * t->buf_len);
+    t->n_ready = 0;
+
+    *frames = t->frames;
+
+    if (n == first)
+        return 0;
+
+    // Decide the frames whose formants are settled, and any that have waited
+    // as long as they may.
+    count = tracker_settled(t, first, n);
+
+    if (n - first > t->max_lag && count < n - first - t->max_lag)
+        count = n - first - t->max_lag;
+
+    return tracker_decide(t, first, count, n);
+}
+
+size_t formant_tracker_push(formant_tracker_t *t,
+                            const formant_sample_t *samples, size_t n_samples,
+                            const formant_frame_t **frames)
+{
+    size_t n = tracker_fill(t, samples, n_samples);
+
+    for (size_t i = 0; i < n; i += 1)
+        tracker_frame(t, i, NULL, 0);
+
+    return tracker_finish(t, frames);
+}
+
+size_t formant_tracker_flush(formant_tracker_t *t,
+                             const formant_frame_t **frames)
+{
+    size_t first = t->primed ? 1 : 0;
+
+    formant_stats_clear(&t->ws.stats);
+    *frames = t->frames;
+
+    return tracker_decide(t, first, t->n_pending, first + t->n_pending);
+}
+
+const formant_stats_t *formant_tracker_stats(const formant_tracker_t *t) {
+    return &t->ws.stats;
+}
+
 #ifdef LIBFORMANT_TEST
+// Synthesize a vowel with the given first two formants at the given F0.
+static void synth_vowel_f0(formant_sample_t *samples, size_t n,
+                           size_t sample_rate, double f1, double f2, double f0)
+{
+    const double freq[] = {f1, f2, 2500};
+    const double band[] = {80, 100, 150};
+
+    synth_voice(samples, n, sample_rate, f0, freq, band, 3, 8000);
+}
+
+// Synthesize a vowel as above at an F0 of 120Hz.
+static void synth_vowel(formant_sample_t *samples, size_t n, size_t sample_rate,
+                        double f1, double f2)
+{
+    synth_vowel_f0(samples, n, sample_rate, f1, f2, 120);
+}
+
+TEST test_formant_tracker() {
+    const size_t rates[] = {10000, 16000};
+    const size_t chunks[] = {1000, 137};
+
+    formant_opts_t opts;
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+
+    for (size_t r = 0; r < 2; r += 1) {
+        size_t n = rates[r];
+        formant_sample_t *samples = malloc(sizeof(formant_sample_t) * n);
+
+        synth_vowel(samples, n, rates[r], 700, 1200);
+
+        for (size_t c = 0; c < 2; c += 1) {
+            formant_tracker_t *t = formant_tracker_new(&opts, rates[r]);
+            const formant_frame_t *frames;
+            double f1 = 0, f2 = 0;
+            size_t total = 0;
+
+            GREATEST_ASSERT(t);
+
+            for (size_t i = 0; i < n; i += chunks[c]) {
+                size_t len = n - i < chunks[c] ? n - i : chunks[c];
+                size_t got = formant_tracker_push(t, samples + i, len, &frames);
+
+                for (size_t j = 0; j < got; j += 1) {
+                    f1 += frames[j].freq[0];
+                    f2 += frames[j].freq[1];
+                }
+
+                total += got;
+            }
+
+            GREATEST_ASSERTm("frames are produced", total > 80);
+            GREATEST_ASSERTm("F1 is tracked", fabs(f1 / total - 700) < 100);
+            GREATEST_ASSERTm("F2 is tracked", fabs(f2 / total - 1200) < 100);
+
+            formant_tracker_destroy(t);
+        }
+
+        free(samples);
+    }
+
+    PASS();
+}
+
+TEST test_formant_tracker_lag() {
+    enum { RATE = 10000, CHUNK = 37 };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * RATE);
+    const formant_frame_t *frames;
+    formant_tracker_t *ref, *now, *lag;
+    formant_frame_t *want;
+    size_t n_want, n_now = 0, n_lag = 0, same = 0;
+    formant_opts_t opts;
+
+    // Change vowels halfway through, so the paths have something to disagree
+    // about for a while.
+    synth_vowel(samples, RATE / 2, RATE, 700, 1200);
+    synth_vowel(samples + RATE / 2, RATE / 2, RATE, 300, 2200);
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+
+    // Decide the whole recording at once for reference.
+    ref = formant_tracker_new(&opts, RATE);
+    n_want = formant_tracker_push(ref, samples, RATE, &frames);
+    want = malloc(sizeof(formant_frame_t) * n_want);
+    memcpy(want, frames, sizeof(formant_frame_t) * n_want);
+    GREATEST_ASSERT_EQ(0, formant_tracker_flush(ref, &frames));
+
+    // Without a lag, every push decides the frames it completes.
+    now = formant_tracker_new(&opts, RATE);
+
+    opts.max_lag = 0.04;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    lag = formant_tracker_new(&opts, RATE);
+
+    for (size_t i = 0; i < RATE; i += CHUNK) {
+        size_t len = RATE - i < CHUNK ? RATE - i : CHUNK;
+        size_t got = formant_tracker_push(lag, samples + i, len, &frames);
+
+        for (size_t j = 0; j < got; j += 1) {
+            same += frames[j].freq[0] == want[n_lag + j].freq[0] &&
+                    frames[j].freq[1] == want[n_lag + j].freq[1];
+        }
+
+        n_lag += got;
+        n_now += formant_tracker_push(now, samples + i, len, &frames);
+
+        // No frame is put off for more than 4 frames.
+        GREATEST_ASSERT(n_lag <= n_now && n_lag + 4 >= n_now);
+    }
+
+    n_lag += formant_tracker_flush(lag, &frames);
+    GREATEST_ASSERT_EQ(n_want, n_now);
+    GREATEST_ASSERT_EQ(n_want, n_lag);
+    GREATEST_ASSERTm("lagged tracks follow the whole recording",
+                     same > n_want * 95 / 100);
+
+    formant_opts_init(&opts);
+    opts.max_lag = -1;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    formant_tracker_destroy(ref);
+    formant_tracker_destroy(now);
+    formant_tracker_destroy(lag);
+    free(want);
+    free(samples);
+
+    PASS();
+}
+
+TEST test_formant_tracker_adapt() {
+    enum { RATE = 10000, CHUNK = 160 };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * RATE);
+    const formant_frame_t *want, *got;
+    formant_tracker_t *ref, *t;
+    size_t total = 0, voiced = 0;
+    formant_opts_t opts;
+
+    // A high voice, whose first voiced frame scales the ranges right away
+    // from those of the silent frames before it, and which then changes
+    // vowels.
+    for (size_t i = 0; i < RATE / 5; i += 1)
+        samples[i] = 0;
+
+    synth_vowel_f0(samples + RATE / 5, RATE * 2 / 5, RATE, 300, 2300, 400);
+    synth_vowel_f0(samples + RATE * 3 / 5, RATE * 2 / 5, RATE, 800, 1300, 400);
+
+    formant_opts_init(&opts);
+    opts.adapt_ranges = true;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+
+    ref = formant_tracker_new(&opts, RATE);
+    t = formant_tracker_new(&opts, RATE);
+
+    // The mappings dropped as the ranges follow the speaker leave the tracks
+    // as they are with every mapping kept.
+    for (size_t i = 0; i < RATE; i += CHUNK) {
+        size_t len = RATE - i < CHUNK ? RATE - i : CHUNK, n;
+
+        dp_unpruned = true;
+        n = formant_tracker_push(ref, samples + i, len, &want);
+        dp_unpruned = false;
+        GREATEST_ASSERT_EQ(n, formant_tracker_push(t, samples + i, len, &got));
+
+        for (size_t j = 0; j < n; j += 1) {
+            for (size_t l = 0; l < opts.n_formants; l += 1) {
+                GREATEST_ASSERT_EQ(got[j].freq[l], want[j].freq[l]);
+                GREATEST_ASSERT_EQ(got[j].band[l], want[j].band[l]);
+            }
+
+            voiced += got[j].voiced;
+        }
+
+        total += n;
+    }
+
+    GREATEST_ASSERT(voiced > total / 2);
+
+    // The slack allows for the largest jump between frames at any two scales.
+    for (size_t s = 0; s < 2; s += 1) {
+        dp_t lo = t->dp, hi = t->dp;
+        double maxpferr = 0;
+
+        dp_scale(&t->dp, s ? F0_SCALE_MAX : F0_SCALE_MIN);
+        dp_scale(&lo, F0_SCALE_MIN);
+        dp_scale(&hi, F0_SCALE_MAX);
+
+        for (size_t l = 0; l < opts.n_formants; l += 1) {
+            double f = lo.fmins[l], pf = hi.fmaxs[l];
+            double jump = 2 * (pf - f) / (pf + f);
+
+            maxpferr += jump * jump > MISSING ? jump * jump : MISSING;
+        }
+
+        GREATEST_ASSERT(t->dp.maxpferr >= maxpferr - 1e-9);
+    }
+
+    formant_tracker_destroy(ref);
+    formant_tracker_destroy(t);
+    free(samples);
+
+    PASS();
+}
+
+TEST test_fir_cache() {
+    // Tables are built once and then shared.
+    GREATEST_ASSERT(highpass_coefs());
+    GREATEST_ASSERT_EQ(highpass_coefs(), highpass_coefs());
+
+    PASS();
+}
+
+TEST test_sound_calc_formants_workspace() {
+    enum { N = 8000, RATE = 10000 };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * N);
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    sound_t s[2];
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+
+    synth_vowel(samples, N, RATE, 700, 1200);
+    formant_workspace_init(&ws);
+
+    for (size_t k = 0; k < 2; k += 1) {
+        sound_init(&s[k]);
+        sound_reset(&s[k], RATE, 1);
+        sound_load_samples(&s[k], samples, N);
+        GREATEST_ASSERT(sound_calc_formants(&s[k], &opts, &ws));
+    }
+
+    // The first call grows the workspace to fit, so the second shouldn't
+    // need anything more.
+    GREATEST_ASSERT_EQ(ws.spill, NULL);
+    GREATEST_ASSERT_EQ(s[0].n_samples, s[1].n_samples);
+
+    for (size_t i = 0; i < s[0].n_samples; i += 1) {
+        for (size_t j = 0; j < s[0].n_channels; j += 1) {
+            GREATEST_ASSERT_EQ(sound_get_sample(&s[0], j, i),
+                               sound_get_sample(&s[1], j, i));
+        }
+    }
+
+    sound_destroy(&s[0]);
+    sound_destroy(&s[1]);
+    formant_workspace_destroy(&ws);
+    free(samples);
+
+    PASS();
+}
+#endif
+
+#ifdef LIBFORMANT_TEST
+// Calculate the formants of the given samples into s with BSA analysis, which
+// dithers its input.
+static void calc_bsa(const formant_sample_t *samples, size_t n,
+                     formant_workspace_t *ws, sound_t *s)
+{
+    formant_opts_t opts;
+
+    formant_opts_init(&opts);
+    opts.lpc_type = LPC_TYPE_BSA;
+    formant_opts_process(&opts);
+
+    sound_reset(s, 10000, 1);
+    sound_load_samples(s, samples, n);
+    sound_calc_formants(s, &opts, ws);
+}
+
+static bool sound_equal(const sound_t *a, const sound_t *b) {
+    return a->n_samples == b->n_samples && a->n_channels == b->n_channels &&
+           memcmp(a->samples, b->samples, sizeof(formant_sample_t) *
+                  a->n_samples * a->n_channels) == 0;
+}
+
+TEST test_reentrant() {
+    enum { N = 6000 };
+    formant_sample_t a[N], b[N];
+    formant_workspace_t ws[2];
+    sound_t want, got;
+
+    synth_vowel(a, N, 10000, 500, 1500);
+    synth_vowel(b, N, 10000, 300, 2200);
+    formant_workspace_init(&ws[0]);
+    formant_workspace_init(&ws[1]);
+    sound_init(&want);
+    sound_init(&got);
+
+    calc_bsa(a, N, &ws[0], &want);
+
+    // Neither another workspace's work nor the libc generator should affect
+    // the result.
+    srand(9);
+    rand();
+    calc_bsa(b, N, &ws[1], &got);
+    calc_bsa(a, N, &ws[1], &got);
+    GREATEST_ASSERT(sound_equal(&want, &got));
+    calc_bsa(a, N, &ws[0], &got);
+    GREATEST_ASSERT(sound_equal(&want, &got));
+
+    sound_destroy(&want);
+    sound_destroy(&got);
+    formant_workspace_destroy(&ws[0]);
+    formant_workspace_destroy(&ws[1]);
+
+    PASS();
+}
+#endif
+
+#ifdef LIBFORMANT_TEST
+TEST test_sound_calc_formants_parallel() {
+    enum { RATE = 16000, SECS = 35 };
+    const size_t threads[] = {2, 3, 8};
+    const size_t n = RATE * SECS;
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * n);
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    sound_t want, got;
+
+    // Run through a different vowel every second, so the tracks move across
+    // the boundaries between the segments of the lattice.
+    for (size_t i = 0; i < SECS; i += 1)
+        synth_vowel(samples + i * RATE, RATE, RATE, 300 + i * 37 % 500,
+                    900 + i * 211 % 1400);
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    formant_workspace_init(&ws);
+    sound_init(&want);
+    sound_init(&got);
+
+    sound_reset(&want, RATE, 1);
+    sound_load_samples(&want, samples, n);
+    GREATEST_ASSERT(sound_calc_formants(&want, &opts, &ws));
+
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i += 1) {
+        sound_reset(&got, RATE, 1);
+        sound_load_samples(&got, samples, n);
+        GREATEST_ASSERT(sound_calc_formants_parallel(&got, &opts, &ws,
+                                                     threads[i]));
+        GREATEST_ASSERT(sound_equal(&want, &got));
+    }
+
+    sound_destroy(&want);
+    sound_destroy(&got);
+    formant_workspace_destroy(&ws);
+    free(samples);
+
+    PASS();
+}
+#endif
+
+#ifdef LIBFORMANT_TEST
+TEST test_sound_calc_frames() {
+    enum { RATE = 16000, N = RATE };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * N);
+    formant_frame_t *frames;
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    size_t n, loud = 0, quiet = 0;
+    sound_t s;
+
+    // A vowel whose second half is 40dB down.
+    synth_vowel(samples, N, RATE, 600, 1400);
+
+    for (size_t i = N / 2; i < N; i += 1)
+        samples[i] /= 100;
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    formant_workspace_init(&ws);
+    sound_init(&s);
+    sound_reset(&s, RATE, 1);
+    sound_load_samples(&s, samples, N);
+
+    n = sound_count_frames(&s, &opts);
+    frames = malloc(sizeof(formant_frame_t) * n);
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, frames));
+    GREATEST_ASSERT(sound_calc_formants(&s, &opts, &ws));
+    GREATEST_ASSERT_EQ(s.n_samples, n);
+
+    for (size_t i = 0; i < n; i += 1) {
+        for (size_t j = 0; j < opts.n_formants; j += 1) {
+            GREATEST_ASSERT_EQ(sound_get_sample(&s, j, i),
+                               (formant_sample_t) frames[i].freq[j]);
+            GREATEST_ASSERT_EQ(sound_get_sample(&s, j + opts.n_formants, i),
+                               (formant_sample_t) frames[i].band[j]);
+        }
+
+        GREATEST_ASSERT(frames[i].rms >= 0);
+        GREATEST_ASSERT(frames[i].cost >= 0);
+
+        // Skip the frames whose windows straddle the drop.
+        if (i < n / 2 - 4)
+            loud += frames[i].voiced;
+        else if (i > n / 2 + 4)
+            quiet += !frames[i].voiced;
+    }
+
+    GREATEST_ASSERT(loud > (n / 2 - 4) * 9 / 10);
+    GREATEST_ASSERT(quiet > (n - n / 2 - 5) * 9 / 10);
+
+    // Too short for a single window.
+    sound_reset(&s, RATE, 1);
+    sound_load_samples(&s, samples, 10);
+    GREATEST_ASSERT_EQ(sound_count_frames(&s, &opts), 0);
+    GREATEST_ASSERT(!sound_calc_frames(&s, &opts, &ws, frames));
+
+    sound_destroy(&s);
+    formant_workspace_destroy(&ws);
+    free(frames);
+    free(samples);
+
+    PASS();
+}
+#endif
+
+#ifdef LIBFORMANT_TEST
+TEST test_stats() {
+    enum { RATE = 16000 };
+    formant_sample_t samples[2 * RATE] = {0};
+    formant_workspace_t ws;
+    formant_stats_t want;
+    formant_opts_t opts;
+    sound_t s;
+
+    // A second of vowel followed by a second of silence.
+    synth_vowel(samples, RATE, RATE, 500, 1500);
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    formant_workspace_init(&ws);
+    sound_init(&s);
+
+    sound_reset(&s, RATE, 1);
+    sound_load_samples(&s, samples, 2 * RATE);
+    GREATEST_ASSERT(sound_calc_formants(&s, &opts, &ws));
+    want = ws.stats;
+
+    if (!formant_stats_enabled()) {
+        GREATEST_ASSERT_EQ(want.frames, 0);
+        GREATEST_ASSERT_EQ(want.candidates, 0);
+        GREATEST_ASSERT_EQ(want.ns[FORMANT_STAGE_LPC], 0);
+    } else {
+        GREATEST_ASSERT_EQ(want.frames, s.n_samples);
+        GREATEST_ASSERT(want.skipped > want.frames / 3);
+        GREATEST_ASSERT(want.skipped < want.frames * 2 / 3);
+        GREATEST_ASSERT(want.candidates >= want.frames - want.skipped);
+        GREATEST_ASSERT(want.iterations > 0);
+
+        // The counts are the same however the work is split.
+        sound_reset(&s, RATE, 1);
+        sound_load_samples(&s, samples, 2 * RATE);
+        GREATEST_ASSERT(sound_calc_formants_parallel(&s, &opts, &ws, 3));
+        GREATEST_ASSERT_EQ(ws.stats.frames, want.frames);
+        GREATEST_ASSERT_EQ(ws.stats.skipped, want.skipped);
+        GREATEST_ASSERT_EQ(ws.stats.candidates, want.candidates);
+        GREATEST_ASSERT_EQ(ws.stats.iterations, want.iterations);
+        GREATEST_ASSERT_EQ(ws.stats.restarts, want.restarts);
+    }
+
+    sound_destroy(&s);
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+TEST test_beam() {
+    enum { RATE = 16000, SECS = 25 };
+    const size_t n = RATE * SECS;
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * n);
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    sound_t want, got, par;
+    double sum = 0;
+
+    for (size_t i = 0; i < SECS; i += 1)
+        synth_vowel(samples + i * RATE, RATE, RATE, 300 + i * 37 % 500,
+                    900 + i * 211 % 1400);
+
+    formant_opts_init(&opts);
+    opts.lpc_order = 16;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    formant_workspace_init(&ws);
+    sound_init(&want);
+    sound_init(&got);
+    sound_init(&par);
+
+    sound_reset(&want, RATE, 1);
+    sound_load_samples(&want, samples, n);
+    GREATEST_ASSERT(sound_calc_formants(&want, &opts, &ws));
+
+    // A beam wider than any frame's candidates changes nothing.
+    opts.beam_width = MAX_CANDIDATES;
+    sound_reset(&got, RATE, 1);
+    sound_load_samples(&got, samples, n);
+    GREATEST_ASSERT(sound_calc_formants(&got, &opts, &ws));
+    GREATEST_ASSERT(sound_equal(&want, &got));
+
+    opts.beam_width = 20;
+    sound_reset(&got, RATE, 1);
+    sound_load_samples(&got, samples, n);
+    GREATEST_ASSERT(sound_calc_formants(&got, &opts, &ws));
+    GREATEST_ASSERT_EQ(want.n_samples, got.n_samples);
+
+    for (size_t i = 0; i < want.n_samples; i += 1)
+        for (size_t j = 0; j < 2; j += 1)
+            sum += abs(sound_get_sample(&want, j, i) -
+                       sound_get_sample(&got, j, i));
+
+    GREATEST_ASSERT(sum / (2 * want.n_samples) < 5);
+
+    // The pruned lattice is still stitched exactly across threads.
+    sound_reset(&par, RATE, 1);
+    sound_load_samples(&par, samples, n);
+    GREATEST_ASSERT(sound_calc_formants_parallel(&par, &opts, &ws, 3));
+    GREATEST_ASSERT(sound_equal(&got, &par));
+
+    sound_destroy(&want);
+    sound_destroy(&got);
+    sound_destroy(&par);
+    formant_workspace_destroy(&ws);
+    free(samples);
+
+    PASS();
+}
+#endif
+
+#ifdef LIBFORMANT_TEST
+TEST test_precision() {
+    enum { N = 10000, RATE = 10000 };
+    const double vowels[][2] = {
+        {270, 2290}, {530, 1840}, {730, 1090}, {300, 870}, {490, 1350},
+    };
+    formant_sample_t samples[N];
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    sound_t want, got;
+    double sum = 0;
+    size_t n = 0;
+
+    formant_workspace_init(&ws);
+    sound_init(&want);
+    sound_init(&got);
+
+    for (size_t v = 0; v < sizeof(vowels) / sizeof(vowels[0]); v += 1) {
+        synth_vowel(samples, N, RATE, vowels[v][0], vowels[v][1]);
+
+        for (int w = 0; w < WINDOW_TYPE_INVALID; w += 1) {
+            formant_opts_init(&opts);
+            opts.window_type = w;
+            GREATEST_ASSERT(formant_opts_process(&opts));
+
+            sound_reset(&want, RATE, 1);
+            sound_load_samples(&want, samples, N);
+            GREATEST_ASSERT(sound_calc_formants(&want, &opts, &ws));
+
+            opts.precision = PRECISION_FLOAT;
+            sound_reset(&got, RATE, 1);
+            sound_load_samples(&got, samples, N);
+            GREATEST_ASSERT(sound_calc_formants(&got, &opts, &ws));
+
+            GREATEST_ASSERT_EQ(want.n_samples, got.n_samples);
+
+            // Single precision tracks F1 and F2 to within a few Hz.
+            for (size_t i = 0; i < want.n_samples; i += 1) {
+                for (size_t j = 0; j < 2; j += 1) {
+                    double d = abs(sound_get_sample(&want, j, i) -
+                                   sound_get_sample(&got, j, i));
+
+                    GREATEST_ASSERT(d < 20);
+                    sum += d;
+                    n += 1;
+                }
+            }
+        }
+    }
+
+    GREATEST_ASSERT(sum / n < 1);
+
+    sound_destroy(&want);
+    sound_destroy(&got);
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+TEST test_pitch() {
+    enum { RATE = 16000, N = RATE, CHUNK = 160 };
+    const double f0 = (double)RATE / (RATE / 120);
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * N);
+    formant_frame_t *frames;
+    const formant_frame_t *got;
+    formant_tracker_t *t;
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    size_t n, voiced = 0, total = 0;
+    double f1 = 0;
+    sound_t s;
+
+    synth_vowel(samples, N, RATE, 600, 1400);
+
+    formant_workspace_init(&ws);
+    sound_init(&s);
+    sound_reset(&s, RATE, 1);
+    sound_load_samples(&s, samples, N);
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    n = sound_count_frames(&s, &opts);
+    frames = malloc(sizeof(formant_frame_t) * n);
+
+    // Pitch is off by default.
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, frames));
+
+    for (size_t i = 0; i < n; i += 1) {
+        GREATEST_ASSERT_EQ(frames[i].f0, 0);
+        GREATEST_ASSERT_EQ(frames[i].pv, 0);
+    }
+
+    opts.pitch = true;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, frames));
+
+    for (size_t i = 0; i < n; i += 1) {
+        GREATEST_ASSERT(frames[i].pv >= 0 && frames[i].pv <= 1);
+        voiced += fabs(frames[i].f0 - f0) < f0 * 0.02;
+    }
+
+    GREATEST_ASSERT(voiced > n * 9 / 10);
+
+    // Adapting the ranges to a typical voice leaves the tracks where they
+    // were, whether the sound is analysed whole or streamed.
+    formant_opts_init(&opts);
+    opts.adapt_ranges = true;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    GREATEST_ASSERT(opts.pitch);
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, frames));
+
+    for (size_t i = 0; i < n; i += 1)
+        f1 += frames[i].freq[0];
+
+    GREATEST_ASSERT(fabs(f1 / n - 600) < 100);
+
+    t = formant_tracker_new(&opts, RATE);
+    GREATEST_ASSERT(t);
+    f1 = 0;
+
+    for (size_t i = 0; i < N; i += CHUNK) {
+        size_t k = formant_tracker_push(t, samples + i, CHUNK, &got);
+
+        for (size_t j = 0; j < k; j += 1)
+            f1 += got[j].freq[0];
+
+        total += k;
+    }
+
+    GREATEST_ASSERT(total > n / 2);
+    GREATEST_ASSERT(fabs(f1 / total - 600) < 100);
+
+    formant_tracker_destroy(t);
+    sound_destroy(&s);
+    formant_workspace_destroy(&ws);
+    free(frames);
+    free(samples);
+
+    PASS();
+}
+
+TEST test_vad() {
+    enum { RATE = 16000, N = RATE };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * N);
+    formant_frame_t *want, *got;
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    uint32_t seed = 5;
+    size_t n, voiced = 0;
+    sound_t s;
+
+    // A vowel followed by hiss, loud enough that LPC analysis would look at
+    // it.
+    synth_vowel(samples, N / 2, RATE, 500, 1500);
+
+    for (size_t i = N / 2; i < N; i += 1) {
+        seed = seed * 1664525 + 1013904223;
+        samples[i] = (int)(seed >> 23) - 256;
+    }
+
+    formant_workspace_init(&ws);
+    sound_init(&s);
+    sound_reset(&s, RATE, 1);
+    sound_load_samples(&s, samples, N);
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    n = sound_count_frames(&s, &opts);
+    want = malloc(sizeof(formant_frame_t) * n);
+    got = malloc(sizeof(formant_frame_t) * n);
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, want));
+
+    opts.vad = true;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, got));
+
+    // The vowel is analysed as before, up to the frames whose windows reach
+    // into the hiss.
+    for (size_t i = 0; i < n / 2 - 5; i += 1) {
+        GREATEST_ASSERT(got[i].rms > 0);
+        voiced += got[i].voiced;
+
+        for (size_t j = 0; j < opts.n_formants; j += 1)
+            GREATEST_ASSERT_EQ(got[i].freq[j], want[i].freq[j]);
+    }
+
+    GREATEST_ASSERT(voiced > (n / 2 - 5) * 9 / 10);
+
+    // The hiss is skipped.
+    for (size_t i = n / 2 + 5; i < n; i += 1) {
+        GREATEST_ASSERT_EQ(got[i].rms, 0);
+        GREATEST_ASSERT(!got[i].voiced);
+        GREATEST_ASSERT(isinf(got[i].cost));
+    }
+
+    opts.vad_floor = -1;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    sound_destroy(&s);
+    formant_workspace_destroy(&ws);
+    free(want);
+    free(got);
+    free(samples);
+
+    PASS();
+}
+#endif
+
+#ifdef LIBFORMANT_TEST
+TEST test_pole_peaks() {
+    enum { RATE = 10000, N = RATE / 2 };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * N);
+    const formant_frame_t *frames;
+    formant_tracker_t *t;
+    formant_opts_t opts;
+    double f[2] = {0};
+    size_t n, voiced = 0;
+
+    synth_vowel(samples, N, RATE, 700, 1200);
+
+    formant_opts_init(&opts);
+    opts.pole_type = POLE_TYPE_PEAKS;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+
+    // The peaks of the envelope feed the tracker as the roots would.
+    t = formant_tracker_new(&opts, RATE);
+    GREATEST_ASSERT(t != NULL);
+    n = formant_tracker_push(t, samples, N, &frames);
+
+    for (size_t i = n / 4; i < n; i += 1) {
+        if (frames[i].voiced) {
+            f[0] += frames[i].freq[0];
+            f[1] += frames[i].freq[1];
+            voiced += 1;
+        }
+    }
+
+    GREATEST_ASSERT(voiced > 0);
+    GREATEST_ASSERT(fabs(f[0] / voiced - 700) < 50);
+    GREATEST_ASSERT(fabs(f[1] / voiced - 1200) < 50);
+
+    formant_tracker_destroy(t);
+
+    opts.pole_type = POLE_TYPE_INVALID;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    free(samples);
+
+    PASS();
+}
+
+TEST test_lpc_high_rate() {
+    enum { RATE = 44100, N = RATE / 2 };
+    static const int types[] = { LPC_TYPE_BSA, LPC_TYPE_COVAR, LPC_TYPE_BURG };
+    formant_sample_t *samples = malloc(sizeof(formant_sample_t) * N);
+    const formant_frame_t *frames;
+    formant_tracker_t *t;
+    formant_opts_t opts;
+    size_t size;
+
+    synth_vowel(samples, N, RATE, 700, 1200);
+
+    for (size_t k = 0; k < sizeof(types) / sizeof(types[0]); k += 1) {
+        double f1 = 0;
+        size_t n, voiced = 0;
+
+        formant_opts_init(&opts);
+        opts.downsample_rate = RATE;
+        opts.lpc_type = types[k];
+        opts.lpc_order = 24;
+        GREATEST_ASSERT(formant_opts_process(&opts));
+
+        // Windows at this rate are longer than BSA analysis used to have
+        // room for.
+        t = formant_tracker_new(&opts, RATE);
+        GREATEST_ASSERT(t != NULL);
+        GREATEST_ASSERT(t->size > 1000);
+        size = t->ws.size;
+
+        n = formant_tracker_push(t, samples, N, &frames);
+
+        for (size_t i = n / 4; i < n; i += 1) {
+            if (frames[i].voiced) {
+                f1 += frames[i].freq[0];
+                voiced += 1;
+            }
+        }
+
+        GREATEST_ASSERT(voiced > 0);
+        GREATEST_ASSERT(fabs(f1 / voiced - 700) < 100);
+
+        // The workspace was sized for a frame up front, so no frame had to
+        // grow it.
+        GREATEST_ASSERT_EQ(t->ws.size, size);
+
+        formant_tracker_destroy(t);
+    }
+
+    free(samples);
+
+    PASS();
+}
+
+// Calculate the frames of the n mono samples at x with the given options into
+// frames, which must have room for them.
+static bool calc_mono(const formant_sample_t *x, size_t n, size_t rate,
+                      const formant_opts_t *opts, formant_workspace_t *ws,
+                      formant_frame_t *frames)
+{
+    sound_t s;
+    bool ok;
+
+    sound_init(&s);
+    sound_reset(&s, rate, 1);
+    sound_load_samples(&s, x, n);
+    ok = sound_calc_frames(&s, opts, ws, frames);
+    sound_destroy(&s);
+
+    return ok;
+}
+
+static bool frames_equal(const formant_frame_t *a, const formant_frame_t *b,
+                         size_t n, size_t nform)
+{
+    for (size_t i = 0; i < n; i += 1) {
+        for (size_t j = 0; j < nform; j += 1) {
+            if (a[i].freq[j] != b[i].freq[j] || a[i].band[j] != b[i].band[j])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+TEST test_channels() {
+    enum { RATE = 16000, N = RATE / 2 };
+    formant_sample_t *left = malloc(sizeof(formant_sample_t) * N);
+    formant_sample_t *right = malloc(sizeof(formant_sample_t) * N);
+    formant_sample_t *mix = malloc(sizeof(formant_sample_t) * N);
+    formant_sample_t *both = malloc(sizeof(formant_sample_t) * N * 2);
+    formant_frame_t *want, *got;
+    formant_workspace_t ws;
+    formant_opts_t opts;
+    size_t n;
+    sound_t s;
+
+    // A duet, one voice to a channel.
+    synth_vowel(left, N, RATE, 700, 1200);
+    synth_vowel(right, N, RATE, 300, 2300);
+
+    for (size_t i = 0; i < N; i += 1) {
+        both[2 * i] = left[i];
+        both[2 * i + 1] = right[i];
+        mix[i] = ((int) left[i] + right[i]) / 2;
+    }
+
+    formant_workspace_init(&ws);
+    sound_init(&s);
+    sound_reset(&s, RATE, 2);
+    sound_load_samples(&s, both, N * 2);
+
+    formant_opts_init(&opts);
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    n = sound_count_frames(&s, &opts);
+    want = malloc(sizeof(formant_frame_t) * n * 2);
+    got = malloc(sizeof(formant_frame_t) * n * 2);
+
+    // By default, just the first channel is analysed.
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, got));
+    GREATEST_ASSERT(calc_mono(left, N, RATE, &opts, &ws, want));
+    GREATEST_ASSERT(frames_equal(got, want, n, opts.n_formants));
+
+    opts.channels = CHANNELS_MIX;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    GREATEST_ASSERT_EQ(sound_count_frames(&s, &opts), n);
+    GREATEST_ASSERT(sound_calc_frames(&s, &opts, &ws, got));
+    GREATEST_ASSERT(calc_mono(mix, N, RATE, &opts, &ws, want));
+    GREATEST_ASSERT(frames_equal(got, want, n, opts.n_formants));
+
+    // Each channel is tracked as if it were on its own, whatever the number
+    // of threads.
+    opts.channels = CHANNELS_EACH;
+    GREATEST_ASSERT(formant_opts_process(&opts));
+    GREATEST_ASSERT_EQ(sound_count_frames(&s, &opts), n * 2);
+    GREATEST_ASSERT(calc_mono(left, N, RATE, &opts, &ws, want));
+    GREATEST_ASSERT(calc_mono(right, N, RATE, &opts, &ws, want + n));
+
+    for (size_t threads = 1; threads <= 3; threads += 2) {
+        GREATEST_ASSERT(sound_calc_frames_parallel(&s, &opts, &ws, threads,
+                                                   got));
+        GREATEST_ASSERT(frames_equal(got, want, n * 2, opts.n_formants));
+    }
+
+    GREATEST_ASSERT(fabs(got[n / 2].freq[0] - 700) < 100);
+    GREATEST_ASSERT(fabs(got[n + n / 2].freq[0] - 300) < 100);
+
+    // Formants come out track by track.
+    GREATEST_ASSERT(sound_calc_formants(&s, &opts, &ws));
+    GREATEST_ASSERT_EQ(s.n_samples, n);
+    GREATEST_ASSERT_EQ(s.n_channels, opts.n_formants * 4);
+
+    for (size_t i = 0; i < n; i += 1) {
+        GREATEST_ASSERT_EQ(sound_get_f1(&s, i),
+                           (formant_sample_t) want[i].freq[0]);
+        GREATEST_ASSERT_EQ(sound_get_sample(&s, opts.n_formants * 2, i),
+                           (formant_sample_t) want[n + i].freq[0]);
+    }
+
+    opts.channels = CHANNELS_INVALID;
+    GREATEST_ASSERT(!formant_opts_process(&opts));
+
+    sound_destroy(&s);
+    formant_workspace_destroy(&ws);
+    free(want);
+    free(got);
+    free(left);
+    free(right);
+    free(mix);
+    free(both);
+
+    PASS();
+}
+
 SUITE(formant_suite) {
     RUN_TEST(test_formant_opts_process);
     RUN_TEST(test_sound_load_samples);
+    RUN_TEST(test_dp_candidates);
+    RUN_TEST(test_formant_tracker);
+    RUN_TEST(test_formant_tracker_lag);
+    RUN_TEST(test_formant_tracker_adapt);
+    RUN_TEST(test_sound_calc_formants_workspace);
+    RUN_TEST(test_fir_cache);
+    RUN_TEST(test_reentrant);
+    RUN_TEST(test_sound_calc_formants_parallel);
+    RUN_TEST(test_sound_calc_frames);
+    RUN_TEST(test_beam);
+    RUN_TEST(test_precision);
+    RUN_TEST(test_pitch);
+    RUN_TEST(test_vad);
+    RUN_TEST(test_lpc_high_rate);
+    RUN_TEST(test_pole_peaks);
+    RUN_TEST(test_channels);
+    RUN_TEST(test_stats);
 }
 #endif
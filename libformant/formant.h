@@ -15,10 +15,14 @@
 #include <stddef.h>
 
 #include "processing.h"
+#include "workspace.h"
 
 // How input samples are represented.
 typedef short formant_sample_t;
 
+// Maximum number of formants that can be calculated.
+enum { MAX_FORMANTS = 7 };
+
 // Parameters for calculating formants.
 typedef struct {
     // Number of formants to calculate.
@@ -42,6 +46,9 @@ typedef struct {
         LPC_TYPE_NORMAL,
         LPC_TYPE_BSA,
         LPC_TYPE_COVAR,
+        // Burg's method, which stays stable over windows of 15-20ms, for
+        // about half the latency of the default 49ms.
+        LPC_TYPE_BURG,
 
         LPC_TYPE_INVALID,
     } lpc_type;
@@ -49,6 +56,78 @@ typedef struct {
     // XXX: not sure what these do.
     size_t lpc_order;
     double nom_freq;
+
+    // How the formant candidates of each frame are found from its LPC
+    // polynomial.
+    enum {
+        // By the roots of the polynomial, which are its poles.
+        POLE_TYPE_ROOTS,
+        // By the peaks of the spectral envelope of the polynomial, which take
+        // the same time in every frame rather than an iterative search. They
+        // come out within a few Hz of the poles of clear formants, which is
+        // close enough for a live display, and leave out the poles that make
+        // no peak, so the tracker has far fewer candidates to weigh too.
+        POLE_TYPE_PEAKS,
+
+        POLE_TYPE_INVALID,
+    } pole_type;
+
+    // Floating-point precision of the windowing and autocorrelation in
+    // LPC_TYPE_NORMAL analysis. Single precision doubles the points handled
+    // per vector instruction and tracks vowel formants about as well.
+    precision_t precision;
+
+    // Number of best partial formant tracks kept from one frame to the next,
+    // or 0 to keep them all. The tracker's work then grows linearly rather
+    // than quadratically with the number of candidate mappings, which high LPC
+    // orders multiply. A beam of 20 picks the same formants as the full search
+    // in nearly every frame up to order 20; see bench/beam.c.
+    size_t beam_width;
+
+    // Longest time in seconds a formant tracker may put off deciding the
+    // formants of a frame. Each frame is decided as soon as every path the
+    // tracker still follows agrees on it, or once this much later audio has
+    // been analysed, whichever comes first. With 0, every push decides all the
+    // frames it completes. Between 0.03 and 0.05 gives nearly the tracks of a
+    // whole recording with a latency that doesn't depend on the size of the
+    // pushes.
+    double max_lag;
+
+    // Whether to estimate the F0 of each frame, by normalized cross-correlation
+    // of the frame with itself. This takes about as long again as LPC
+    // analysis and root finding together, far quicker than real time still.
+    bool pitch;
+    // Whether to scale the formant ranges to the speaker, by the median F0 of
+    // the voiced frames of a sound, or a running average over a stream.
+    // Higher voices, whose formants are higher, are then tracked about as well
+    // as low ones. Implies pitch.
+    bool adapt_ranges;
+
+    // Whether to check each frame for voiced speech before LPC analysis, by
+    // its level, zero-crossing rate, and spectral flatness, and skip the
+    // analysis, root finding, and pitch of frames of silence or noise. They
+    // come out unvoiced with no formants, so the tracker has nothing to weigh
+    // in them either. Listening to silence then costs next to nothing.
+    bool vad;
+    // RMS amplitude below which frames count as silence when vad is set, in
+    // the units of the samples.
+    double vad_floor;
+
+    // Which channels of a sound to analyse. Trackers take a single channel
+    // whatever this says.
+    enum {
+        // Just the first, as a single track.
+        CHANNELS_FIRST,
+        // The average of them all, as a single track. This favours sound that
+        // reaches every microphone at once, as a delay-and-sum beamformer
+        // steered straight ahead would.
+        CHANNELS_MIX,
+        // Every channel, as a track of its own, such as one voice of a duet
+        // recorded in stereo.
+        CHANNELS_EACH,
+
+        CHANNELS_INVALID,
+    } channels;
 } formant_opts_t;
 
 // Initialize the given options to (wavesurfer) defaults.
@@ -92,9 +171,29 @@ void sound_load_samples(sound_t *s, const formant_sample_t *samples, size_t n_sa
 // The sound is modified in place such that
 //
 //  - n_samples is set to the number of formants calculated
-//  - n_channels is set to 2 * n_samples
+//  - n_channels is set to 2 * n_formants for every track analysed, with the
+//    formants of each track followed by their bandwidths, track by track
+//
+// All scratch memory and random state are taken from the given workspace, which
+// is reset at the start of each call and reseeded for every frame, so the
+// result depends only on the sound and options. Reusing the same workspace
+// across calls avoids heap allocations once it has grown large enough.
+//
+// The stats of the workspace are cleared at the start of each call and describe
+// just that call once it returns.
 //
-bool sound_calc_formants(sound_t *s, const formant_opts_t *opts);
+// Calls with separate sounds and workspaces may run in separate threads at
+// once. The same goes for separate trackers below.
+bool sound_calc_formants(sound_t *s, const formant_opts_t *opts,
+                         formant_workspace_t *ws);
+
+// Like sound_calc_formants, but split the work across n_threads threads, the
+// calling thread among them. Each extra thread gets a workspace of its own for
+// the length of the call. The result is identical to that of
+// sound_calc_formants whatever the number of threads, which pays off for
+// recordings of a minute or more.
+bool sound_calc_formants_parallel(sound_t *s, const formant_opts_t *opts,
+                                  formant_workspace_t *ws, size_t n_threads);
 
 // Get the i'th sample in the given channel.
 static inline formant_sample_t sound_get_sample(const sound_t *s, size_t chan, size_t i) {
@@ -111,4 +210,80 @@ static inline formant_sample_t sound_get_f2(const sound_t *s, size_t i) {
     return sound_get_sample(s, 1, i);
 }
 
+// The formants calculated for a single analysis frame.
+typedef struct {
+    // Formant frequencies in Hz, F1 first.
+    double freq[MAX_FORMANTS];
+    // Formant bandwidths in Hz.
+    double band[MAX_FORMANTS];
+    // RMS amplitude of the frame as seen by LPC analysis, or 0 if the frame
+    // was skipped as silence or noise.
+    double rms;
+    // Cost of the poles chosen as formants on their own, before weighing how
+    // well they follow on from the frame before. It grows as the formants get
+    // less likely, and is infinite if no poles could be formants, in which case
+    // the formants are placeholders.
+    double cost;
+    // Whether the frame looks like voiced speech: F1 was found and the frame is
+    // within 30dB of the loudest frame of the sound, or of the stream so far.
+    bool voiced;
+    // F0 in Hz, or 0 if the frame doesn't look periodic or pitch is off.
+    double f0;
+    // How periodic the frame is, from 0 to 1, or 0 if pitch is off.
+    double pv;
+} formant_frame_t;
+
+// Get the number of frames sound_calc_frames produces for the given sound,
+// over every track analysed.
+size_t sound_count_frames(const sound_t *s, const formant_opts_t *opts);
+
+// Like sound_calc_formants, but store the formants of each frame along with
+// their bandwidths and the other measures above in frames, which must have
+// room for sound_count_frames frames, and leave the sound alone. With
+// CHANNELS_EACH, the frames of channel 0 come first, then those of channel 1,
+// and so on, each as many as the sound has frames.
+bool sound_calc_frames(const sound_t *s, const formant_opts_t *opts,
+                       formant_workspace_t *ws, formant_frame_t *frames);
+
+// Like sound_calc_frames, but split the work across threads as
+// sound_calc_formants_parallel does.
+bool sound_calc_frames_parallel(const sound_t *s, const formant_opts_t *opts,
+                                formant_workspace_t *ws, size_t n_threads,
+                                formant_frame_t *frames);
+
+// A formant tracker that consumes audio as a continuous stream. Unlike
+// sound_calc_formants, which treats every call as a separate utterance, the
+// tracker keeps its filter memory, root-finder starting points, and dynamic
+// programming costs from one call to the next.
+typedef struct formant_tracker formant_tracker_t;
+
+// Create a tracker for mono audio at the given sample rate. The options must
+// have been processed by formant_opts_process. Return NULL on failure.
+formant_tracker_t *formant_tracker_new(const formant_opts_t *opts,
+                                       size_t sample_rate);
+
+// Release the memory held by the given tracker.
+void formant_tracker_destroy(formant_tracker_t *t);
+
+// Forget all audio pushed so far, as if the tracker were newly created.
+void formant_tracker_reset(formant_tracker_t *t);
+
+// Push the next n_samples samples of the stream into the tracker and return
+// the number of frames that were decided since the last push, in order and
+// following on from those returned before. The frames are stored in *frames,
+// which remains valid until the next call to push, flush, or reset. See
+// max_lag for when frames are decided.
+size_t formant_tracker_push(formant_tracker_t *t,
+                            const formant_sample_t *samples, size_t n_samples,
+                            const formant_frame_t **frames);
+
+// Decide every frame that's been put off, as at the end of the stream, and
+// return their number, with the frames stored as for push.
+size_t formant_tracker_flush(formant_tracker_t *t,
+                             const formant_frame_t **frames);
+
+// Get the stats of the last push into or flush of the given tracker, which
+// remain valid until the next call to either.
+const formant_stats_t *formant_tracker_stats(const formant_tracker_t *t);
+
 #endif
@@ -0,0 +1,1207 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "fft.h"
+#include "kernels.h"
+
+#ifdef LIBFORMANT_TEST
+#include <math.h>
+#include <stdlib.h>
+
+#include "greatest.h"
+#endif
+
+#ifndef __has_attribute
+#define __has_attribute(x) 0
+#endif
+
+// Runtime dispatch to wider instruction sets needs per-function target
+// attributes that allow intrinsics, which GCC supports from 4.9 and clang
+// wherever it has the attribute. The AVX-512 reductions came in GCC 7 and
+// clang 4, which Apple numbers 9.
+#if defined(__x86_64__) && defined(__clang__)
+#if __has_attribute(target)
+#define KERN_AVX2 1
+#if defined(__apple_build_version__) ? __clang_major__ >= 9 : \
+                                      __clang_major__ >= 4
+#define KERN_AVX512 1
+#endif
+#endif
+#elif defined(__x86_64__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define KERN_AVX2 1
+#if __GNUC__ >= 7
+#define KERN_AVX512 1
+#endif
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(KERN_AVX2) || defined(KERN_AVX512)
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Use an FFT for the autocorrelation once direct summation would take this many
+// times n log n multiplies for transforms of length n. Vectorized dot products
+// are cheap enough that this only happens for orders in the hundreds.
+enum { FFT_COST = 32 };
+
+static void window_scalar(const short *a, const short *b, double *dout,
+                          size_t n, double preemp, const double *wind)
+{
+    for (size_t i = 0; i < n; i += 1)
+        dout[i] = wind[i] * ((double)a[i] - preemp * b[i]);
+}
+
+static void widen_scalar(const short *x, double *dout, size_t n) {
+    for (size_t i = 0; i < n; i += 1)
+        dout[i] = x[i];
+}
+
+static double dot_scalar(const double *x, const double *y, size_t n) {
+    double sum = 0;
+
+    for (size_t i = 0; i < n; i += 1)
+        sum += x[i] * y[i];
+
+    return sum;
+}
+
+static int dot16_scalar(const short *x, const short *y, size_t n) {
+    int sum = 0;
+
+    for (size_t i = 0; i < n; i += 1)
+        sum += x[i] * y[i];
+
+    return sum;
+}
+
+static void window_f_scalar(const short *a, const short *b, float *dout,
+                            size_t n, float preemp, const float *wind)
+{
+    for (size_t i = 0; i < n; i += 1)
+        dout[i] = wind[i] * ((float)a[i] - preemp * b[i]);
+}
+
+static float dot_f_scalar(const float *x, const float *y, size_t n) {
+    float sum = 0;
+
+    for (size_t i = 0; i < n; i += 1)
+        sum += x[i] * y[i];
+
+    return sum;
+}
+
+static void jump_scalar(double f, const double *pf, double *err, size_t n,
+                        double miss)
+{
+    for (size_t i = 0; i < n; i += 1) {
+        double d = 2.0 * (f > pf[i] ? f - pf[i] : pf[i] - f) / (f + pf[i]);
+
+        err[i] += pf[i] > 0 ? d * d : miss;
+    }
+}
+
+static void autoc_lanes_scalar(const double *s, size_t n, size_t p,
+                               double *r)
+{
+    for (size_t i = 0; i <= p; i += 1) {
+        double sum[KERN_LANES] = {0};
+
+        for (size_t j = 0; j + i < n; j += 1) {
+            for (size_t l = 0; l < KERN_LANES; l += 1)
+                sum[l] += s[j * KERN_LANES + l] * s[(j + i) * KERN_LANES + l];
+        }
+
+        memcpy(r + i * KERN_LANES, sum, sizeof(sum));
+    }
+}
+
+#if defined(__SSE2__)
+// Convert the four samples at x to doubles in lo and hi.
+static inline void sse2_load4(const short *x, __m128d *lo, __m128d *hi) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)x);
+
+    // Sign extend to 32 bits by shifting back down from the high halves.
+    v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+
+    *lo = _mm_cvtepi32_pd(v);
+    *hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+static void window_sse2(const short *a, const short *b, double *dout,
+                        size_t n, double preemp, const double *wind)
+{
+    __m128d pe = _mm_set1_pd(preemp);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128d alo, ahi, blo, bhi;
+
+        sse2_load4(a + i, &alo, &ahi);
+        sse2_load4(b + i, &blo, &bhi);
+
+        alo = _mm_sub_pd(alo, _mm_mul_pd(pe, blo));
+        ahi = _mm_sub_pd(ahi, _mm_mul_pd(pe, bhi));
+
+        _mm_storeu_pd(dout + i, _mm_mul_pd(_mm_loadu_pd(wind + i), alo));
+        _mm_storeu_pd(dout + i + 2, _mm_mul_pd(_mm_loadu_pd(wind + i + 2), ahi));
+    }
+
+    window_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+static void widen_sse2(const short *x, double *dout, size_t n) {
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128d lo, hi;
+
+        sse2_load4(x + i, &lo, &hi);
+        _mm_storeu_pd(dout + i, lo);
+        _mm_storeu_pd(dout + i + 2, hi);
+    }
+
+    widen_scalar(x + i, dout + i, n - i);
+}
+
+static double dot_sse2(const double *x, const double *y, size_t n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    double part[2];
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2),
+                                       _mm_loadu_pd(y + i + 2)));
+    }
+
+    _mm_storeu_pd(part, _mm_add_pd(s0, s1));
+
+    return part[0] + part[1] + dot_scalar(x + i, y + i, n - i);
+}
+
+static int dot16_sse2(const short *x, const short *y, size_t n) {
+    __m128i s0 = _mm_setzero_si128();
+    int part[4];
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_epi32(s0, _mm_madd_epi16(
+            _mm_loadu_si128((const __m128i *)(x + i)),
+            _mm_loadu_si128((const __m128i *)(y + i))));
+    }
+
+    _mm_storeu_si128((__m128i *)part, s0);
+
+    return part[0] + part[1] + part[2] + part[3] +
+           dot16_scalar(x + i, y + i, n - i);
+}
+
+// Convert the four samples at x to floats.
+static inline __m128 sse2_load4f(const short *x) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)x);
+
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+
+static void window_f_sse2(const short *a, const short *b, float *dout,
+                          size_t n, float preemp, const float *wind)
+{
+    __m128 pe = _mm_set1_ps(preemp);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_sub_ps(sse2_load4f(a + i),
+                               _mm_mul_ps(pe, sse2_load4f(b + i)));
+
+        _mm_storeu_ps(dout + i, _mm_mul_ps(_mm_loadu_ps(wind + i), va));
+    }
+
+    window_f_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+static float dot_f_sse2(const float *x, const float *y, size_t n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    float part[4];
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+                                       _mm_loadu_ps(y + i + 4)));
+    }
+
+    _mm_storeu_ps(part, _mm_add_ps(s0, s1));
+
+    return part[0] + part[1] + part[2] + part[3] +
+           dot_f_scalar(x + i, y + i, n - i);
+}
+
+static void jump_sse2(double f, const double *pf, double *err, size_t n,
+                      double miss)
+{
+    __m128d vf = _mm_set1_pd(f), vmiss = _mm_set1_pd(miss);
+    __m128d two = _mm_set1_pd(2.0), sign = _mm_set1_pd(-0.0);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d p = _mm_loadu_pd(pf + i);
+        __m128d found = _mm_cmpgt_pd(p, _mm_setzero_pd());
+        __m128d d = _mm_div_pd(
+            _mm_mul_pd(two, _mm_andnot_pd(sign, _mm_sub_pd(vf, p))),
+            _mm_add_pd(vf, p));
+
+        d = _mm_or_pd(_mm_and_pd(found, _mm_mul_pd(d, d)),
+                      _mm_andnot_pd(found, vmiss));
+        _mm_storeu_pd(err + i, _mm_add_pd(_mm_loadu_pd(err + i), d));
+    }
+
+    jump_scalar(f, pf + i, err + i, n - i, miss);
+}
+// Add the products of lag i of the interleaved sequences at s over the points
+// from j up to end into the two halves of sum.
+static inline void autoc_lag_sse2(const double *s, size_t i, size_t j,
+                                  size_t end, __m128d *sum)
+{
+    for (; j < end; j += 1) {
+        const double *x = s + j * KERN_LANES, *y = s + (j + i) * KERN_LANES;
+
+        sum[0] = _mm_add_pd(sum[0], _mm_mul_pd(_mm_loadu_pd(x),
+                                               _mm_loadu_pd(y)));
+        sum[1] = _mm_add_pd(sum[1], _mm_mul_pd(_mm_loadu_pd(x + 2),
+                                               _mm_loadu_pd(y + 2)));
+    }
+}
+
+static void autoc_lanes_sse2(const double *s, size_t n, size_t p, double *r) {
+    size_t i = 0;
+
+    // Sum two lags at once, so each addition doesn't wait on the last. The
+    // last two may run past lag p, and the one beyond it is dropped.
+    for (; i <= p && i + 1 < n; i += 2) {
+        __m128d s0[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+        __m128d s1[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+        size_t m = n - i - 1;
+
+        for (size_t j = 0; j < m; j += 1) {
+            const double *x = s + j * KERN_LANES, *y = s + (j + i) * KERN_LANES;
+            __m128d x0 = _mm_loadu_pd(x), x1 = _mm_loadu_pd(x + 2);
+
+            s0[0] = _mm_add_pd(s0[0], _mm_mul_pd(x0, _mm_loadu_pd(y)));
+            s0[1] = _mm_add_pd(s0[1], _mm_mul_pd(x1, _mm_loadu_pd(y + 2)));
+            y += KERN_LANES;
+            s1[0] = _mm_add_pd(s1[0], _mm_mul_pd(x0, _mm_loadu_pd(y)));
+            s1[1] = _mm_add_pd(s1[1], _mm_mul_pd(x1, _mm_loadu_pd(y + 2)));
+        }
+
+        // The shorter lag is done, and the longer one has a point left.
+        autoc_lag_sse2(s, i, m, n - i, s0);
+        _mm_storeu_pd(r + i * KERN_LANES, s0[0]);
+        _mm_storeu_pd(r + i * KERN_LANES + 2, s0[1]);
+
+        if (i + 1 <= p) {
+            _mm_storeu_pd(r + (i + 1) * KERN_LANES, s1[0]);
+            _mm_storeu_pd(r + (i + 1) * KERN_LANES + 2, s1[1]);
+        }
+    }
+
+    for (; i <= p; i += 1) {
+        __m128d sum[2] = {_mm_setzero_pd(), _mm_setzero_pd()};
+
+        autoc_lag_sse2(s, i, 0, i < n ? n - i : 0, sum);
+        _mm_storeu_pd(r + i * KERN_LANES, sum[0]);
+        _mm_storeu_pd(r + i * KERN_LANES + 2, sum[1]);
+    }
+}
+#endif
+
+#ifdef KERN_AVX2
+__attribute__((target("avx2")))
+static void window_avx2(const short *a, const short *b, double *dout,
+                        size_t n, double preemp, const double *wind)
+{
+    __m256d pe = _mm256_set1_pd(preemp);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(
+            _mm_loadl_epi64((const __m128i *)(a + i))));
+        __m256d vb = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(
+            _mm_loadl_epi64((const __m128i *)(b + i))));
+
+        va = _mm256_sub_pd(va, _mm256_mul_pd(pe, vb));
+        _mm256_storeu_pd(dout + i, _mm256_mul_pd(_mm256_loadu_pd(wind + i), va));
+    }
+
+    window_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+__attribute__((target("avx2")))
+static void widen_avx2(const short *x, double *dout, size_t n) {
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dout + i, _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(
+            _mm_loadl_epi64((const __m128i *)(x + i)))));
+    }
+
+    widen_scalar(x + i, dout + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static double dot_avx2(const double *x, const double *y, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    double part[4];
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                             _mm256_loadu_pd(y + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+                                             _mm256_loadu_pd(y + i + 4)));
+    }
+
+    _mm256_storeu_pd(part, _mm256_add_pd(s0, s1));
+
+    return part[0] + part[1] + part[2] + part[3] +
+           dot_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int dot16_avx2(const short *x, const short *y, size_t n) {
+    __m256i s0 = _mm256_setzero_si256();
+    __m128i s;
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(
+            _mm256_loadu_si256((const __m256i *)(x + i)),
+            _mm256_loadu_si256((const __m256i *)(y + i))));
+    }
+
+    s = _mm_add_epi32(_mm256_castsi256_si128(s0),
+                      _mm256_extracti128_si256(s0, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32(s) + dot16_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void window_f_avx2(const short *a, const short *b, float *dout,
+                          size_t n, float preemp, const float *wind)
+{
+    __m256 pe = _mm256_set1_ps(preemp);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(a + i))));
+        __m256 vb = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(b + i))));
+
+        va = _mm256_sub_ps(va, _mm256_mul_ps(pe, vb));
+        _mm256_storeu_ps(dout + i, _mm256_mul_ps(_mm256_loadu_ps(wind + i), va));
+    }
+
+    window_f_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+__attribute__((target("avx2")))
+static float dot_f_avx2(const float *x, const float *y, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m128 s;
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + i),
+                                             _mm256_loadu_ps(y + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8),
+                                             _mm256_loadu_ps(y + i + 8)));
+    }
+
+    s0 = _mm256_add_ps(s0, s1);
+    s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+
+    return _mm_cvtss_f32(s) + dot_f_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void jump_avx2(double f, const double *pf, double *err, size_t n,
+                      double miss)
+{
+    __m256d vf = _mm256_set1_pd(f), vmiss = _mm256_set1_pd(miss);
+    __m256d two = _mm256_set1_pd(2.0), sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d p = _mm256_loadu_pd(pf + i);
+        __m256d found = _mm256_cmp_pd(p, _mm256_setzero_pd(), _CMP_GT_OQ);
+        __m256d d = _mm256_div_pd(
+            _mm256_mul_pd(two, _mm256_andnot_pd(sign, _mm256_sub_pd(vf, p))),
+            _mm256_add_pd(vf, p));
+
+        d = _mm256_blendv_pd(vmiss, _mm256_mul_pd(d, d), found);
+        _mm256_storeu_pd(err + i, _mm256_add_pd(_mm256_loadu_pd(err + i), d));
+    }
+
+    jump_scalar(f, pf + i, err + i, n - i, miss);
+}
+// Add the products of lag i of the interleaved sequences at s over the points
+// from j up to end to sum.
+__attribute__((target("avx2")))
+static inline __m256d autoc_lag_avx2(const double *s, size_t i, size_t j,
+                                     size_t end, __m256d sum)
+{
+    for (; j < end; j += 1) {
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(
+            _mm256_loadu_pd(s + j * KERN_LANES),
+            _mm256_loadu_pd(s + (j + i) * KERN_LANES)));
+    }
+
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static void autoc_lanes_avx2(const double *s, size_t n, size_t p, double *r) {
+    size_t i = 0;
+
+    // Sum four lags at once, so each addition doesn't wait on the last. The
+    // last four may run past lag p, and those beyond it are dropped.
+    for (; i <= p && i + 3 < n; i += 4) {
+        __m256d s0 = _mm256_setzero_pd(), s1 = s0, s2 = s0, s3 = s0, sum[4];
+        size_t m = n - i - 3;
+
+        // Each point is the next lag's partner at the point after, so only
+        // the partner of the longest lag needs loading.
+        __m256d y0 = _mm256_loadu_pd(s + i * KERN_LANES);
+        __m256d y1 = _mm256_loadu_pd(s + (i + 1) * KERN_LANES);
+        __m256d y2 = _mm256_loadu_pd(s + (i + 2) * KERN_LANES);
+
+        for (size_t j = 0; j < m; j += 1) {
+            __m256d x = _mm256_loadu_pd(s + j * KERN_LANES);
+            __m256d y3 = _mm256_loadu_pd(s + (j + i + 3) * KERN_LANES);
+
+            s0 = _mm256_add_pd(s0, _mm256_mul_pd(x, y0));
+            s1 = _mm256_add_pd(s1, _mm256_mul_pd(x, y1));
+            s2 = _mm256_add_pd(s2, _mm256_mul_pd(x, y2));
+            s3 = _mm256_add_pd(s3, _mm256_mul_pd(x, y3));
+            y0 = y1;
+            y1 = y2;
+            y2 = y3;
+        }
+
+        // The longest lag is done, and the shorter ones have up to three
+        // points left.
+        sum[0] = autoc_lag_avx2(s, i, m, n - i, s0);
+        sum[1] = autoc_lag_avx2(s, i + 1, m, n - i - 1, s1);
+        sum[2] = autoc_lag_avx2(s, i + 2, m, n - i - 2, s2);
+        sum[3] = s3;
+
+        for (size_t k = 0; k < 4 && i + k <= p; k += 1)
+            _mm256_storeu_pd(r + (i + k) * KERN_LANES, sum[k]);
+    }
+
+    for (; i <= p; i += 1) {
+        _mm256_storeu_pd(r + i * KERN_LANES,
+                         autoc_lag_avx2(s, i, 0, i < n ? n - i : 0,
+                                        _mm256_setzero_pd()));
+    }
+}
+#endif
+
+#ifdef KERN_AVX512
+__attribute__((target("avx512f")))
+static void window_avx512(const short *a, const short *b, double *dout,
+                          size_t n, double preemp, const double *wind)
+{
+    __m512d pe = _mm512_set1_pd(preemp);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512d va = _mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(a + i))));
+        __m512d vb = _mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(b + i))));
+
+        va = _mm512_sub_pd(va, _mm512_mul_pd(pe, vb));
+        _mm512_storeu_pd(dout + i, _mm512_mul_pd(_mm512_loadu_pd(wind + i), va));
+    }
+
+    window_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+__attribute__((target("avx512f")))
+static void widen_avx512(const short *x, double *dout, size_t n) {
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(dout + i, _mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(
+            _mm_loadu_si128((const __m128i *)(x + i)))));
+    }
+
+    widen_scalar(x + i, dout + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static double dot_avx512(const double *x, const double *y, size_t n) {
+    __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm512_add_pd(s0, _mm512_mul_pd(_mm512_loadu_pd(x + i),
+                                             _mm512_loadu_pd(y + i)));
+        s1 = _mm512_add_pd(s1, _mm512_mul_pd(_mm512_loadu_pd(x + i + 8),
+                                             _mm512_loadu_pd(y + i + 8)));
+    }
+
+    return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1)) +
+           dot_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void window_f_avx512(const short *a, const short *b, float *dout,
+                            size_t n, float preemp, const float *wind)
+{
+    __m512 pe = _mm512_set1_ps(preemp);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m512 va = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(
+            _mm256_loadu_si256((const __m256i *)(a + i))));
+        __m512 vb = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(
+            _mm256_loadu_si256((const __m256i *)(b + i))));
+
+        va = _mm512_sub_ps(va, _mm512_mul_ps(pe, vb));
+        _mm512_storeu_ps(dout + i, _mm512_mul_ps(_mm512_loadu_ps(wind + i), va));
+    }
+
+    window_f_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+__attribute__((target("avx512f")))
+static float dot_f_avx512(const float *x, const float *y, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(_mm512_loadu_ps(x + i),
+                                             _mm512_loadu_ps(y + i)));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(_mm512_loadu_ps(x + i + 16),
+                                             _mm512_loadu_ps(y + i + 16)));
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1)) +
+           dot_f_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void jump_avx512(double f, const double *pf, double *err, size_t n,
+                        double miss)
+{
+    __m512d vf = _mm512_set1_pd(f), vmiss = _mm512_set1_pd(miss);
+    __m512d two = _mm512_set1_pd(2.0);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512d p = _mm512_loadu_pd(pf + i);
+        __mmask8 found = _mm512_cmp_pd_mask(p, _mm512_setzero_pd(), _CMP_GT_OQ);
+        __m512d d = _mm512_div_pd(
+            _mm512_mul_pd(two, _mm512_abs_pd(_mm512_sub_pd(vf, p))),
+            _mm512_add_pd(vf, p));
+
+        d = _mm512_mask_blend_pd(found, vmiss, _mm512_mul_pd(d, d));
+        _mm512_storeu_pd(err + i, _mm512_add_pd(_mm512_loadu_pd(err + i), d));
+    }
+
+    jump_scalar(f, pf + i, err + i, n - i, miss);
+}
+#endif
+
+#if defined(__aarch64__)
+static void window_neon(const short *a, const short *b, double *dout,
+                        size_t n, double preemp, const double *wind)
+{
+    float64x2_t pe = vdupq_n_f64(preemp);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        int32x2_t ia = {a[i], a[i + 1]}, ib = {b[i], b[i + 1]};
+        float64x2_t va = vcvtq_f64_s64(vmovl_s32(ia));
+        float64x2_t vb = vcvtq_f64_s64(vmovl_s32(ib));
+
+        va = vsubq_f64(va, vmulq_f64(pe, vb));
+        vst1q_f64(dout + i, vmulq_f64(vld1q_f64(wind + i), va));
+    }
+
+    window_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+static void widen_neon(const short *x, double *dout, size_t n) {
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        int32x2_t v = {x[i], x[i + 1]};
+
+        vst1q_f64(dout + i, vcvtq_f64_s64(vmovl_s32(v)));
+    }
+
+    widen_scalar(x + i, dout + i, n - i);
+}
+
+static double dot_neon(const double *x, const double *y, size_t n) {
+    float64x2_t s0 = vdupq_n_f64(0), s1 = vdupq_n_f64(0);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        s0 = vaddq_f64(s0, vmulq_f64(vld1q_f64(x + i), vld1q_f64(y + i)));
+        s1 = vaddq_f64(s1, vmulq_f64(vld1q_f64(x + i + 2),
+                                     vld1q_f64(y + i + 2)));
+    }
+
+    return vaddvq_f64(vaddq_f64(s0, s1)) + dot_scalar(x + i, y + i, n - i);
+}
+
+static int dot16_neon(const short *x, const short *y, size_t n) {
+    int32x4_t s0 = vdupq_n_s32(0), s1 = vdupq_n_s32(0);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t vx = vld1q_s16(x + i), vy = vld1q_s16(y + i);
+
+        s0 = vmlal_s16(s0, vget_low_s16(vx), vget_low_s16(vy));
+        s1 = vmlal_s16(s1, vget_high_s16(vx), vget_high_s16(vy));
+    }
+
+    return vaddvq_s32(vaddq_s32(s0, s1)) + dot16_scalar(x + i, y + i, n - i);
+}
+
+static void window_f_neon(const short *a, const short *b, float *dout,
+                          size_t n, float preemp, const float *wind)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t va = vcvtq_f32_s32(vmovl_s16(vld1_s16(a + i)));
+        float32x4_t vb = vcvtq_f32_s32(vmovl_s16(vld1_s16(b + i)));
+
+        va = vsubq_f32(va, vmulq_n_f32(vb, preemp));
+        vst1q_f32(dout + i, vmulq_f32(vld1q_f32(wind + i), va));
+    }
+
+    window_f_scalar(a + i, b + i, dout + i, n - i, preemp, wind + i);
+}
+
+static float dot_f_neon(const float *x, const float *y, size_t n) {
+    float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = vaddq_f32(s0, vmulq_f32(vld1q_f32(x + i), vld1q_f32(y + i)));
+        s1 = vaddq_f32(s1, vmulq_f32(vld1q_f32(x + i + 4),
+                                     vld1q_f32(y + i + 4)));
+    }
+
+    return vaddvq_f32(vaddq_f32(s0, s1)) + dot_f_scalar(x + i, y + i, n - i);
+}
+
+static void jump_neon(double f, const double *pf, double *err, size_t n,
+                      double miss)
+{
+    float64x2_t vf = vdupq_n_f64(f), vmiss = vdupq_n_f64(miss);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t p = vld1q_f64(pf + i);
+        uint64x2_t found = vcgtzq_f64(p);
+        float64x2_t d = vdivq_f64(vmulq_n_f64(vabdq_f64(vf, p), 2.0),
+                                  vaddq_f64(vf, p));
+
+        d = vbslq_f64(found, vmulq_f64(d, d), vmiss);
+        vst1q_f64(err + i, vaddq_f64(vld1q_f64(err + i), d));
+    }
+
+    jump_scalar(f, pf + i, err + i, n - i, miss);
+}
+// Add the products of lag i of the interleaved sequences at s over the points
+// from j up to end into the two halves of sum.
+static inline void autoc_lag_neon(const double *s, size_t i, size_t j,
+                                  size_t end, float64x2_t *sum)
+{
+    for (; j < end; j += 1) {
+        const double *x = s + j * KERN_LANES, *y = s + (j + i) * KERN_LANES;
+
+        sum[0] = vaddq_f64(sum[0], vmulq_f64(vld1q_f64(x), vld1q_f64(y)));
+        sum[1] = vaddq_f64(sum[1], vmulq_f64(vld1q_f64(x + 2),
+                                             vld1q_f64(y + 2)));
+    }
+}
+
+static void autoc_lanes_neon(const double *s, size_t n, size_t p, double *r) {
+    size_t i = 0;
+
+    // Sum two lags at once, so each addition doesn't wait on the last. The
+    // last two may run past lag p, and the one beyond it is dropped.
+    for (; i <= p && i + 1 < n; i += 2) {
+        float64x2_t s0[2] = {vdupq_n_f64(0), vdupq_n_f64(0)};
+        float64x2_t s1[2] = {vdupq_n_f64(0), vdupq_n_f64(0)};
+        size_t m = n - i - 1;
+
+        for (size_t j = 0; j < m; j += 1) {
+            const double *x = s + j * KERN_LANES, *y = s + (j + i) * KERN_LANES;
+            float64x2_t x0 = vld1q_f64(x), x1 = vld1q_f64(x + 2);
+
+            s0[0] = vaddq_f64(s0[0], vmulq_f64(x0, vld1q_f64(y)));
+            s0[1] = vaddq_f64(s0[1], vmulq_f64(x1, vld1q_f64(y + 2)));
+            y += KERN_LANES;
+            s1[0] = vaddq_f64(s1[0], vmulq_f64(x0, vld1q_f64(y)));
+            s1[1] = vaddq_f64(s1[1], vmulq_f64(x1, vld1q_f64(y + 2)));
+        }
+
+        // The shorter lag is done, and the longer one has a point left.
+        autoc_lag_neon(s, i, m, n - i, s0);
+        vst1q_f64(r + i * KERN_LANES, s0[0]);
+        vst1q_f64(r + i * KERN_LANES + 2, s0[1]);
+
+        if (i + 1 <= p) {
+            vst1q_f64(r + (i + 1) * KERN_LANES, s1[0]);
+            vst1q_f64(r + (i + 1) * KERN_LANES + 2, s1[1]);
+        }
+    }
+
+    for (; i <= p; i += 1) {
+        float64x2_t sum[2] = {vdupq_n_f64(0), vdupq_n_f64(0)};
+
+        autoc_lag_neon(s, i, 0, i < n ? n - i : 0, sum);
+        vst1q_f64(r + i * KERN_LANES, sum[0]);
+        vst1q_f64(r + i * KERN_LANES + 2, sum[1]);
+    }
+}
+#endif
+
+// The fixed-point dot product in the AVX-512 set stays at AVX2 width, since
+// 16-bit multiplies need the separate AVX-512BW extension, and so do the lanes
+// of the autocorrelation, which are only KERN_LANES wide.
+static const kern_impl_t impls[] = {
+    {"scalar", window_scalar, widen_scalar, dot_scalar, dot16_scalar,
+     window_f_scalar, dot_f_scalar, jump_scalar, autoc_lanes_scalar},
+#if defined(__SSE2__)
+    {"sse2", window_sse2, widen_sse2, dot_sse2, dot16_sse2, window_f_sse2,
+     dot_f_sse2, jump_sse2, autoc_lanes_sse2},
+#endif
+#if defined(__aarch64__)
+    {"neon", window_neon, widen_neon, dot_neon, dot16_neon, window_f_neon,
+     dot_f_neon, jump_neon, autoc_lanes_neon},
+#endif
+#ifdef KERN_AVX2
+    {"avx2", window_avx2, widen_avx2, dot_avx2, dot16_avx2, window_f_avx2,
+     dot_f_avx2, jump_avx2, autoc_lanes_avx2},
+#endif
+#ifdef KERN_AVX512
+    {"avx512", window_avx512, widen_avx512, dot_avx512, dot16_avx2,
+     window_f_avx512, dot_f_avx512, jump_avx512, autoc_lanes_avx2},
+#endif
+};
+
+enum { N_IMPLS = sizeof(impls) / sizeof(impls[0]) };
+
+// Check if the given implementation can run on this CPU.
+static bool impl_usable(const kern_impl_t *k) {
+#ifdef KERN_AVX2
+    if (k->window == window_avx2)
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef KERN_AVX512
+    if (k->window == window_avx512)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    (void)k;
+
+    return true;
+}
+
+const kern_impl_t *const *kern_impls(size_t *n) {
+    static const kern_impl_t *usable[N_IMPLS];
+    static size_t n_usable;
+
+    // Every thread computes the same list, so racing here is harmless as long
+    // as the count is published after the entries.
+    if (!__atomic_load_n(&n_usable, __ATOMIC_ACQUIRE)) {
+        size_t count = 0;
+
+        for (size_t i = 0; i < N_IMPLS; i += 1) {
+            if (impl_usable(&impls[i]))
+                usable[count++] = &impls[i];
+        }
+
+        __atomic_store_n(&n_usable, count, __ATOMIC_RELEASE);
+    }
+
+    *n = n_usable;
+
+    return usable;
+}
+
+const kern_impl_t *kern_best(void) {
+    const kern_impl_t *const *k;
+    size_t n;
+
+    k = kern_impls(&n);
+
+    return k[n - 1];
+}
+
+void kern_window(const short *din, double *dout, size_t n, double preemp,
+                 const double *wind)
+{
+    // Without preemphasis, a - 0 * b is exactly a, so din stands in for both.
+    kern_best()->window(preemp != 0.0 ? din + 1 : din, din, dout, n, preemp,
+                        wind);
+}
+
+// Compute the autocorrelation lags as the inverse transform of the power
+// spectrum. The transform is long enough that the circular lags up to p don't
+// wrap around.
+static void autoc_fft(formant_workspace_t *ws, const double *s, size_t n,
+                      size_t p, size_t size, double *r)
+{
+    double *re, *im;
+
+    re = formant_workspace_alloc(ws, sizeof(double) * size);
+    im = formant_workspace_alloc(ws, sizeof(double) * size);
+
+    memcpy(re, s, sizeof(double) * n);
+    memset(re + n, 0, sizeof(double) * (size - n));
+    memset(im, 0, sizeof(double) * size);
+
+    fft(re, im, size, false);
+
+    for (size_t i = 0; i < size; i += 1) {
+        re[i] = re[i] * re[i] + im[i] * im[i];
+        im[i] = 0;
+    }
+
+    fft(re, im, size, true);
+
+    for (size_t i = 0; i <= p; i += 1)
+        r[i] = re[i] / size;
+}
+
+// Get the length of the transform autoc_fft would use for the given problem, or
+// 0 if direct summation is cheaper.
+static size_t autoc_fft_size(size_t n, size_t p) {
+    size_t size, log2;
+
+    size = fft_size(n + p);
+
+    for (log2 = 0; ((size_t)1 << log2) < size; log2 += 1) {}
+
+    return (p + 1) * n > FFT_COST * size * log2 ? size : 0;
+}
+
+void kern_autoc(formant_workspace_t *ws, const double *s, size_t n, size_t p,
+                double *r)
+{
+    const kern_impl_t *k;
+    size_t size = autoc_fft_size(n, p);
+
+    if (size) {
+        autoc_fft(ws, s, n, p, size, r);
+        return;
+    }
+
+    k = kern_best();
+
+    for (size_t i = 0; i <= p; i += 1)
+        r[i] = i < n ? k->dot(s, s + i, n - i) : 0;
+}
+
+void kern_window_f(const short *din, float *dout, size_t n, float preemp,
+                   const float *wind)
+{
+    kern_best()->window_f(preemp != 0.0f ? din + 1 : din, din, dout, n, preemp,
+                          wind);
+}
+
+void kern_autoc_f(formant_workspace_t *ws, const float *s, size_t n, size_t p,
+                  double *r)
+{
+    const kern_impl_t *k;
+    size_t size = autoc_fft_size(n, p);
+
+    // The transform only comes in double precision.
+    if (size) {
+        double *sd = formant_workspace_alloc(ws, sizeof(double) * n);
+
+        for (size_t i = 0; i < n; i += 1)
+            sd[i] = s[i];
+
+        autoc_fft(ws, sd, n, p, size, r);
+        return;
+    }
+
+    k = kern_best();
+
+    for (size_t i = 0; i <= p; i += 1)
+        r[i] = i < n ? k->dot_f(s, s + i, n - i) : 0;
+}
+
+void kern_jump(double f, const double *pf, double *err, size_t n, double miss)
+{
+    kern_best()->jump(f, pf, err, n, miss);
+}
+
+#ifdef LIBFORMANT_TEST
+// Check if x and y agree to within a relative tolerance of the given scale.
+static bool close_to(double x, double y, double scale) {
+    return fabs(x - y) <= 1e-9 * scale;
+}
+
+TEST test_kern_window() {
+    enum { N = 301 };
+    short din[N + 1];
+    double wind[N], want[N], got[N];
+    const kern_impl_t *const *k;
+    size_t n;
+
+    srand(4);
+
+    for (size_t i = 0; i <= N; i += 1)
+        din[i] = rand() % 65536 - 32768;
+
+    for (size_t i = 0; i < N; i += 1)
+        wind[i] = (double)rand() / RAND_MAX;
+
+    k = kern_impls(&n);
+
+    for (size_t m = 0; m < n; m += 1) {
+        for (size_t len = 0; len <= N; len += 37) {
+            window_scalar(din + 1, din, want, len, 0.7, wind);
+            k[m]->window(din + 1, din, got, len, 0.7, wind);
+
+            for (size_t i = 0; i < len; i += 1)
+                GREATEST_ASSERT_EQm(k[m]->name, want[i], got[i]);
+
+            k[m]->widen(din, got, len);
+
+            for (size_t i = 0; i < len; i += 1)
+                GREATEST_ASSERT_EQm(k[m]->name, din[i], got[i]);
+        }
+    }
+
+    PASS();
+}
+
+TEST test_kern_window_f() {
+    enum { N = 301 };
+    short din[N + 1];
+    float wind[N], want[N], got[N];
+    const kern_impl_t *const *k;
+    size_t n;
+
+    srand(4);
+
+    for (size_t i = 0; i <= N; i += 1)
+        din[i] = rand() % 65536 - 32768;
+
+    for (size_t i = 0; i < N; i += 1)
+        wind[i] = (float)rand() / RAND_MAX;
+
+    k = kern_impls(&n);
+
+    for (size_t m = 0; m < n; m += 1) {
+        for (size_t len = 0; len <= N; len += 37) {
+            window_f_scalar(din + 1, din, want, len, 0.7f, wind);
+            k[m]->window_f(din + 1, din, got, len, 0.7f, wind);
+
+            for (size_t i = 0; i < len; i += 1)
+                GREATEST_ASSERT_EQm(k[m]->name, want[i], got[i]);
+        }
+    }
+
+    PASS();
+}
+
+TEST test_kern_autoc() {
+    enum { N = 2048, P = 40 };
+    formant_workspace_t ws;
+    double *s, want[P + 1], got[P + 1];
+    float *sf;
+    const kern_impl_t *const *k;
+    size_t n;
+
+    s = malloc(sizeof(double) * N);
+    sf = malloc(sizeof(float) * N);
+    formant_workspace_init(&ws);
+    srand(5);
+
+    for (size_t i = 0; i < N; i += 1)
+        s[i] = rand() % 2000 - 1000;
+
+    k = kern_impls(&n);
+
+    for (size_t len = 1; len <= N; len = len * 3 + 1) {
+        for (size_t i = 0; i <= P; i += 1)
+            want[i] = i < len ? dot_scalar(s, s + i, len - i) : 0;
+
+        for (size_t m = 0; m < n; m += 1) {
+            for (size_t i = 0; i <= P; i += 1) {
+                got[i] = i < len ? k[m]->dot(s, s + i, len - i) : 0;
+                GREATEST_ASSERTm(k[m]->name, close_to(want[i], got[i], want[0]));
+            }
+        }
+
+        formant_workspace_reset(&ws);
+        autoc_fft(&ws, s, len, P, fft_size(len + P), got);
+
+        for (size_t i = 0; i <= P; i += 1)
+            GREATEST_ASSERTm("fft", close_to(want[i], got[i], want[0]));
+
+        formant_workspace_reset(&ws);
+        kern_autoc(&ws, s, len, P, got);
+
+        for (size_t i = 0; i <= P; i += 1)
+            GREATEST_ASSERTm("dispatch", close_to(want[i], got[i], want[0]));
+
+        // Single precision sums have about seven digits to work with.
+        for (size_t i = 0; i < len; i += 1)
+            sf[i] = s[i];
+
+        for (size_t m = 0; m < n; m += 1) {
+            for (size_t i = 0; i <= P; i += 1) {
+                got[i] = i < len ? k[m]->dot_f(sf, sf + i, len - i) : 0;
+                GREATEST_ASSERTm(k[m]->name,
+                                 fabs(want[i] - got[i]) <= 1e-5 * want[0]);
+            }
+        }
+
+        formant_workspace_reset(&ws);
+        kern_autoc_f(&ws, sf, len, P, got);
+
+        for (size_t i = 0; i <= P; i += 1)
+            GREATEST_ASSERTm("single", fabs(want[i] - got[i]) <= 1e-5 * want[0]);
+    }
+
+    formant_workspace_destroy(&ws);
+    free(s);
+    free(sf);
+
+    PASS();
+}
+
+TEST test_kern_autoc_lanes() {
+    enum { N = 101, P = 14 };
+    double seq[KERN_LANES][N], s[N * KERN_LANES], got[(P + 1) * KERN_LANES];
+    const kern_impl_t *const *k;
+    size_t n;
+
+    srand(6);
+
+    for (size_t j = 0; j < N; j += 1) {
+        for (size_t l = 0; l < KERN_LANES; l += 1)
+            seq[l][j] = s[j * KERN_LANES + l] = rand() % 2000 - 1000;
+    }
+
+    k = kern_impls(&n);
+
+    // Every lane sums its lags as the portable dot product does, including
+    // lags too long for the sequence and orders that don't fill a block.
+    for (size_t m = 0; m < n; m += 1) {
+        for (size_t len = 0; len <= N; len += len < P + 2 ? 1 : 17) {
+            for (size_t p = 0; p <= P; p += 1) {
+                k[m]->autoc_lanes(s, len, p, got);
+
+                for (size_t i = 0; i <= p; i += 1) {
+                    for (size_t l = 0; l < KERN_LANES; l += 1) {
+                        double want = i < len ?
+                            dot_scalar(seq[l], seq[l] + i, len - i) : 0;
+
+                        GREATEST_ASSERT_EQm(k[m]->name, want,
+                                            got[i * KERN_LANES + l]);
+                    }
+                }
+            }
+        }
+    }
+
+    PASS();
+}
+
+TEST test_kern_dot16() {
+    enum { N = 300 };
+    short x[N], y[N];
+    const kern_impl_t *const *k;
+    size_t n;
+
+    srand(7);
+
+    // Keep the sums in range of an int.
+    for (size_t i = 0; i < N; i += 1) {
+        x[i] = rand() % 65536 - 32768;
+        y[i] = rand() % 200 - 100;
+    }
+
+    k = kern_impls(&n);
+
+    for (size_t m = 0; m < n; m += 1) {
+        for (size_t len = 0; len <= N; len += 1) {
+            GREATEST_ASSERT_EQm(k[m]->name, dot16_scalar(x, y, len),
+                                k[m]->dot16(x, y, len));
+        }
+    }
+
+    PASS();
+}
+
+TEST test_kern_jump() {
+    enum { N = 77 };
+    double pf[N], want[N], got[N];
+    const kern_impl_t *const *k;
+    size_t n;
+
+    srand(8);
+
+    // Mix in missing formants, which are never positive.
+    for (size_t i = 0; i < N; i += 1)
+        pf[i] = rand() % 4 ? 50 + rand() % 5000 : 0;
+
+    k = kern_impls(&n);
+
+    for (size_t m = 0; m < n; m += 1) {
+        for (size_t len = 0; len <= N; len += 1) {
+            for (size_t i = 0; i < len; i += 1)
+                want[i] = got[i] = 0.25 * i;
+
+            jump_scalar(1234.5, pf, want, len, 1);
+            k[m]->jump(1234.5, pf, got, len, 1);
+
+            for (size_t i = 0; i < len; i += 1)
+                GREATEST_ASSERT_EQm(k[m]->name, want[i], got[i]);
+        }
+    }
+
+    PASS();
+}
+
+SUITE(kernels_suite) {
+    RUN_TEST(test_kern_window);
+    RUN_TEST(test_kern_window_f);
+    RUN_TEST(test_kern_autoc);
+    RUN_TEST(test_kern_autoc_lanes);
+    RUN_TEST(test_kern_dot16);
+    RUN_TEST(test_kern_jump);
+}
+#endif
@@ -0,0 +1,84 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+
+#include "workspace.h"
+
+// Number of sequences the lane kernels work on at once, one per vector lane.
+// Four doubles fill an AVX2 vector or a pair of SSE2 or NEON ones.
+enum { KERN_LANES = 4 };
+
+// An implementation of the inner loops of LPC analysis for one instruction set.
+typedef struct {
+    const char *name;
+
+    // Set dout[i] = wind[i] * (a[i] - preemp * b[i]) for the n points.
+    void (*window)(const short *a, const short *b, double *dout, size_t n,
+                   double preemp, const double *wind);
+
+    // Set dout[i] = x[i] for the n points.
+    void (*widen)(const short *x, double *dout, size_t n);
+
+    // Return the dot product of the n points at x and y.
+    double (*dot)(const double *x, const double *y, size_t n);
+
+    // Return the dot product of the n fixed-point samples at x and y. The
+    // caller must make sure the sum fits in an int.
+    int (*dot16)(const short *x, const short *y, size_t n);
+
+    // As window and dot, in single precision, which fits twice as many points
+    // in a vector.
+    void (*window_f)(const short *a, const short *b, float *dout, size_t n,
+                     float preemp, const float *wind);
+    float (*dot_f)(const float *x, const float *y, size_t n);
+
+    // Add to err[i] the cost of a formant moving from pf[i] to f for the n
+    // points: the square of the change relative to the mean of the two, or
+    // miss where pf[i] isn't positive because the formant is missing. f must
+    // be positive. Every implementation gives the same result to the bit.
+    void (*jump)(double f, const double *pf, double *err, size_t n,
+                 double miss);
+
+    // Compute the p + 1 raw autocorrelation lags of KERN_LANES sequences of n
+    // points at once. Point j of sequence l is at s[j * KERN_LANES + l], and
+    // its lag i is stored at r[i * KERN_LANES + l]. Each lag is summed in
+    // order of the points, so every implementation gives the same result to
+    // the bit.
+    void (*autoc_lanes)(const double *s, size_t n, size_t p, double *r);
+} kern_impl_t;
+
+// Get the implementations usable on this CPU, fastest last, and store their
+// number in n. The first is always the portable reference.
+const kern_impl_t *const *kern_impls(size_t *n);
+
+// Get the fastest implementation usable on this CPU.
+const kern_impl_t *kern_best(void);
+
+// Multiply the n samples at din, preemphasized by preemp, by the window wind
+// and store the result in dout. If preemp is nonzero, din must hold n + 1
+// samples.
+void kern_window(const short *din, double *dout, size_t n, double preemp,
+                 const double *wind);
+
+// Compute the p + 1 raw autocorrelation lags of the n points at s into r.
+// Large problems are solved by FFT, with scratch taken from the given
+// workspace.
+void kern_autoc(formant_workspace_t *ws, const double *s, size_t n, size_t p,
+                double *r);
+
+// As kern_window and kern_autoc, in single precision. The lags are returned as
+// doubles all the same.
+void kern_window_f(const short *din, float *dout, size_t n, float preemp,
+                   const float *wind);
+void kern_autoc_f(formant_workspace_t *ws, const float *s, size_t n, size_t p,
+                  double *r);
+
+// Add the costs of the n formant jumps from pf to f into err, as described
+// for kern_impl_t.
+void kern_jump(double f, const double *pf, double *err, size_t n, double miss);
+
+#endif
@@ -0,0 +1,297 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "kernels.h"
+#include "pitch.h"
+
+#ifdef LIBFORMANT_TEST
+#include <stdint.h>
+
+#include "greatest.h"
+#include "synth.h"
+#endif
+
+#define PI 3.14159265358979323846
+
+// Frames correlated less than this with themselves one period later are taken
+// to be unvoiced.
+static const double VOICING = 0.5;
+
+// The period is the shortest lag whose correlation is within this much of the
+// best, since multiples of the period correlate about as well.
+static const double OCTAVE = 0.9;
+
+// Cutoff in Hz of the lowpass the frame is put through first. Upper formants
+// shift the finely spaced peaks they make in the correlation from one period
+// to the next, so only the lowest harmonics are kept.
+static const double CUTOFF = 1000;
+// The lowpassed frame is first searched at no less than this many times the
+// cutoff.
+static const double DECIMATE = 4;
+// Peaks found in that search within this much of the best are measured again
+// at the full rate.
+static const double REFINE = 0.7;
+
+// Put the n points at x through a second-order Butterworth lowpass at the
+// given cutoff, in place.
+static void lowpass(double *x, size_t n, double rate, double cutoff) {
+    double k = tan(PI * cutoff / rate), q = 1 / (1 + sqrt(2) * k + k * k);
+    double b0 = k * k * q, a1 = 2 * (k * k - 1) * q;
+    double a2 = (1 - sqrt(2) * k + k * k) * q;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    for (size_t i = 0; i < n; i += 1) {
+        double y = b0 * (x[i] + 2 * x1 + x2) - a1 * y1 - a2 * y2;
+
+        x2 = x1;
+        x1 = x[i];
+        y2 = y1;
+        y1 = y;
+        x[i] = y;
+    }
+}
+
+// Fit a parabola through the three points at x = -1, 0, and 1 with the given
+// values and store the x and value of its peak in *dx and *y. The middle point
+// must be at least as high as the others.
+static void parabola(const double *v, double *dx, double *y) {
+    double curve = v[0] - 2 * v[1] + v[2];
+
+    *dx = curve < 0 ? (v[0] - v[2]) / (2 * curve) : 0;
+    *y = v[1] - curve * *dx * *dx / 2 + (v[2] - v[0]) * *dx / 2;
+}
+
+// Get the normalized cross-correlation of the n points at x with themselves
+// lag points later. e holds the running sums of the squares of the points, so
+// e[i] is the energy of the first i.
+static double nccf(const kern_impl_t *kern, const double *x, const double *e,
+                   size_t n, size_t lag)
+{
+    double den = e[n - lag] * (e[n] - e[lag]);
+
+    return den > 0 ? kern->dot(x, x + lag, n - lag) / sqrt(den) : 0;
+}
+
+// Find the peak of the correlation of the n points at x nearest the given
+// period, climbing from it to the highest lag around, and store the period and
+// correlation of the peak in *period and *y.
+static void refine(const kern_impl_t *kern, const double *x, const double *e,
+                   size_t n, double *period, double *y)
+{
+    size_t lag = (size_t)(*period + 0.5);
+    double v[3], dx;
+
+    if (lag < 2)
+        lag = 2;
+
+    if (lag > n / 2 - 1)
+        lag = n / 2 - 1;
+
+    for (size_t i = 0; i < 3; i += 1)
+        v[i] = nccf(kern, x, e, n, lag - 1 + i);
+
+    while (v[0] > v[1] && lag > 2) {
+        lag -= 1;
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = nccf(kern, x, e, n, lag - 1);
+    }
+
+    while (v[2] > v[1] && lag < n / 2 - 1) {
+        lag += 1;
+        v[0] = v[1];
+        v[1] = v[2];
+        v[2] = nccf(kern, x, e, n, lag + 1);
+    }
+
+    parabola(v, &dx, y);
+    *period = lag + dx;
+}
+
+void pitch_estimate(formant_workspace_t *ws, const short *x, size_t n,
+                    double rate, pitch_t *p)
+{
+    const kern_impl_t *kern = kern_best();
+    size_t step, m, lo, hi, n_peaks = 0;
+    double *d, *c, *e, *ec, *r, *periods, *ys, mean = 0, rmax = 0;
+
+    *p = (pitch_t) { .f0 = 0 };
+
+    if (!n)
+        return;
+
+    d = formant_workspace_alloc(ws, sizeof(double) * n);
+    e = formant_workspace_alloc(ws, sizeof(double) * (n + 1));
+
+    for (size_t i = 0; i < n; i += 1)
+        mean += x[i];
+
+    mean /= n;
+
+    for (size_t i = 0; i < n; i += 1)
+        d[i] = x[i] - mean;
+
+    p->rms = sqrt(kern->dot(d, d, n) / n);
+
+    if (p->rms == 0)
+        return;
+
+    if (rate > 2 * CUTOFF)
+        lowpass(d, n, rate, CUTOFF);
+
+    // Keep the running sums of the squares of the points, so e[i] is the
+    // energy of the first i.
+    e[0] = 0;
+
+    for (size_t i = 0; i < n; i += 1)
+        e[i + 1] = e[i] + d[i] * d[i];
+
+    // Nothing is left above the cutoff, so the lags are first searched at a
+    // few times its rate, and only the likely peaks at the full rate.
+    step = (size_t)(rate / (DECIMATE * CUTOFF));
+
+    if (step < 1)
+        step = 1;
+
+    m = n / step;
+    lo = (size_t)(rate / step / PITCH_F0_MAX);
+    hi = (size_t)ceil(rate / step / PITCH_F0_MIN);
+
+    if (lo < 1)
+        lo = 1;
+
+    if (hi > m / 2)
+        hi = m / 2;
+
+    if (hi < lo + 2 || n / 2 < 3)
+        return;
+
+    c = formant_workspace_alloc(ws, sizeof(double) * m);
+    ec = formant_workspace_alloc(ws, sizeof(double) * (m + 1));
+    r = formant_workspace_alloc(ws, sizeof(double) * (hi + 2));
+    periods = formant_workspace_alloc(ws, sizeof(double) * hi);
+    ys = formant_workspace_alloc(ws, sizeof(double) * hi);
+
+    ec[0] = 0;
+
+    for (size_t i = 0; i < m; i += 1) {
+        c[i] = d[i * step];
+        ec[i + 1] = ec[i] + c[i] * c[i];
+    }
+
+    // Take the raw lags as LPC analysis does, then normalize each by the
+    // energies of the two stretches of the frame it correlates.
+    kern_autoc(ws, c, m, hi + 1, r);
+
+    for (size_t lag = lo - 1; lag <= hi + 1; lag += 1) {
+        double den = ec[m - lag] * (ec[m] - ec[lag]);
+
+        r[lag] = den > 0 ? r[lag] / sqrt(den) : 0;
+    }
+
+    // Find the peaks, placing each between samples.
+    for (size_t lag = lo; lag <= hi; lag += 1) {
+        if (r[lag] >= r[lag - 1] && r[lag] >= r[lag + 1]) {
+            parabola(r + lag - 1, &periods[n_peaks], &ys[n_peaks]);
+            periods[n_peaks] += lag;
+
+            if (ys[n_peaks] > rmax)
+                rmax = ys[n_peaks];
+
+            n_peaks += 1;
+        }
+    }
+
+    // Too few points span each period of a high voice to place its peak well,
+    // so measure again at the full rate those that could be the best.
+    if (step > 1) {
+        double coarse = rmax;
+
+        rmax = 0;
+
+        for (size_t i = 0; i < n_peaks; i += 1) {
+            if (ys[i] < REFINE * coarse) {
+                ys[i] = 0;
+                continue;
+            }
+
+            periods[i] *= step;
+            refine(kern, d, e, n, &periods[i], &ys[i]);
+            periods[i] /= step;
+
+            if (ys[i] > rmax)
+                rmax = ys[i];
+        }
+    }
+
+    // The period is the shortest lag that correlates about as well as any,
+    // since its multiples do too.
+    for (size_t i = 0; i < n_peaks; i += 1) {
+        if (ys[i] >= OCTAVE * rmax) {
+            p->pv = ys[i] < 0 ? 0 : ys[i] > 1 ? 1 : ys[i];
+
+            if (p->pv >= VOICING)
+                p->f0 = rate / step / periods[i];
+
+            return;
+        }
+    }
+}
+
+#ifdef LIBFORMANT_TEST
+TEST test_pitch_estimate() {
+    enum { RATE = 10000, N = 490 };
+    static const double f0s[] = {70, 95, 130, 180, 240, 320, 450};
+    // A voice shaped by a single resonator at 700Hz.
+    static const double freq[] = {700}, band[] = {100};
+    formant_workspace_t ws;
+    short x[N];
+    uint32_t seed = 3;
+    pitch_t p;
+
+    formant_workspace_init(&ws);
+
+    for (size_t i = 0; i < sizeof(f0s) / sizeof(f0s[0]); i += 1) {
+        synth_voice(x, N, RATE, f0s[i], freq, band, 1, 1000);
+        pitch_estimate(&ws, x, N, RATE, &p);
+
+        GREATEST_ASSERT(fabs(p.f0 - f0s[i]) < f0s[i] * 0.02);
+        GREATEST_ASSERT(p.pv > 0.8);
+        GREATEST_ASSERT(p.rms > 0);
+    }
+
+    // Noise has no period.
+    for (size_t i = 0; i < N; i += 1) {
+        seed = seed * 1664525 + 1013904223;
+        x[i] = (int)(seed >> 16) - 32768;
+    }
+
+    pitch_estimate(&ws, x, N, RATE, &p);
+    GREATEST_ASSERT_EQ(p.f0, 0);
+    GREATEST_ASSERT(p.pv < VOICING);
+
+    // Neither has silence, or a frame too short for any period.
+    for (size_t i = 0; i < N; i += 1)
+        x[i] = 5;
+
+    pitch_estimate(&ws, x, N, RATE, &p);
+    GREATEST_ASSERT_EQ(p.f0, 0);
+    GREATEST_ASSERT_EQ(p.rms, 0);
+
+    synth_voice(x, N, RATE, 130, freq, band, 1, 1000);
+    pitch_estimate(&ws, x, 20, RATE, &p);
+    GREATEST_ASSERT_EQ(p.f0, 0);
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+SUITE(pitch_suite) {
+    RUN_TEST(test_pitch_estimate);
+}
+#endif
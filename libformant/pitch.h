@@ -0,0 +1,34 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef PITCH_H
+#define PITCH_H
+
+#include <stddef.h>
+
+#include "workspace.h"
+
+// Range of F0 looked for, in Hz.
+enum { PITCH_F0_MIN = 60, PITCH_F0_MAX = 500 };
+
+// The fundamental frequency of one frame of speech.
+typedef struct {
+    // F0 in Hz, or 0 if the frame doesn't look periodic.
+    double f0;
+    // Normalized cross-correlation of the frame with itself one period later,
+    // from 0 to 1, taken as the probability that the frame is voiced.
+    double pv;
+    // RMS amplitude of the frame, less its mean.
+    double rms;
+} pitch_t;
+
+// Estimate the F0 of the n samples at x, taken at the given sample rate, and
+// store it in p. Scratch is taken from the given workspace. Periods longer
+// than half the frame can't be found, so short frames raise the lowest F0.
+//
+// Each frame stands on its own, so frames may be estimated in any order, or
+// as they arrive in a stream.
+void pitch_estimate(formant_workspace_t *ws, const short *x, size_t n,
+                    double rate, pitch_t *p);
+
+#endif
@@ -10,8 +10,16 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "cache.h"
+#include "kernels.h"
 #include "processing.h"
 
+#ifdef LIBFORMANT_TEST
+#include <stdlib.h>
+
+#include "greatest.h"
+#endif
+
 /*	routine to solve ax=y with cholesky
     a - nxn matrix
     x,y -vectors
@@ -142,29 +150,30 @@ static int dcovlpc(double *p, double *s, double *a, int *n, double *c) {
 
 /* cov mat for wtd lpc	*/
 static void dcwmtrx(double *s, int *ni, int *nl, int *np, double *phi,
-                    double *shi, double *ps, double *w)
+                    double *shi, double *ps, const double *w)
 {
     double *pdl1,*pdl2,*pdl3,*pdl4,*pdl5,*pdl6,*pdll;
+    const double *pw;
     double sm;
     int i,j;
     *ps = 0;
-    for(pdl1=s+*ni,pdl2=w,pdll=s+*nl;pdl1<pdll;pdl1++,pdl2++)
-        *ps += *pdl1 * *pdl1 * *pdl2;
+    for(pdl1=s+*ni,pw=w,pdll=s+*nl;pdl1<pdll;pdl1++,pw++)
+        *ps += *pdl1 * *pdl1 * *pw;
 
     for(pdl3=shi,pdl4=shi+*np,pdl5=s+*ni;pdl3<pdl4;pdl3++,pdl5--){
         *pdl3 = 0.;
-        for(pdl1=s+*ni,pdl2=w,pdll=s+*nl,pdl6=pdl5-1;
-                pdl1<pdll;pdl1++,pdl2++,pdl6++)
-            *pdl3 += *pdl1 * *pdl6 * *pdl2;
+        for(pdl1=s+*ni,pw=w,pdll=s+*nl,pdl6=pdl5-1;
+                pdl1<pdll;pdl1++,pw++,pdl6++)
+            *pdl3 += *pdl1 * *pdl6 * *pw;
 
     }
 
     for(i=0;i<*np;i++)
         for(j=0;j<=i;j++){
             sm = 0.;
-            for(pdl1=s+*ni-i-1,pdl2=s+*ni-j-1,pdl3=w,pdll=s+*nl-i-1;
+            for(pdl1=s+*ni-i-1,pdl2=s+*ni-j-1,pw=w,pdll=s+*nl-i-1;
                     pdl1<pdll;)
-                sm += *pdl1++ * *pdl2++ * *pdl3++;
+                sm += *pdl1++ * *pdl2++ * *pw++;
 
             *(phi + *np * i + j) = sm;
             *(phi + *np * j + i) = sm;
@@ -181,7 +190,7 @@ static void dcwmtrx(double *s, int *ni, int *nl, int *np, double *phi,
     shi - cov vect
     */
 int dlpcwtd(double *s, int *ls, double *p, int *np, double *c, double *phi,
-            double *shi, double *xl, double *w)
+            double *shi, double *xl, const double *w)
 {
     double *pp2,*ppl2,*pc2,*pcl,*pph1,*pph2,*pph3,*pphl;
     int m,np1,mm;
@@ -254,6 +263,32 @@ int dlpcwtd(double *s, int *ls, double *p, int *np, double *c, double *phi,
 
 #define MAXORDER	60	/* maximum permissible LPC order */
 
+/* Inline a function even where it isn't worth it on its own, as when the
+   caller passes constants that simplify it. */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+/* Unroll the loop that follows completely where its trip count is known at
+   compile time, up to the highest of LPC_ORDERS. */
+#if defined(__clang__) || __GNUC__ >= 8
+#define UNROLL_ORDER _Pragma("GCC unroll 18")
+#else
+#define UNROLL_ORDER
+#endif
+
+/* The steps of LPC analysis whose loops all run over the order, for one
+   order or any. */
+typedef struct {
+    void (*durbin)(const double *r, double *k, double *a, int p, double *ex);
+    int (*lbpoly)(formant_workspace_t *ws, double *a, int order,
+                  double *rootr, double *rooti, bool warm);
+} order_kern_t;
+
+static const order_kern_t *order_kern(int p);
+
 #ifndef M_PI
 #define M_PI    3.14159265358979323846
 #endif
@@ -272,112 +307,118 @@ static void rwindow(short *din, double *dout, int n, double preemp) {
     }
 }
 
-static void cwindow(short *din, double *dout, int n, double preemp) {
+/* Build a cos**4 window of n points. */
+static void cwindow(void *data, int type, int n) {
+    double *q = data;
+    double arg, half=0.5, co;
     int i;
-    short *p;
-    int wsize = 0;
-    double *wind=NULL;
-    double *q, co;
 
-    if(wsize != n) {		/* Need to create a new cos**4 window? */
-        double arg, half=0.5;
+    (void)type;
 
-        if(wind) wind = realloc((void *)wind,n*sizeof(double));
-        else wind = malloc(n*sizeof(double));
-        wsize = n;
-        for(i=0, arg=3.1415927*2.0/(wsize), q=wind; i < n; ) {
-            co = half*(1.0 - cos((half + (double)i++) * arg));
-            *q++ = co * co * co * co;
-        }
-    }
-    /* If preemphasis is to be performed,  this assumes that there are n+1 valid
-       samples in the input buffer (din). */
-    if(preemp != 0.0) {
-        for(i=n, p=din+1, q=wind; i-- > 0; )
-            *dout++ = *q++ * ((double)(*p++) - (preemp * *din++));
-    } else {
-        for(i=n, q=wind; i-- > 0; )
-            *dout++ = *q++ * *din++;
+    for(i=0, arg=3.1415927*2.0/(n); i < n; ) {
+        co = half*(1.0 - cos((half + (double)i++) * arg));
+        *q++ = co * co * co * co;
     }
 }
 
-static void hwindow(short *din, double *dout, int n, double preemp) {
+/* Build a Hamming window of n points. */
+static void hwindow(void *data, int type, int n) {
+    double *q = data;
+    double arg, half=0.5;
     int i;
-    short *p;
-    int wsize = 0;
-    double *wind=NULL;
-    double *q;
 
-    if(wsize != n) {		/* Need to create a new Hamming window? */
-        double arg, half=0.5;
+    (void)type;
 
-        if(wind) wind = realloc((void *)wind,n*sizeof(double));
-        else wind = malloc(n*sizeof(double));
-        wsize = n;
-        for(i=0, arg=3.1415927*2.0/(wsize), q=wind; i < n; )
-            *q++ = (.54 - .46 * cos((half + (double)i++) * arg));
-    }
-    /* If preemphasis is to be performed,  this assumes that there are n+1 valid
-       samples in the input buffer (din). */
-    if(preemp != 0.0) {
-        for(i=n, p=din+1, q=wind; i-- > 0; )
-            *dout++ = *q++ * ((double)(*p++) - (preemp * *din++));
-    } else {
-        for(i=n, q=wind; i-- > 0; )
-            *dout++ = *q++ * *din++;
-    }
+    for(i=0, arg=3.1415927*2.0/(n); i < n; )
+        *q++ = (.54 - .46 * cos((half + (double)i++) * arg));
 }
 
-static void hnwindow(short *din, double *dout, int n, double preemp) {
+/* Build a Hanning window of n points. */
+static void hnwindow(void *data, int type, int n) {
+    double *q = data;
+    double arg, half=0.5;
     int i;
-    short *p;
-    int wsize = 0;
-    double *wind=NULL;
-    double *q;
 
-    if(wsize != n) {		/* Need to create a new Hamming window? */
-        double arg, half=0.5;
+    (void)type;
 
-        if(wind) wind = realloc((void *)wind,n*sizeof(double));
-        else wind = malloc(n*sizeof(double));
-        wsize = n;
-        for(i=0, arg=3.1415927*2.0/(wsize), q=wind; i < n; )
-            *q++ = (half - half * cos((half + (double)i++) * arg));
-    }
-    /* If preemphasis is to be performed,  this assumes that there are n+1 valid
-       samples in the input buffer (din). */
-    if(preemp != 0.0) {
-        for(i=n, p=din+1, q=wind; i-- > 0; )
-            *dout++ = *q++ * ((double)(*p++) - (preemp * *din++));
-    } else {
-        for(i=n, q=wind; i-- > 0; )
-            *dout++ = *q++ * *din++;
-    }
+    for(i=0, arg=3.1415927*2.0/(n); i < n; )
+        *q++ = (half - half * cos((half + (double)i++) * arg));
 }
 
-static void w_window(short *din, double *dout, int n, double preemp,
-                     window_type_t type)
-{
-    switch (type) {
-    case WINDOW_TYPE_RECTANGULAR:
-        rwindow(din, dout, n, preemp);
-    break;
+/* Get the n point window of the given (non-rectangular) type.  Windows are
+   built once per type and size and shared from then on. */
+static const double *window_get(window_type_t type, int n) {
+    cache_build_t build = NULL;
 
+    switch (type) {
     case WINDOW_TYPE_HAMMING:
-        hwindow(din, dout, n, preemp);
+        build = hwindow;
     break;
 
     case WINDOW_TYPE_COS:
-        cwindow(din, dout, n, preemp);
+        build = cwindow;
     break;
 
     case WINDOW_TYPE_HANNING:
-        hnwindow(din, dout, n, preemp);
+        build = hnwindow;
     break;
 
+    case WINDOW_TYPE_RECTANGULAR:
     case WINDOW_TYPE_INVALID:
     break;
     }
+
+    return cache_get(CACHE_WINDOW, type, n, n * sizeof(double), build);
+}
+
+/* Build a single precision copy of the n point window of the given type. */
+static void fwindow(void *data, int type, int n) {
+    const double *w = window_get(type, n);
+    float *q = data;
+
+    for (int i = 0; i < n; i++)
+        q[i] = w[i];
+}
+
+static void w_window(short *din, double *dout, int n, double preemp,
+                     window_type_t type)
+{
+    switch (type) {
+    case WINDOW_TYPE_RECTANGULAR:
+        rwindow(din, dout, n, preemp);
+    return;
+
+    case WINDOW_TYPE_INVALID:
+    return;
+
+    default:
+        kern_window(din, dout, n, preemp, window_get(type, n));
+    }
+}
+
+/* As w_window, in single precision. */
+static void w_window_f(short *din, float *dout, int n, float preemp,
+                       window_type_t type)
+{
+    switch (type) {
+    case WINDOW_TYPE_RECTANGULAR:
+        if (preemp != 0.0f) {
+            for (int i = 0; i < n; i++)
+                dout[i] = (float)din[i + 1] - preemp * din[i];
+        } else {
+            for (int i = 0; i < n; i++)
+                dout[i] = din[i];
+        }
+    return;
+
+    case WINDOW_TYPE_INVALID:
+    return;
+
+    default:
+        kern_window_f(din, dout, n, preemp,
+                      cache_get(CACHE_WINDOW_FLOAT, type, n, n * sizeof(float),
+                                fwindow));
+    }
 }
 
 /*
@@ -385,13 +426,11 @@ static void w_window(short *din, double *dout, int n, double preemp,
  * Return the normalized autocorrelation coefficients in r.
  * The rms is returned in e.
  */
-static void autoc(size_t windowsize, double *s, size_t p, double *r, double *e) {
-    size_t i, j;
-    double *q, *t, sum, sum0;
+static void autoc_norm(size_t windowsize, size_t p, double *r, double *e) {
+    size_t i;
+    double sum0;
 
-    for ( i=0, q=s, sum0=0.; i< windowsize; q++, i++){
-        sum0 += (*q) * (*q);
-    }
+    sum0 = r[0];
     *r = 1.;  /* r[0] will always =1. */
     if ( sum0 == 0.){   /* No energy: fake low-energy white noise. */
         *e = 1.;   /* Arbitrarily assign 1 to rms. */
@@ -401,21 +440,34 @@ static void autoc(size_t windowsize, double *s, size_t p, double *r, double *e)
         }
         return;
     }
-    for( i=1; i <= p; i++){
-        for( sum=0., j=0, q=s, t=s+i; j+i < windowsize; j++, q++, t++){
-            sum += (*q) * (*t);
-        }
-        *(++r) = sum/sum0;
-    }
+    for( i=1; i <= p; i++)
+        r[i] /= sum0;
     *e = sqrt(sum0/windowsize);
 }
 
+static void autoc(formant_workspace_t *ws, size_t windowsize, double *s,
+                  size_t p, double *r, double *e)
+{
+    kern_autoc(ws, s, windowsize, p, r);
+    autoc_norm(windowsize, p, r, e);
+}
+
+/* As autoc, for single precision samples. */
+static void autoc_f(formant_workspace_t *ws, size_t windowsize, float *s,
+                    size_t p, double *r, double *e)
+{
+    kern_autoc_f(ws, s, windowsize, p, r);
+    autoc_norm(windowsize, p, r, e);
+}
+
 /*
  * Compute the AR and PARCOR coefficients using Durbin's recursion.
  * Note: Durbin returns the coefficients in normal sign format.
  *	(i.e. a[0] is assumed to be = +1.)
  */
-static void durbin (double *r, double *k, double *a, int p, double *ex) {
+static ALWAYS_INLINE void durbin(const double *r, double *k, double *a, int p,
+                                 double *ex)
+{
     double b[MAXORDER];
     int i, j;
     double e, s;
@@ -424,16 +476,20 @@ static void durbin (double *r, double *k, double *a, int p, double *ex) {
     *k = -r[1]/e;
     *a = *k;
     e *= (1. - (*k) * (*k));
+    UNROLL_ORDER
     for ( i=1; i < p; i++){
         s = 0;
+        UNROLL_ORDER
         for ( j=0; j<i; j++){
             s -= a[j] * r[i-j];
         }
         k[i] = ( s - r[i+1] )/e;
         a[i] = k[i];
+        UNROLL_ORDER
         for ( j=0; j<=i; j++){
             b[j] = a[j];
         }
+        UNROLL_ORDER
         for ( j=0; j<i; j++){
             a[j] += k[i] * b[i-j-1];
         }
@@ -442,21 +498,27 @@ static void durbin (double *r, double *k, double *a, int p, double *ex) {
     *ex = e;
 }
 
-void lpc(size_t lpc_ord, double lpc_stabl, size_t wsize, short *data, double *lpca,
-         double *ar, double *lpck, double *normerr, double *rms, double preemp,
-         window_type_t type)
+void lpc(formant_workspace_t *ws, size_t lpc_ord, double lpc_stabl, size_t wsize,
+         short *data, double *lpca, double *ar, double *lpck, double *normerr,
+         double *rms, double preemp, window_type_t type, precision_t precision)
 {
-    double *dwind;
     double rho[MAXORDER+1], k[MAXORDER], a[MAXORDER+1],*r,*kp,*ap,en,er;
     double wfact = 1.0;
 
-    dwind = malloc(wsize*sizeof(double));
-
-    w_window(data, dwind, wsize, preemp, type);
     if(!(r = ar)) r = rho;
     if(!(kp = lpck)) kp = k;
     if(!(ap = lpca)) ap = a;
-    autoc( wsize, dwind, lpc_ord, r, &en );
+    if(precision == PRECISION_FLOAT) {
+        float *fwind = formant_workspace_alloc(ws, wsize*sizeof(float));
+
+        w_window_f(data, fwind, wsize, preemp, type);
+        autoc_f( ws, wsize, fwind, lpc_ord, r, &en );
+    } else {
+        double *dwind = formant_workspace_alloc(ws, wsize*sizeof(double));
+
+        w_window(data, dwind, wsize, preemp, type);
+        autoc( ws, wsize, dwind, lpc_ord, r, &en );
+    }
     if(lpc_stabl > 1.0) { /* add a little to the diagonal for stability */
         size_t i;
         double ffact;
@@ -467,47 +529,198 @@ void lpc(size_t lpc_ord, double lpc_stabl, size_t wsize, short *data, double *lp
         if(ar)
             for(i=0;i<=lpc_ord; i++) ar[i] = r[i]; /* copy out for possible use later */
     }
-    durbin ( r, kp, &ap[1], lpc_ord, &er);
+    order_kern(lpc_ord)->durbin ( r, kp, &ap[1], lpc_ord, &er);
 
     *ap = 1.0;
     if(rms) *rms = en/wfact;
     if(normerr) *normerr = er;
+}
+
+/* As durbin, for KERN_LANES sets of lags at once, interleaved as
+   kern_impl_t.autoc_lanes leaves them, with the coefficients interleaved the
+   same way in a. Each lane gets the same result as durbin would. */
+static void durbin_lanes(const double *r, double *a, int p, double *ex)
+{
+    enum { L = KERN_LANES };
 
-    free(dwind);
+    double b[MAXORDER*L], e[L], k[L], s[L];
+    int i, j, l;
+
+    for (l = 0; l < L; l++) {
+        e[l] = r[l];
+        a[l] = -r[L+l]/e[l];
+        e[l] *= (1. - a[l] * a[l]);
+    }
+    for ( i=1; i < p; i++){
+        for (l = 0; l < L; l++) s[l] = 0;
+        for ( j=0; j<i; j++)
+            for (l = 0; l < L; l++)
+                s[l] -= a[j*L+l] * r[(i-j)*L+l];
+        for (l = 0; l < L; l++) {
+            k[l] = ( s[l] - r[(i+1)*L+l] )/e[l];
+            a[i*L+l] = k[l];
+        }
+        for ( j=0; j<=i; j++)
+            for (l = 0; l < L; l++)
+                b[j*L+l] = a[j*L+l];
+        for ( j=0; j<i; j++)
+            for (l = 0; l < L; l++)
+                a[j*L+l] += k[l] * b[(i-j-1)*L+l];
+        for (l = 0; l < L; l++)
+            e[l] *= ( 1. - (k[l] * k[l]) );
+    }
+    for (l = 0; l < L; l++) ex[l] = e[l];
 }
 
-/* covariance LPC analysis; originally from Markel and Gray */
-/* (a translation from the fortran) */
-int w_covar(short *xx, int *m, int n, int istrt, double *y, double *alpha,
-            double *r0, double preemp, window_type_t w_type)
+/*
+ * As lpc in double precision, for the n frames at data[0] to data[n-1],
+ * which would usually be the same frame of as many streams.  The frames are
+ * windowed and their autocorrelations and AR coefficients worked out
+ * KERN_LANES at a time, one frame per vector lane, so a frame may differ from
+ * what lpc finds for it in the last bits.  The coefficients of frame i are
+ * returned in lpca[i] and its rms in rms[i].
+ */
+void lpc_lanes(formant_workspace_t *ws, size_t lpc_ord, double lpc_stabl,
+               size_t wsize, size_t n, short *const *data, double *const *lpca,
+               double *rms, double preemp, window_type_t type)
 {
-    double *x=NULL;
-    int nold = 0;
-    int mold = 0;
-    double *b = NULL, *beta = NULL, *grc = NULL, *cc = NULL, gam,s;
-    int ibeg, ibeg1, ibeg2, ibegmp, np0, ibegm1, msq, np, np1, mf, jp, ip,
-        mp, i, j, minc, n1, n2, n3, npb, msub, mm1, isub, m2;
-    int mnew = 0;
+    enum { L = KERN_LANES };
+
+    const kern_impl_t *kern = kern_best();
+    const double *w = NULL;
+    double *s = formant_workspace_alloc(ws, wsize*L*sizeof(double));
+    double r[(MAXORDER+1)*L], a[MAXORDER*L], en[L], er[L], ffact = 1.0;
+    size_t first, m, i, j, l;
+
+    if(type != WINDOW_TYPE_RECTANGULAR) w = window_get(type, wsize);
+    if(lpc_stabl > 1.0) /* add a little to the diagonal for stability */
+        ffact =1.0/(1.0 + exp((-lpc_stabl/20.0) * log(10.0)));
+
+    for(first=0; first < n; first += L) {
+        m = n - first < L ? n - first : L;
+
+        /* Interleave the windowed frames, leaving silence in the lanes
+           without one. */
+        for(l=0; l < L; l++) {
+            const short *b, *d;
+            double *o = s + l;
+
+            if(l >= m) {
+                for(j=0; j < wsize; j++) o[j*L] = 0.0;
+                continue;
+            }
+            b = data[first+l];
+            d = preemp != 0.0 ? b + 1 : b;
+            if(w)
+                for(j=0; j < wsize; j++)
+                    o[j*L] = w[j] * ((double)d[j] - preemp * b[j]);
+            else
+                for(j=0; j < wsize; j++)
+                    o[j*L] = (double)d[j] - preemp * b[j];
+        }
+
+        kern->autoc_lanes(s, wsize, lpc_ord, r);
+
+        /* Normalize each lane as autoc_norm does. */
+        for(l=0; l < m; l++) {
+            double sum0 = r[l];
+
+            r[l] = 1.;
+            if(sum0 == 0.) {
+                en[l] = 1.;
+                for(i=1; i <= lpc_ord; i++) r[i*L+l] = 0.;
+            } else {
+                for(i=1; i <= lpc_ord; i++) r[i*L+l] /= sum0;
+                en[l] = sqrt(sum0/wsize);
+            }
+        }
+        for(l=m; l < L; l++) {
+            r[l] = 1.;
+            for(i=1; i <= lpc_ord; i++) r[i*L+l] = 0.;
+        }
+
+        if(lpc_stabl > 1.0)
+            for(i=L; i < (lpc_ord+1)*L; i++) r[i] = ffact * r[i];
 
-    if((n+1) > nold) {
-        if(x) free((void *)x);
-        x = NULL;
-        x = malloc((n+1)*sizeof(double));
-        memset(x, 0, (n+1) * sizeof(double));
-        nold = n+1;
+        durbin_lanes(r, a, lpc_ord, er);
+
+        for(l=0; l < m; l++) {
+            lpca[first+l][0] = 1.0;
+            for(i=0; i < lpc_ord; i++) lpca[first+l][i+1] = a[i*L+l];
+            rms[first+l] = en[l];
+        }
     }
+}
+
+/*
+ * Compute the AR coefficients by Burg's method, which fits each reflection
+ * coefficient to the forward and backward prediction errors of the windowed
+ * samples themselves, rather than to an estimate of their autocorrelation.
+ * It assumes nothing about the samples outside the window, so short windows
+ * of only a few pitch periods still give stable estimates.
+ * The coefficients are returned in lpca, in the sign format of durbin, and
+ * the rms of the windowed samples in rms.
+ */
+void lpc_burg(formant_workspace_t *ws, size_t lpc_ord, size_t wsize,
+              short *data, double *lpca, double *rms, double preemp,
+              window_type_t type)
+{
+    const kern_impl_t *kern = kern_best();
+    double *f = formant_workspace_alloc(ws, wsize*sizeof(double));
+    double *b = formant_workspace_alloc(ws, wsize*sizeof(double));
+    double tmp[MAXORDER+1], e;
+    size_t i, j, m;
+
+    w_window(data, f, wsize, preemp, type);
+    memcpy(b, f, wsize*sizeof(double));
+
+    lpca[0] = 1.0;
+    for(i=1; i <= lpc_ord; i++) lpca[i] = 0.0;
+
+    e = kern->dot(f, f, wsize);
+    *rms = sqrt(e/wsize);
+    if(e == 0.0) /* No energy: leave the predictor flat, as autoc does. */
+        return;
+
+    for(m=0; m < lpc_ord && m+1 < wsize; m++) {
+        const double *fm = f + m + 1, *bm = b + m;
+        size_t n = wsize - m - 1;
+        double num = kern->dot(fm, bm, n);
+        double den = kern->dot(fm, fm, n) + kern->dot(bm, bm, n);
+        double k = den > 0.0 ? -2.0 * num / den : 0.0;
 
-    if(*m > mold) {
-        if(b) free((void *)b); if(beta) free((void *)beta); if (grc) free((void *)grc); if (cc) free((void *)cc);
-        mnew = *m;
+        for(j=1; j <= m; j++) tmp[j] = lpca[j] + k * lpca[m+1-j];
+        for(j=1; j <= m; j++) lpca[j] = tmp[j];
+        lpca[m+1] = k;
 
-        b = malloc(sizeof(double)*((mnew+1)*(mnew+1)/2));
-        beta = malloc(sizeof(double)*(mnew+3));
-        grc = malloc(sizeof(double)*(mnew+3));
-        cc = malloc(sizeof(double)*(mnew+3));
+        /* Work back from the end, so every backward error is read before it's
+           overwritten. */
+        for(i=wsize-1; i > m; i--) {
+            double fi = f[i];
 
-        mold = mnew;
+            f[i] = fi + k * b[i-1];
+            b[i] = b[i-1] + k * fi;
+        }
     }
+}
+
+/* covariance LPC analysis; originally from Markel and Gray */
+/* (a translation from the fortran) */
+int w_covar(formant_workspace_t *ws, short *xx, int *m, int n, int istrt,
+            double *y, double *alpha, double *r0, double preemp,
+            window_type_t w_type)
+{
+    double *x, *b, *beta, *grc, *cc, gam,s;
+    int ibeg, ibeg1, ibeg2, ibegmp, np0, ibegm1, msq, np, np1, mf, jp, ip,
+        mp, i, j, minc, n1, n2, n3, npb, msub, mm1, isub, m2;
+
+    x = formant_workspace_alloc(ws, (n+1)*sizeof(double));
+    memset(x, 0, (n+1) * sizeof(double));
+
+    b = formant_workspace_alloc(ws, sizeof(double)*((*m+1)*(*m+1)/2));
+    beta = formant_workspace_alloc(ws, sizeof(double)*(*m+3));
+    grc = formant_workspace_alloc(ws, sizeof(double)*(*m+3));
+    cc = formant_workspace_alloc(ws, sizeof(double)*(*m+3));
 
     w_window(xx, x, n, preemp, w_type);
 
@@ -603,6 +816,10 @@ int w_covar(short *xx, int *m, int n, int istrt, double *y, double *alpha,
 #define MAX_ITS	100	/* Max iterations before trying new starts */
 #define MAX_TRYS	100	/* Max number of times to try new starts */
 #define MAX_ERR		1.e-6	/* Max acceptable error in quad factor */
+#define POLISH_ITS	8	/* Max iterations polishing an old quad factor */
+/* Max iterations over all the factors of a polynomial of order n, well above
+   any seen in speech, which bounds the time spent on any one frame */
+#define MAX_BUDGET(n)	(2 * MAX_ITS * (n))
 
 /* find x, where a*x**2 + b*x + c = 0   */
 /* return real and imag. parts of roots */
@@ -653,18 +870,134 @@ static int qquad(double a, double b, double c, double *r1r, double *r1i,
     }
 }
 
+/* Take one Lin-Bairstow step toward the quadratic factor x**2 + p*x + q of
+   the polynomial a of order ord, leaving the quotient in b[2..ord] and the
+   remainder in b[0..1].  Return 1 if the factor is already within MAX_ERR,
+   in which case p and q are left alone, -1 if the step would overflow, and 0
+   otherwise. */
+static ALWAYS_INLINE int bairstow(const double *a, int ord, double *p,
+                                  double *q, double *b, double *c, double lim0)
+{
+    int	    ordm1 = ord-1, k, mmk, mmkp2, mmkp1;
+    double  err, delp, delq, den;
+    double  lim = lim0 / (1 + fabs(*p) + fabs(*q));
+
+    b[ord] = a[ord];
+    b[ordm1] = a[ordm1] - (*p * b[ord]);
+    c[ord] = b[ord];
+    c[ordm1] = b[ordm1] - (*p * c[ord]);
+    UNROLL_ORDER
+    for(k = 2; k <= ordm1; k++){
+        mmk = ord - k;
+        mmkp2 = mmk+2;
+        mmkp1 = mmk+1;
+        b[mmk] = a[mmk] - (*p* b[mmkp1]) - (*q* b[mmkp2]);
+        c[mmk] = b[mmk] - (*p* c[mmkp1]) - (*q* c[mmkp2]);
+        if (b[mmk] > lim || c[mmk] > lim)
+            break;
+    }
+    if (k > ordm1) { /* normal exit from for(k ... */
+        /* ????	b[0] = a[0] - q * b[2];	*/
+        b[0] = a[0] - *p * b[1] - *q * b[2];
+        if (b[0] <= lim) k++;
+    }
+    if (k <= ord)	/* Some coefficient exceeded lim; */
+        return(-1);	/* potential overflow below. */
+
+    err = fabs(b[0]) + fabs(b[1]);
+
+    if(err <= MAX_ERR)
+        return(1);
+
+    den = (c[2] * c[2]) - (c[3] * (c[1] - b[1]));
+    if(den == 0.0)
+        return(-1);
+
+    delp = ((c[2] * b[1]) - (c[3] * b[0]))/den;
+    delq = ((c[2] * b[0]) - (b[1] * (c[1] - b[1])))/den;
+
+    *p += delp;
+    *q += delq;
+
+    return(0);
+}
+
+/* Polish the quadratic factors of the last polynomial, as given by the root
+   pairs in rootr and rooti, on the polynomial a of even order, from the top
+   down.  A factor is only taken if dividing it out of what's left of a leaves
+   a remainder within MAX_ERR, as for the full search, so no two old factors
+   can settle on the same new one.  The roots of every factor taken are stored
+   over the old ones and a is reduced by it, as in lbpoly().  Return the order
+   of what's left of a, which is 2 once every factor but the last is taken.
+   The iterations taken are subtracted from *budget. */
+static ALWAYS_INLINE int lbpoly_polish(formant_workspace_t *ws, double *a,
+                                       int order, double *rootr,
+                                       double *rooti, int *budget)
+{
+    int	    i, itcnt, ord;
+    double  p, q, b[MAXORDER], c[MAXORDER];
+    double  lim0 = 0.5*sqrt(DBL_MAX);
+
+    (void) ws;			/* only kept for the stats */
+
+    for(ord = order; ord > 2; ord -= 2){
+        int	found = false;
+
+        /* the factor with both old roots, real or complex */
+        p = -(rootr[ord-1] + rootr[ord-2]);
+        q = (rootr[ord-1] * rootr[ord-2]) - (rooti[ord-1] * rooti[ord-2]);
+
+        for(itcnt = 0; itcnt < POLISH_ITS; itcnt++){
+            int	r = bairstow(a, ord, &p, &q, b, c, lim0);
+
+            if (r != 0) {
+                found = r > 0;
+                break;
+            }
+        }
+
+        itcnt = itcnt < POLISH_ITS ? itcnt + 1 : itcnt;
+        STATS_ADD(ws, iterations, itcnt);
+        *budget -= itcnt;
+
+        if (!found ||
+            !qquad(1.0, p, q, &rootr[ord-1], &rooti[ord-1],
+                   &rootr[ord-2], &rooti[ord-2]))
+        {
+            return(ord);
+        }
+
+        UNROLL_ORDER
+        for(i = 0; i <= ord - 2; i++) a[i] = b[i+2];
+    }
+
+    STATS_ADD(ws, polished, 1);
+
+    return(ord);
+}
+
 /* return false on error */
 /* a: coeffs. of the polynomial (increasing order) */
 /* order: the order of the polynomial */
 /* rootr, rooti: the real and imag. roots of the polynomial */
+/* warm: true if rootr and rooti hold the roots of a similar polynomial */
 /* Rootr and rooti are assumed to contain starting points for the root
    search on entry to lbpoly(). */
-static int lbpoly(double *a, int order, double *rootr, double *rooti) {
-    int	    ord, ordm1, ordm2, itcnt, i, k, mmk, mmkp2, mmkp1, ntrys;
-    double  err, p, q, delp, delq, b[MAXORDER], c[MAXORDER], den;
+static ALWAYS_INLINE int lbpoly(formant_workspace_t *ws, double *a, int order,
+                                double *rootr, double *rooti, bool warm)
+{
+    int	    ord, ordm1, ordm2, itcnt, i, ntrys, found;
+    /* b is zeroed for when every try overflows and it's reduced unfinished */
+    double  p, q, b[MAXORDER] = {0}, c[MAXORDER];
     double  lim0 = 0.5*sqrt(DBL_MAX);
+    int	    budget = MAX_BUDGET(order);
 
-    for(ord = order; ord > 2; ord -= 2){
+    /* Only search for the factors that couldn't be polished. */
+    ord = warm && order % 2 == 0 ?
+        lbpoly_polish(ws, a, order, rootr, rooti, &budget) : order;
+
+    UNROLL_ORDER
+    for(; ord > 2; ord -= 2){
         ordm1 = ord-1;
         ordm2 = ord-2;
         /* Here is a kluge to prevent UNDERFLOW! (Sometimes the near-zero
@@ -673,59 +1006,30 @@ static int lbpoly(double *a, int order, double *rootr, double *rooti) {
         if(fabs(rooti[ordm1]) < 1.0e-10) rooti[ordm1] = 0.0;
         p = -2.0 * rootr[ordm1]; /* set initial guesses for quad factor */
         q = (rootr[ordm1] * rootr[ordm1]) + (rooti[ordm1] * rooti[ordm1]);
-        for(ntrys = 0; ntrys < MAX_TRYS; ntrys++)
+        for(ntrys = 0, found = false; ntrys < MAX_TRYS; ntrys++)
         {
-            int	found = false;
-
             for(itcnt = 0; itcnt < MAX_ITS; itcnt++)
             {
-                double	lim = lim0 / (1 + fabs(p) + fabs(q));
-
-                b[ord] = a[ord];
-                b[ordm1] = a[ordm1] - (p * b[ord]);
-                c[ord] = b[ord];
-                c[ordm1] = b[ordm1] - (p * c[ord]);
-                for(k = 2; k <= ordm1; k++){
-                    mmk = ord - k;
-                    mmkp2 = mmk+2;
-                    mmkp1 = mmk+1;
-                    b[mmk] = a[mmk] - (p* b[mmkp1]) - (q* b[mmkp2]);
-                    c[mmk] = b[mmk] - (p* c[mmkp1]) - (q* c[mmkp2]);
-                    if (b[mmk] > lim || c[mmk] > lim)
-                        break;
-                }
-                if (k > ordm1) { /* normal exit from for(k ... */
-                    /* ????	b[0] = a[0] - q * b[2];	*/
-                    b[0] = a[0] - p * b[1] - q * b[2];
-                    if (b[0] <= lim) k++;
-                }
-                if (k <= ord)	/* Some coefficient exceeded lim; */
-                    break;	/* potential overflow below. */
+                int	r = bairstow(a, ord, &p, &q, b, c, lim0);
 
-                err = fabs(b[0]) + fabs(b[1]);
-
-                if(err <= MAX_ERR) {
-                    found = true;
+                if (r != 0) {
+                    found = r > 0;
                     break;
                 }
+            } /* for(itcnt... */
 
-                den = (c[2] * c[2]) - (c[3] * (c[1] - b[1]));
-                if(den == 0.0)
-                    break;
-
-                delp = ((c[2] * b[1]) - (c[3] * b[0]))/den;
-                delq = ((c[2] * b[0]) - (b[1] * (c[1] - b[1])))/den;
-
-                p += delp;
-                q += delq;
+            STATS_ADD(ws, iterations, itcnt < MAX_ITS ? itcnt + 1 : itcnt);
 
-            } /* for(itcnt... */
+            /* give up on the whole polynomial once it's taken too long */
+            if ((budget -= itcnt < MAX_ITS ? itcnt + 1 : itcnt) < 0)
+                return(false);
 
             if (found)		/* we finally found the root! */
                 break;
             else { /* try some new starting values */
-                p = ((double)rand() - 0.5*RAND_MAX)/(double)RAND_MAX;
-                q = ((double)rand() - 0.5*RAND_MAX)/(double)RAND_MAX;
+                STATS_ADD(ws, restarts, 1);
+                p = formant_workspace_rand(ws) - 0.5;
+                q = formant_workspace_rand(ws) - 0.5;
             }
 
         } /* for(ntrys... */
@@ -739,6 +1043,7 @@ static int lbpoly(double *a, int order, double *rootr, double *rooti) {
 
         /* Update the coefficient array with the coeffs. of the
            reduced polynomial. */
+        UNROLL_ORDER
         for( i = 0; i <= ordm2; i++) a[i] = b[i+2];
     }
 
@@ -761,24 +1066,76 @@ static int lbpoly(double *a, int order, double *rootr, double *rooti) {
     return(true);
 }
 
+/* Orders common enough to get steps of their own, which the compiler builds
+   with the order known, so it can unroll the recursion and the root search
+   and keep their scratch in registers. */
+#define LPC_ORDERS(X) X(8) X(10) X(12) X(14) X(16) X(18)
+
+#define ORDER_KERN(P) \
+    static void durbin_##P(const double *r, double *k, double *a, int p, \
+                           double *ex) \
+    { \
+        (void) p; \
+        durbin(r, k, a, P, ex); \
+    } \
+    static int lbpoly_##P(formant_workspace_t *ws, double *a, int order, \
+                          double *rootr, double *rooti, bool warm) \
+    { \
+        (void) order; \
+        return lbpoly(ws, a, P, rootr, rooti, warm); \
+    }
+
+LPC_ORDERS(ORDER_KERN)
+
+static void durbin_any(const double *r, double *k, double *a, int p,
+                       double *ex)
+{
+    durbin(r, k, a, p, ex);
+}
+
+static int lbpoly_any(formant_workspace_t *ws, double *a, int order,
+                      double *rootr, double *rooti, bool warm)
+{
+    return lbpoly(ws, a, order, rootr, rooti, warm);
+}
+
+#define ORDER_ENTRY(P) [P] = { durbin_##P, lbpoly_##P },
+#define ORDER_LIST(P) P,
+
+static const order_kern_t order_kerns[] = { LPC_ORDERS(ORDER_ENTRY) };
+static const order_kern_t order_any = { durbin_any, lbpoly_any };
+
+/* Get the steps for the given order. */
+static const order_kern_t *order_kern(int p) {
+    if (p >= 0 && (size_t) p < sizeof(order_kerns) / sizeof(order_kerns[0]) &&
+        order_kerns[p].durbin)
+    {
+        return &order_kerns[p];
+    }
+
+    return &order_any;
+}
+
 /* Find the roots of the LPC denominator polynomial and convert the z-plane
    zeros to equivalent resonant frequencies and bandwidths.	*/
 /* The complex poles are then ordered by frequency.  */
 /* lpc_ord: order of the LP model */
 /* n_form: number of COMPLEX roots of the LPC polynomial */
-/* init: preset to true if no root candidates are available */
+/* init: true if rr and ri don't hold the roots of the last frame */
 /* s_freq: the sampling frequency of the speech waveform data */
 /* lpca: linear predictor coefficients */
 /* freq: returned array of candidate formant frequencies */
 /* band: returned array of candidate formant bandwidths */
-int formant(int lpc_order, double s_freq, double *lpca, int *n_form,
-            double *freq, double *band, double *rr, double *ri)
+int formant(formant_workspace_t *ws, int lpc_order, double s_freq,
+            double *lpca, int *n_form, double *freq, double *band, double *rr,
+            double *ri, bool init)
 {
     double  flo, pi2t, theta;
     int	i,ii,iscomp1,iscomp2,fc,swit;
 
-    if(! lbpoly(lpca,lpc_order,rr,ri)){ /* find the roots of the LPC polynomial */
+    if(! order_kern(lpc_order)->lbpoly(ws,lpca,lpc_order,rr,ri,!init)){ /* find the roots of the LPC polynomial */
         *n_form = 0;		/* was there a problem in the root finder? */
+        STATS_ADD(ws, root_failures, 1);
         return(false);
     }
 
@@ -825,3 +1182,469 @@ int formant(int lpc_order, double s_freq, double *lpca, int *n_form,
 
     return(true);
 }
+
+/* Find the crossing of level by the squared magnitudes q of the LPC
+   polynomial, starting from the point k at the bottom of a valley and
+   stepping by dir, at most to point end.  Return its distance from pos in
+   points, or -1 if q turns down again or runs out first, as where the peak of
+   the envelope merges into another. */
+static double peak_edge(const double *q, int k, int end, int dir,
+                        double level, double pos)
+{
+    int	j;
+
+    if(q[k] >= level)		/* narrower than a point */
+        return(-1.0);
+
+    for(j = k; j != end && q[j+dir] < level; j += dir)
+        if(q[j+dir] < q[j])
+            return(-1.0);
+
+    if(j == end)
+        return(-1.0);
+
+    return(fabs(j + dir * (level - q[j]) / (q[j+dir] - q[j]) - pos));
+}
+
+/* Build the cosines 2*cos(pi*j/n) at the n points from 0 up to the Nyquist
+   frequency where formant_peaks() sums the envelope. */
+static void peaks_cos(void *data, int n, int unused) {
+    double *c = data;
+    int	j;
+
+    (void)unused;
+
+    for(j = 0; j < n; j++)
+        c[j] = 2.0 * cos(M_PI * j / n);
+}
+
+/* Estimate the formants from the peaks of the LPC spectral envelope
+   1/|A(f)|**2, where A is the polynomial in lpca, rather than from its
+   roots.  |A|**2 is a cosine series in the autocorrelation of lpca, which is
+   summed at PEAKS_POINTS + 1 evenly spaced frequencies by Clenshaw's
+   recurrence, all frequencies a step at a time, so a frame takes the same
+   time whatever its roots, and no scratch.  Each peak is placed by fitting a
+   parabola to the log envelope at the point and its two neighbours, and its
+   bandwidth is the width of the envelope 3 dB down from the peak, or twice
+   the half width on the side not merged into another peak.  A peak with
+   neither side clear, or narrower than a point, gets the bandwidth of the
+   single resonance with the curvature of the parabola.  The candidates come
+   out as from formant(), lowest first. */
+int formant_peaks(int lpc_order, double s_freq, const double *lpca,
+                  int *n_form, double *freq, double *band)
+{
+    enum { M = PEAKS_POINTS };
+    const double *c = cache_get(CACHE_PEAKS_COS, M, 0, sizeof(double) * M,
+                                peaks_cos);
+    double  r[MAXORDER+1], q[M+1], b[M], nyq, hz = 0.5 * s_freq / M;
+    int	    i, j, k, nf;
+
+    for(i = 0, nyq = 0.0; i <= lpc_order; i++){
+        for(j = 0, r[i] = 0.0; j <= lpc_order - i; j++)
+            r[i] += lpca[j] * lpca[j+i];
+        nyq += i % 2 ? -lpca[i] : lpca[i];
+    }
+
+    for(j = 0; j < M; j++) q[j] = b[j] = 0.0;
+
+    /* |A|**2 = r[0] + 2 * sum(r[i] * cos(i * w)), from the top term down,
+       with q and b holding the last two steps.  The loops run over a whole
+       number of vectors, which leaves the Nyquist frequency, where A is
+       just the alternating sum of lpca. */
+    for(i = lpc_order; i > 0; i--)
+        for(j = 0; j < M; j++){
+            double	t = (2.0 * r[i]) + (c[j] * q[j]) - b[j];
+
+            b[j] = q[j];
+            q[j] = t;
+        }
+
+    for(j = 0; j < M; j++)
+        q[j] = r[0] + (0.5 * c[j] * q[j]) - b[j];
+    q[M] = nyq * nyq;
+
+    /* The peaks of the envelope are the valleys of |A|**2. */
+    for(k = 1, nf = 0; k < M && nf < lpc_order; k++){
+        double	l0, l1, l2, den, d, level, lw, rw, bw;
+
+        if(!(q[k] < q[k-1] && q[k] <= q[k+1] && q[k] > 0.0))
+            continue;
+
+        l0 = log(q[k-1]);
+        l1 = log(q[k]);
+        l2 = log(q[k+1]);
+        den = l0 - (2.0 * l1) + l2;	/* positive at a valley */
+        d = 0.5 * (l0 - l2) / den;
+
+        /* half the power of the envelope at the top of the parabola */
+        level = 2.0 * exp(l1 - (0.25 * (l0 - l2) * d));
+
+        lw = peak_edge(q, k, 0, -1, level, k + d);
+        rw = peak_edge(q, k, M, 1, level, k + d);
+
+        if(lw >= 0.0 && rw >= 0.0)
+            bw = lw + rw;
+        else if(lw >= 0.0 || rw >= 0.0)
+            bw = 2.0 * (lw >= 0.0 ? lw : rw);
+        else			/* of log((f-f0)**2 + (b/2)**2) */
+            bw = 2.0 * sqrt(2.0 / den);
+
+        freq[nf] = (k + d) * hz;
+        band[nf] = bw * hz;
+        nf++;
+    }
+
+    *n_form = nf;
+
+    return(true);
+}
+
+#ifdef LIBFORMANT_TEST
+TEST test_order_kern() {
+    enum { N = 400 };
+    static const int orders[] = { LPC_ORDERS(ORDER_LIST) };
+    double s[N];
+    formant_workspace_t ws;
+
+    srand(6);
+
+    for (size_t i = 0; i < N; i += 1)
+        s[i] = sin(i * .3) + .5 * sin(i * 1.7) + (double)rand() / RAND_MAX;
+
+    formant_workspace_init(&ws);
+
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); o += 1) {
+        int p = orders[o];
+        const order_kern_t *kern = order_kern(p);
+        double r[MAXORDER + 1], k[2][MAXORDER], a[2][MAXORDER + 1], e[2];
+        double rr[2][MAXORDER + 1], ri[2][MAXORDER + 1];
+        int ok[2];
+
+        GREATEST_ASSERT(kern != &order_any);
+
+        for (int j = 0; j <= p; j += 1) {
+            r[j] = 0;
+
+            for (int i = j; i < N; i += 1)
+                r[j] += s[i] * s[i - j];
+        }
+
+        kern->durbin(r, k[0], a[0] + 1, p, &e[0]);
+        order_any.durbin(r, k[1], a[1] + 1, p, &e[1]);
+
+        /* The specialized steps must do exactly the same arithmetic. */
+        GREATEST_ASSERT_EQ(e[0], e[1]);
+        GREATEST_ASSERT(memcmp(k[0], k[1], sizeof(double) * p) == 0);
+        GREATEST_ASSERT(memcmp(a[0] + 1, a[1] + 1, sizeof(double) * p) == 0);
+
+        for (int m = 0; m < 2; m += 1) {
+            a[m][0] = 1;
+
+            for (int i = 0; i <= p; i += 1) {
+                rr[m][i] = 2 * cos((p - i + .5) * M_PI / (p + 1));
+                ri[m][i] = 2 * sin((p - i + .5) * M_PI / (p + 1));
+            }
+        }
+
+        formant_workspace_seed(&ws, 1);
+        ok[0] = kern->lbpoly(&ws, a[0], p, rr[0], ri[0], false);
+        formant_workspace_seed(&ws, 1);
+        ok[1] = order_any.lbpoly(&ws, a[1], p, rr[1], ri[1], false);
+
+        GREATEST_ASSERT(ok[0] && ok[1]);
+        GREATEST_ASSERT(memcmp(rr[0], rr[1], sizeof(double) * p) == 0);
+        GREATEST_ASSERT(memcmp(ri[0], ri[1], sizeof(double) * p) == 0);
+    }
+
+    /* Other orders fall back to the generic steps. */
+    GREATEST_ASSERT_EQ(order_kern(11), &order_any);
+    GREATEST_ASSERT_EQ(order_kern(24), &order_any);
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+TEST test_lpc_lanes() {
+    enum { N = 400, FRAMES = KERN_LANES + 2, P = 12 };
+    static const window_type_t types[] = {
+        WINDOW_TYPE_RECTANGULAR, WINDOW_TYPE_HAMMING,
+    };
+    short data[FRAMES][N + 1];
+    short *frames[FRAMES];
+    double got[FRAMES][P + 1], want[P + 1], rms[FRAMES], en;
+    double *lpca[FRAMES];
+    formant_workspace_t ws;
+
+    srand(7);
+
+    /* Leave one frame silent, and the last group of lanes part empty. */
+    for (int f = 0; f < FRAMES; f += 1) {
+        for (int i = 0; i <= N; i += 1)
+            data[f][i] = f == 1 ? 0 :
+                3000 * sin(i * (.2 + .1 * f)) + rand() % 1000 - 500;
+
+        frames[f] = data[f];
+        lpca[f] = got[f];
+    }
+
+    formant_workspace_init(&ws);
+
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t += 1) {
+        for (double preemp = 0; preemp < 1; preemp += .7) {
+            formant_workspace_reset(&ws);
+            lpc_lanes(&ws, P, 70, N, FRAMES, frames, lpca, rms, preemp,
+                      types[t]);
+
+            for (int f = 0; f < FRAMES; f += 1) {
+                formant_workspace_reset(&ws);
+                lpc(&ws, P, 70, N, data[f], want, NULL, NULL, NULL, &en,
+                    preemp, types[t], PRECISION_DOUBLE);
+
+                GREATEST_ASSERT(fabs(en - rms[f]) <= 1e-9 * en);
+
+                for (int i = 0; i <= P; i += 1)
+                    GREATEST_ASSERT(fabs(want[i] - got[f][i]) <= 1e-9);
+            }
+        }
+    }
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+/* Multiply out the polynomial of order 2n with the quadratic factors
+   x**2 + p[j]*x + q[j] into a, in increasing order. */
+static void poly_factors(const double *p, const double *q, int n, double *a) {
+    a[0] = 1;
+
+    for (int j = 0, ord = 0; j < n; j += 1, ord += 2) {
+        double b[MAXORDER + 1] = {0};
+
+        for (int i = 0; i <= ord; i += 1) {
+            b[i] += q[j] * a[i];
+            b[i + 1] += p[j] * a[i];
+            b[i + 2] += a[i];
+        }
+
+        memcpy(a, b, sizeof(double) * (ord + 3));
+    }
+}
+
+/* Check that every one of the n roots in (rr[1], ri[1]) is within tol of a
+   root in (rr[0], ri[0]). */
+static bool roots_match(double rr[2][MAXORDER + 1], double ri[2][MAXORDER + 1],
+                        int n, double tol)
+{
+    for (int i = 0; i < n; i += 1) {
+        bool found = false;
+
+        for (int j = 0; j < n && !found; j += 1)
+            found = hypot(rr[1][i] - rr[0][j], ri[1][i] - ri[0][j]) < tol;
+
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+TEST test_lbpoly_polish() {
+    enum { ORDER = 12, N = ORDER / 2 };
+    double p[N], q[N], a[ORDER + 1], b[ORDER + 1];
+    double rr[2][MAXORDER + 1], ri[2][MAXORDER + 1], old[2][MAXORDER + 1];
+    int budget = MAX_BUDGET(ORDER);
+    formant_workspace_t ws;
+
+    formant_workspace_init(&ws);
+
+    for (int j = 0; j < N; j += 1) {
+        p[j] = -2 * .95 * cos(.2 + .45 * j);
+        q[j] = .95 * .95;
+    }
+
+    poly_factors(p, q, N, a);
+
+    for (int i = 0; i <= ORDER; i += 1) {
+        rr[0][i] = 2 * cos((ORDER - i + .5) * M_PI / (ORDER + 1));
+        ri[0][i] = 2 * sin((ORDER - i + .5) * M_PI / (ORDER + 1));
+    }
+
+    GREATEST_ASSERT(lbpoly_any(&ws, a, ORDER, rr[0], ri[0], false));
+    memcpy(old[0], rr[0], sizeof(rr[0]));
+    memcpy(old[1], ri[0], sizeof(ri[0]));
+
+    /* Move every resonance a little, as from one frame to the next. */
+    for (int j = 0; j < N; j += 1)
+        p[j] = -2 * .94 * cos(.21 + .45 * j);
+
+    poly_factors(p, q, N, a);
+
+    /* The old roots polish into the new ones without a search... */
+    memcpy(b, a, sizeof(a));
+    memcpy(rr[1], old[0], sizeof(rr[1]));
+    memcpy(ri[1], old[1], sizeof(ri[1]));
+    GREATEST_ASSERT_EQ(lbpoly_polish(&ws, b, ORDER, rr[1], ri[1], &budget),
+                       2);
+    GREATEST_ASSERT(budget < MAX_BUDGET(ORDER));
+
+    /* ...and come out as the full search finds them. */
+    memcpy(b, a, sizeof(a));
+    memcpy(rr[0], old[0], sizeof(rr[0]));
+    memcpy(ri[0], old[1], sizeof(ri[0]));
+    GREATEST_ASSERT(lbpoly_any(&ws, b, ORDER, rr[0], ri[0], false));
+
+    memcpy(b, a, sizeof(a));
+    memcpy(rr[1], old[0], sizeof(rr[1]));
+    memcpy(ri[1], old[1], sizeof(ri[1]));
+    GREATEST_ASSERT(lbpoly_any(&ws, b, ORDER, rr[1], ri[1], true));
+    GREATEST_ASSERT(roots_match(rr, ri, ORDER, 1e-4));
+
+    /* Old roots that all lead to the same factor fall back to the full
+       search once the first one is taken. */
+    for (int i = 0; i <= ORDER; i += 1) {
+        rr[1][i] = .5;
+        ri[1][i] = 0;
+    }
+
+    memcpy(b, a, sizeof(a));
+    GREATEST_ASSERT(lbpoly_any(&ws, b, ORDER, rr[1], ri[1], true));
+    GREATEST_ASSERT(roots_match(rr, ri, ORDER, 1e-4));
+
+    /* A polynomial whose roots run off to infinity gives up within the
+       budget, rather than after every try of every factor. */
+    memset(a, 0, sizeof(a));
+    a[0] = 1;
+    a[ORDER] = 1e-30;
+    ws.stats.iterations = 0;
+    GREATEST_ASSERT(!lbpoly_any(&ws, a, ORDER, rr[1], ri[1], true));
+
+    if (formant_stats_enabled())
+        GREATEST_ASSERT(ws.stats.iterations <= MAX_BUDGET(ORDER) + MAX_ITS);
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+TEST test_formant_peaks() {
+    enum { ORDER = 6, N = ORDER / 2, RATE = 10000 };
+    static const double fs[N] = {500, 1500, 2500}, bs[N] = {80, 100, 150};
+    double p[N], q[N], a[ORDER + 1], lpca[ORDER + 1];
+    double freq[ORDER], band[ORDER];
+    int nform;
+
+    for (int j = 0; j < N; j += 1) {
+        double r = exp(-M_PI * bs[j] / RATE);
+
+        p[j] = -2 * r * cos(2 * M_PI * fs[j] / RATE);
+        q[j] = r * r;
+    }
+
+    /* The predictor runs the other way from the factors. */
+    poly_factors(p, q, N, a);
+
+    for (int i = 0; i <= ORDER; i += 1)
+        lpca[i] = a[ORDER - i];
+
+    /* Clear resonances peak close to their poles. */
+    GREATEST_ASSERT(formant_peaks(ORDER, RATE, lpca, &nform, freq, band));
+    GREATEST_ASSERT_EQ(nform, N);
+
+    for (int j = 0; j < N; j += 1) {
+        GREATEST_ASSERT(fabs(freq[j] - fs[j]) < 15);
+        GREATEST_ASSERT(fabs(band[j] - bs[j]) < .1 * bs[j]);
+    }
+
+    /* Close ones merge into a single peak, which is wider. */
+    p[1] = -2 * sqrt(q[1]) * cos(2 * M_PI * 620 / RATE);
+    poly_factors(p, q, N, a);
+
+    for (int i = 0; i <= ORDER; i += 1)
+        lpca[i] = a[ORDER - i];
+
+    GREATEST_ASSERT(formant_peaks(ORDER, RATE, lpca, &nform, freq, band));
+    GREATEST_ASSERT_EQ(nform, N - 1);
+    GREATEST_ASSERT(freq[0] > fs[0] && freq[0] < 620);
+    GREATEST_ASSERT(band[0] > bs[1]);
+    GREATEST_ASSERT(fabs(freq[1] - fs[2]) < 15);
+
+    /* A flat envelope has no peaks at all. */
+    memset(lpca, 0, sizeof(lpca));
+    lpca[0] = 1;
+    GREATEST_ASSERT(formant_peaks(ORDER, RATE, lpca, &nform, freq, band));
+    GREATEST_ASSERT_EQ(nform, 0);
+
+    PASS();
+}
+
+TEST test_lpc_burg() {
+    enum { N = 160, ORDER = 12 };
+    /* A resonance at a tenth of the sample rate with a radius of 0.95. */
+    const double a1 = -2 * .95 * cos(2 * M_PI * .1), a2 = .95 * .95;
+    double a[ORDER + 1], y1 = 0, y2 = 0, rms;
+    double freq[ORDER], band[ORDER], rr[ORDER + 1], ri[ORDER + 1];
+    short x[N + 1];
+    formant_workspace_t ws;
+    bool found = false;
+    int nform;
+
+    srand(3);
+
+    for (size_t i = 0; i <= N; i += 1) {
+        double y = 1000 * ((double)rand() / RAND_MAX - .5) - a1 * y1 - a2 * y2;
+
+        y2 = y1;
+        y1 = y;
+        x[i] = y;
+    }
+
+    formant_workspace_init(&ws);
+
+    /* Even a window of 160 samples recovers the resonance closely. */
+    lpc_burg(&ws, 2, N, x, a, &rms, 0, WINDOW_TYPE_RECTANGULAR);
+    GREATEST_ASSERT_EQ(a[0], 1);
+    GREATEST_ASSERT(fabs(a[1] - a1) < .05);
+    GREATEST_ASSERT(fabs(a[2] - a2) < .05);
+    GREATEST_ASSERT(rms > 0);
+
+    /* A higher order still finds it among its poles. */
+    formant_workspace_reset(&ws);
+    lpc_burg(&ws, ORDER, N, x, a, &rms, 0, WINDOW_TYPE_HAMMING);
+
+    for (int i = 0; i <= ORDER; i += 1) {
+        rr[i] = 2 * cos((ORDER - i + .5) * M_PI / (ORDER + 1));
+        ri[i] = 2 * sin((ORDER - i + .5) * M_PI / (ORDER + 1));
+    }
+
+    GREATEST_ASSERT(formant(&ws, ORDER, 10000, a, &nform, freq, band, rr, ri,
+                            true));
+
+    for (int i = 0; i < nform; i += 1)
+        found = found || (fabs(freq[i] - 1000) < 50 && band[i] < 300);
+
+    GREATEST_ASSERT(found);
+
+    /* Silence leaves the predictor flat. */
+    memset(x, 0, sizeof(x));
+    formant_workspace_reset(&ws);
+    lpc_burg(&ws, ORDER, N, x, a, &rms, .7, WINDOW_TYPE_RECTANGULAR);
+    GREATEST_ASSERT_EQ(rms, 0);
+
+    for (int i = 1; i <= ORDER; i += 1)
+        GREATEST_ASSERT_EQ(a[i], 0);
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+SUITE(processing_suite) {
+    RUN_TEST(test_order_kern);
+    RUN_TEST(test_lpc_lanes);
+    RUN_TEST(test_lpc_burg);
+    RUN_TEST(test_lbpoly_polish);
+    RUN_TEST(test_formant_peaks);
+}
+#endif
@@ -9,8 +9,11 @@
 #ifndef PROCESSING_H
 #define PROCESSING_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
+#include "workspace.h"
+
 typedef enum {
     WINDOW_TYPE_RECTANGULAR,
     WINDOW_TYPE_HAMMING,
@@ -20,17 +23,43 @@ typedef enum {
     WINDOW_TYPE_INVALID,
 } window_type_t;
 
-int formant(int lpc_order, double s_freq, double *lpca, int *n_form,
-            double *freq, double *band, double *rr, double *ri);
+// Floating-point precision of the windowing and autocorrelation in LPC
+// analysis. The rest of the analysis is always done in double precision.
+typedef enum {
+    PRECISION_DOUBLE,
+    PRECISION_FLOAT,
+
+    PRECISION_INVALID,
+} precision_t;
+
+int formant(formant_workspace_t *ws, int lpc_order, double s_freq,
+            double *lpca, int *n_form, double *freq, double *band, double *rr,
+            double *ri, bool init);
+
+// Number of steps from 0 to the Nyquist frequency at which formant_peaks()
+// evaluates the LPC spectral envelope, which spaces them 39Hz apart at 10kHz.
+enum { PEAKS_POINTS = 128 };
+
+int formant_peaks(int lpc_order, double s_freq, const double *lpca,
+                  int *n_form, double *freq, double *band);
+
+int w_covar(formant_workspace_t *ws, short *xx, int *m, int n, int istrt,
+            double *y, double *alpha, double *r0, double preemp,
+            window_type_t w_type);
+
+void lpc(formant_workspace_t *ws, size_t lpc_ord, double lpc_stabl, size_t wsize,
+         short *data, double *lpca, double *ar, double *lpck, double *normerr,
+         double *rms, double preemp, window_type_t type, precision_t precision);
 
-int w_covar(short *xx, int *m, int n, int istrt, double *y, double *alpha,
-            double *r0, double preemp, window_type_t w_type);
+void lpc_lanes(formant_workspace_t *ws, size_t lpc_ord, double lpc_stabl,
+               size_t wsize, size_t n, short *const *data, double *const *lpca,
+               double *rms, double preemp, window_type_t type);
 
-void lpc(size_t lpc_ord, double lpc_stabl, size_t wsize, short *data, double *lpca,
-         double *ar, double *lpck, double *normerr, double *rms, double preemp,
-         window_type_t type);
+void lpc_burg(formant_workspace_t *ws, size_t lpc_ord, size_t wsize,
+              short *data, double *lpca, double *rms, double preemp,
+              window_type_t type);
 
 int dlpcwtd(double *s, int *ls, double *p, int *np, double *c, double *phi,
-            double *shi, double *xl, double *w);
+            double *shi, double *xl, const double *w);
 
 #endif
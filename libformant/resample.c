@@ -0,0 +1,285 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "cache.h"
+#include "kernels.h"
+#include "resample.h"
+
+#ifdef LIBFORMANT_TEST
+#include <stdlib.h>
+
+#include "greatest.h"
+#endif
+
+#define PI 3.14159265358979323846
+
+// Number of taps per branch for each multiple of the decimation ratio.
+enum { TAPS_PER_RATIO = 24 };
+// Largest filter bank that will be built, in coefficients.
+enum { BANK_MAX = 1 << 20 };
+// Fraction bits of the filter bank. Branches near unity ratio sum to more than
+// twice unity, so Q15 would let a full-scale input overflow the accumulator.
+enum { BANK_BITS = 14 };
+// Kaiser window shape, giving about 80 dB of stopband attenuation.
+static const double KAISER_BETA = 8.0;
+
+static size_t gcd(size_t a, size_t b) {
+    while (b) {
+        size_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind.
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+
+    for (int k = 1; term > 1e-12 * sum; k += 1) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+// Number of taps per branch when resampling by up/down.
+static int bank_taps(int up, int down) {
+    int ratio = (down + up - 1) / up;
+    int taps = TAPS_PER_RATIO * (ratio < 1 ? 1 : ratio);
+
+    return taps > RESAMPLE_TAPS_MAX ? RESAMPLE_TAPS_MAX : taps;
+}
+
+// Build the polyphase bank of a Kaiser-windowed sinc lowpass filter that cuts
+// off at the lower of the two Nyquist rates. The prototype runs at the
+// upsampled rate, and its gain is raised by up to make up for the zeros that
+// interpolation would stuff between input samples.
+static void bank_build(void *data, int up, int down) {
+    short *bank = data;
+    int taps = bank_taps(up, down);
+    int len = up * taps;
+    double fc = .5 / (up > down ? up : down);
+    double center = (len - 1) / 2.0;
+    double norm = bessel_i0(KAISER_BETA);
+
+    for (int k = 0; k < len; k += 1) {
+        double x = k - center, h, w, v;
+
+        h = x == 0 ? 2 * fc : sin(2 * PI * fc * x) / (PI * x);
+        w = bessel_i0(KAISER_BETA * sqrt(1 - (x / center) * (x / center)));
+        v = up * h * (w / norm) * (1 << BANK_BITS);
+
+        // Prototype tap k weighs the input (k / up) samples back in branch
+        // (k % up), and the branch runs oldest sample first.
+        bank[(k % up) * taps + taps - 1 - k / up] =
+            v > SHRT_MAX ? SHRT_MAX : v < SHRT_MIN ? SHRT_MIN : lrint(v);
+    }
+}
+
+bool resampler_init(resampler_t *r, size_t rate_in, size_t rate_out) {
+    size_t div;
+
+    if (!rate_in || !rate_out)
+        return false;
+
+    div = gcd(rate_in, rate_out);
+
+    if (rate_out / div > BANK_MAX || rate_in / div > BANK_MAX)
+        return false;
+
+    r->up = rate_out / div;
+    r->down = rate_in / div;
+    r->taps = bank_taps(r->up, r->down);
+
+    if ((size_t)r->up * r->taps > BANK_MAX)
+        return false;
+
+    r->bank = cache_get(CACHE_LOWPASS, r->up, r->down,
+                        sizeof(short) * r->up * r->taps, bank_build);
+
+    if (!r->bank)
+        return false;
+
+    resampler_reset(r);
+
+    return true;
+}
+
+// Position of the first output on the upsampled grid, relative to the first
+// input sample. The first output is centered on the first input, so the
+// filter's delay is taken up by waiting for the input rather than by shifting
+// the output.
+static int start_pos(const resampler_t *r) {
+    return (r->up * r->taps - 1) / 2;
+}
+
+// Scale the sum of a branch back to a sample.
+static short bank_out(int sum) {
+    sum = (sum + (1 << (BANK_BITS - 1))) >> BANK_BITS;
+
+    return sum > SHRT_MAX ? SHRT_MAX : sum < SHRT_MIN ? SHRT_MIN : sum;
+}
+
+void resampler_reset(resampler_t *r) {
+    memset(r->hist, 0, sizeof(r->hist));
+    r->head = 0;
+    r->pos = start_pos(r);
+}
+
+size_t resampler_max_out(const resampler_t *r, size_t n) {
+    return n * r->up / r->down + 1;
+}
+
+size_t resampler_push(resampler_t *r, const short *in, size_t n, short *out) {
+    int (*dot16)(const short *, const short *, size_t) = kern_best()->dot16;
+    size_t n_out = 0;
+
+    for (size_t i = 0; i < n; i += 1) {
+        r->hist[r->head] = r->hist[r->head + r->taps] = in[i];
+        r->head = r->head + 1 == r->taps ? 0 : r->head + 1;
+
+        // Emit every output whose newest input is the sample just taken.
+        for (; r->pos < r->up; r->pos += r->down) {
+            out[n_out++] = bank_out(dot16(r->bank + r->pos * r->taps,
+                                          r->hist + r->head, r->taps));
+        }
+
+        r->pos -= r->up;
+    }
+
+    return n_out;
+}
+
+void resampler_range(const resampler_t *r, const short *in, size_t n,
+                     size_t first, size_t count, short *out)
+{
+    int (*dot16)(const short *, const short *, size_t) = kern_best()->dot16;
+    short win[RESAMPLE_TAPS_MAX];
+    size_t taps = r->taps;
+
+    for (size_t m = first; m < first + count; m += 1) {
+        size_t at = start_pos(r) + m * r->down;
+        // The output's newest input sample, counting from one.
+        size_t end = at / r->up + 1;
+        const short *x = win;
+
+        // Build the delay line by hand where it runs off either end.
+        if (end >= taps && end <= n) {
+            x = in + end - taps;
+        } else {
+            for (size_t k = 0; k < taps; k += 1) {
+                win[k] = end + k >= taps && end + k - taps < n ?
+                         in[end + k - taps] : 0;
+            }
+        }
+
+        *out++ = bank_out(dot16(r->bank + (at % r->up) * taps, x, taps));
+    }
+}
+
+#ifdef LIBFORMANT_TEST
+// Resample a full-scale sine of the given frequency and return the rms of the
+// output, skipping the filter's startup.
+static double tone_rms(resampler_t *r, size_t rate, double freq) {
+    enum { N = 8192 };
+    short in[N], out[N];
+    size_t n;
+    double sum = 0;
+
+    for (size_t i = 0; i < N; i += 1)
+        in[i] = 16384 * sin(2 * PI * freq * i / rate);
+
+    resampler_reset(r);
+    n = resampler_push(r, in, N, out);
+
+    for (size_t i = n / 4; i < n; i += 1)
+        sum += (double)out[i] * out[i];
+
+    return sqrt(sum / (n - n / 4));
+}
+
+TEST test_resampler_tones() {
+    const size_t rates[] = {11025, 16000, 22050, 44100, 48000};
+    resampler_t r;
+
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i += 1) {
+        GREATEST_ASSERT(resampler_init(&r, rates[i], 10000));
+        GREATEST_ASSERT_EQ(r.up * rates[i], r.down * 10000);
+
+        // Full-scale input can't overflow the sum in any branch.
+        for (int b = 0; b < r.up; b += 1) {
+            long gain = 0;
+
+            for (int k = 0; k < r.taps; k += 1)
+                gain += abs(r.bank[b * r.taps + k]);
+
+            GREATEST_ASSERT(gain <= INT_MAX / 32768);
+        }
+
+        // Passband tones keep their level and stopband tones are gone.
+        GREATEST_ASSERTm("passband", fabs(tone_rms(&r, rates[i], 1000) /
+                                          (16384 / sqrt(2)) - 1) < .01);
+
+        if (rates[i] > 2 * 6500) {
+            GREATEST_ASSERTm("stopband",
+                             tone_rms(&r, rates[i], 6500) < 16384 * .001);
+        }
+    }
+
+    PASS();
+}
+
+TEST test_resampler_chunks() {
+    enum { N = 5000 };
+    short in[N], whole[N], parts[N];
+    size_t n_whole, n_parts = 0;
+    resampler_t r;
+
+    srand(6);
+
+    for (size_t i = 0; i < N; i += 1)
+        in[i] = rand() % 20000 - 10000;
+
+    GREATEST_ASSERT(resampler_init(&r, 44100, 10000));
+    n_whole = resampler_push(&r, in, N, whole);
+
+    resampler_reset(&r);
+
+    for (size_t i = 0, len; i < N; i += len) {
+        len = rand() % 300;
+        len = N - i < len ? N - i : len;
+
+        GREATEST_ASSERT(resampler_max_out(&r, len) + n_parts <= N);
+        n_parts += resampler_push(&r, in + i, len, parts + n_parts);
+    }
+
+    GREATEST_ASSERT_EQ(n_whole, n_parts);
+    GREATEST_ASSERT(memcmp(whole, parts, sizeof(short) * n_whole) == 0);
+
+    // So does computing ranges of outputs separately, in any order.
+    memset(parts, 0, sizeof(parts));
+
+    for (size_t i = n_whole, len; i > 0; i -= len) {
+        len = rand() % 300;
+        len = i < len ? i : len;
+        resampler_range(&r, in, N, i - len, len, parts + i - len);
+    }
+
+    GREATEST_ASSERT(memcmp(whole, parts, sizeof(short) * n_whole) == 0);
+
+    PASS();
+}
+
+SUITE(resample_suite) {
+    RUN_TEST(test_resampler_tones);
+    RUN_TEST(test_resampler_chunks);
+}
+#endif
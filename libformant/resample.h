@@ -0,0 +1,58 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Most taps each polyphase branch may have.
+enum { RESAMPLE_TAPS_MAX = 256 };
+
+// Polyphase rational resampler. The rate is changed by exactly up/down, and
+// only the output samples that are kept are ever computed. State carries over
+// from one call to the next, so a stream can be resampled in arbitrary pieces.
+typedef struct {
+    // Interpolation and decimation factors, in lowest terms.
+    int up, down;
+    // Number of taps in each branch of the filter bank.
+    int taps;
+    // The up branches of the lowpass filter, each taps long and ordered to
+    // match the delay line, oldest sample first. Shared through the cache.
+    const short *bank;
+
+    // Last taps input samples, stored twice so the newest taps of them are
+    // always contiguous starting at hist + head.
+    short hist[2 * RESAMPLE_TAPS_MAX];
+    int head;
+    // Position of the next output on the upsampled grid, relative to the next
+    // input sample.
+    int pos;
+} resampler_t;
+
+// Initialize the given resampler to convert from rate_in to rate_out. Return
+// true if the resampler was initialized and false if the rates are too far
+// from a simple ratio to build a filter for.
+bool resampler_init(resampler_t *r, size_t rate_in, size_t rate_out);
+
+// Forget the signal seen so far.
+void resampler_reset(resampler_t *r);
+
+// Get the most output samples produced by n input samples.
+size_t resampler_max_out(const resampler_t *r, size_t n);
+
+// Resample the n samples at in, store the results in out, and return the
+// number stored. Outputs are aligned so the filter adds no delay: output m
+// corresponds to input time m * down / up, and is produced once the input
+// samples it depends on have arrived.
+size_t resampler_push(resampler_t *r, const short *in, size_t n, short *out);
+
+// Compute the count outputs starting with output first that a freshly reset
+// resampler would produce from the n samples at in followed by silence, and
+// store them in out. The resampler itself is left alone, so separate ranges of
+// a signal may be computed at once.
+void resampler_range(const resampler_t *r, const short *in, size_t n,
+                     size_t first, size_t count, short *out);
+
+#endif
@@ -0,0 +1,71 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#if defined(LIBFORMANT_STATS) || defined(LIBFORMANT_BENCH)
+// Ask for clock_gettime, which isn't part of C11.
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+#endif
+
+#include "bench.h"
+#include "stats.h"
+
+bool formant_stats_enabled(void) {
+#ifdef LIBFORMANT_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void formant_stats_clear(formant_stats_t *stats) {
+    *stats = (formant_stats_t) { .frames = 0 };
+}
+
+void formant_stats_add(formant_stats_t *dst, const formant_stats_t *src) {
+    for (size_t i = 0; i < FORMANT_N_STAGES; i += 1)
+        dst->ns[i] += src->ns[i];
+
+    dst->frames += src->frames;
+    dst->skipped += src->skipped;
+    dst->candidates += src->candidates;
+    dst->iterations += src->iterations;
+    dst->restarts += src->restarts;
+    dst->polished += src->polished;
+    dst->root_failures += src->root_failures;
+}
+
+#if defined(LIBFORMANT_STATS) || defined(LIBFORMANT_BENCH)
+uint64_t stats_now(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return (uint64_t)clock() * 1000000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+void stats_begin(formant_stats_t *stats, formant_stage_t stage) {
+    (void)stage;
+
+    stats->started = stats_now();
+    BENCH_BEGIN(stage);
+}
+
+void stats_end(formant_stats_t *stats, formant_stage_t stage) {
+    uint64_t ns = stats_now() - stats->started;
+
+    (void)stage;
+    (void)ns;
+
+#ifdef LIBFORMANT_STATS
+    stats->ns[stage] += ns;
+#endif
+
+    BENCH_END(stage, ns);
+}
+#endif
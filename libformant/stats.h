@@ -0,0 +1,82 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Stages of formant analysis that are timed separately.
+typedef enum {
+    FORMANT_STAGE_DOWNSAMPLE,
+    FORMANT_STAGE_HIGHPASS,
+    FORMANT_STAGE_VAD,
+    FORMANT_STAGE_LPC,
+    FORMANT_STAGE_ROOTS,
+    FORMANT_STAGE_PITCH,
+    FORMANT_STAGE_DP,
+
+    FORMANT_N_STAGES,
+} formant_stage_t;
+
+// What went on during a calculation. The counts are only kept when libformant
+// is built with LIBFORMANT_STATS (make STATS=1) and stay zero otherwise, so the
+// checks cost nothing in a normal build. The layout is the same either way.
+typedef struct {
+    // Time spent in each stage in nanoseconds. Stages that run across threads
+    // add up the time of every thread, so they may take longer in total than
+    // the calculation did.
+    uint64_t ns[FORMANT_N_STAGES];
+
+    // Number of frames analysed, and how many of those were skipped for low
+    // energy or as silence or noise without looking for formants.
+    size_t frames, skipped;
+    // Number of formant mappings generated as candidates for the lattice.
+    size_t candidates;
+    // Number of Bairstow iterations and of restarts from random starting
+    // points while finding the roots of the LPC polynomials, and the number of
+    // frames whose roots came from polishing those of the frame before.
+    size_t iterations, restarts, polished;
+    // Number of frames where the roots couldn't be found.
+    size_t root_failures;
+
+    // Start of the stage currently being timed.
+    uint64_t started;
+} formant_stats_t;
+
+// Check whether libformant was built to keep stats.
+bool formant_stats_enabled(void);
+
+// Zero the given stats.
+void formant_stats_clear(formant_stats_t *stats);
+
+// Add the stats in src to those in dst.
+void formant_stats_add(formant_stats_t *dst, const formant_stats_t *src);
+
+// Hooks for the analysis code. They take a workspace, whose stats are updated,
+// and compile to nothing unless stats or benchmarks are enabled.
+#if defined(LIBFORMANT_STATS) || defined(LIBFORMANT_BENCH)
+// Get the current time in nanoseconds from an arbitrary starting point.
+uint64_t stats_now(void);
+
+void stats_begin(formant_stats_t *stats, formant_stage_t stage);
+void stats_end(formant_stats_t *stats, formant_stage_t stage);
+
+// Time a stage. Stages don't nest within the same workspace.
+#define STATS_BEGIN(ws, stage) stats_begin(&(ws)->stats, stage)
+#define STATS_END(ws, stage) stats_end(&(ws)->stats, stage)
+#else
+#define STATS_BEGIN(ws, stage) ((void)(ws))
+#define STATS_END(ws, stage) ((void)(ws))
+#endif
+
+#ifdef LIBFORMANT_STATS
+// Add n to the given count.
+#define STATS_ADD(ws, field, n) ((ws)->stats.field += (n))
+#else
+#define STATS_ADD(ws, field, n) ((void)(ws))
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "synth.h"
+
+#define PI 3.14159265358979323846
+
+void synth_voice(formant_sample_t *x, size_t n, size_t sample_rate, double f0,
+                 const double *freq, const double *band, size_t n_res,
+                 double peak)
+{
+    double *y = malloc(sizeof(double) * n);
+    double phase = 0, amax = 0;
+
+    for (size_t i = 0; i < n; i += 1) {
+        phase += f0 / sample_rate;
+        y[i] = phase >= 1;
+        phase -= phase >= 1;
+    }
+
+    for (size_t k = 0; k < n_res; k += 1) {
+        double r = exp(-PI * band[k] / sample_rate);
+        double a1 = 2 * r * cos(2 * PI * freq[k] / sample_rate);
+        double a2 = -r * r;
+
+        for (size_t i = 0; i < n; i += 1)
+            y[i] += (i > 0 ? a1 * y[i-1] : 0) + (i > 1 ? a2 * y[i-2] : 0);
+    }
+
+    for (size_t i = 0; i < n; i += 1) {
+        if (fabs(y[i]) > amax)
+            amax = fabs(y[i]);
+    }
+
+    for (size_t i = 0; i < n; i += 1)
+        x[i] = amax > 0 ? peak * y[i] / amax : 0;
+
+    free(y);
+}
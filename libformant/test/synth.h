@@ -0,0 +1,19 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef TEST_SYNTH_H
+#define TEST_SYNTH_H
+
+#include <stddef.h>
+
+#include "formant.h"
+
+// Synthesize n samples of a steady voice at the given sample rate into x: a
+// pulse train at F0 f0 through a cascade of n_res two-pole resonators at the
+// frequencies freq with the bandwidths band, all in Hz, scaled so its peak is
+// at the given amplitude.
+void synth_voice(formant_sample_t *x, size_t n, size_t sample_rate, double f0,
+                 const double *freq, const double *band, size_t n_res,
+                 double peak);
+
+#endif
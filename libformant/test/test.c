@@ -1,11 +1,27 @@
 #include "greatest.h"
 
 extern SUITE(formant_suite);
+extern SUITE(batch_suite);
+extern SUITE(kernels_suite);
+extern SUITE(resample_suite);
+extern SUITE(fir_suite);
+extern SUITE(processing_suite);
+extern SUITE(pitch_suite);
+extern SUITE(vad_suite);
+extern SUITE(workspace_suite);
 
 GREATEST_MAIN_DEFS();
 
 int main(int argc, char **argv) {
     GREATEST_MAIN_BEGIN();
     GREATEST_RUN_SUITE(formant_suite);
+    GREATEST_RUN_SUITE(batch_suite);
+    GREATEST_RUN_SUITE(kernels_suite);
+    GREATEST_RUN_SUITE(resample_suite);
+    GREATEST_RUN_SUITE(fir_suite);
+    GREATEST_RUN_SUITE(processing_suite);
+    GREATEST_RUN_SUITE(pitch_suite);
+    GREATEST_RUN_SUITE(vad_suite);
+    GREATEST_RUN_SUITE(workspace_suite);
     GREATEST_MAIN_END();
 }
@@ -0,0 +1,34 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <stddef.h>
+
+#include "formant.h"
+#include "workspace.h"
+
+// The stages of formant_tracker_push, for driving several trackers in
+// lockstep: fill every tracker, analyse each ready frame across all of them,
+// and then finish every tracker.
+
+// Filter the n_samples new samples into the given tracker and return the
+// number of frames that are now ready for analysis. The tracker's stats are
+// cleared as for a push.
+size_t tracker_fill(formant_tracker_t *t, const formant_sample_t *samples,
+                    size_t n_samples);
+
+// Analyse the i'th ready frame of each of the n trackers, which must have the
+// same options and sample rate and be filled alike. Their windowing,
+// autocorrelation, and AR coefficients are worked out a vector lane per
+// tracker, with scratch and stats taken from the given workspace, and the rest
+// as each tracker would on its own. Frames must be analysed in order.
+void tracker_lanes(formant_tracker_t *const *t, size_t n, size_t i,
+                   formant_workspace_t *ws);
+
+// Decide the frames as formant_tracker_push does, once every ready frame has
+// been analysed.
+size_t tracker_finish(formant_tracker_t *t, const formant_frame_t **frames);
+
+#endif
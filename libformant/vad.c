@@ -0,0 +1,152 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "kernels.h"
+#include "vad.h"
+
+#ifdef LIBFORMANT_TEST
+#include <stdint.h>
+
+#include "greatest.h"
+#include "synth.h"
+#endif
+
+#define PI 3.14159265358979323846
+
+// Frames that cross zero more often than this, as a fraction of their samples,
+// are taken to be fricatives. Vowels stay well below it even with no spectral
+// tilt at all.
+static const double VAD_ZCR = 0.6;
+
+// Frames whose spectrum is flatter than this are taken to be noise.
+static const double VAD_FLATNESS = 0.5;
+
+// Order of the linear predictor the flatness is measured by. Four poles fit
+// the first two formants, however far apart.
+enum { VAD_ORDER = 4 };
+
+// Get the error left by the linear predictor of order VAD_ORDER fit to the
+// autocorrelation lags r, relative to the energy r[0], which must be positive.
+static double durbin_err(const double *r) {
+    double a[VAD_ORDER + 1] = {1}, tmp[VAD_ORDER + 1], err = r[0];
+
+    for (size_t i = 1; i <= VAD_ORDER; i += 1) {
+        double k = r[i];
+
+        for (size_t j = 1; j < i; j += 1)
+            k += a[j] * r[i - j];
+
+        k = -k / err;
+
+        for (size_t j = 1; j < i; j += 1)
+            tmp[j] = a[j] + k * a[i - j];
+
+        for (size_t j = 1; j < i; j += 1)
+            a[j] = tmp[j];
+
+        a[i] = k;
+        err *= 1 - k * k;
+
+        if (err <= 0)
+            return 0;
+    }
+
+    return err / r[0] > 1 ? 1 : err / r[0];
+}
+
+void vad_measure(formant_workspace_t *ws, const short *x, size_t n, vad_t *v) {
+    const kern_impl_t *kern = kern_best();
+    double *d, r[VAD_ORDER + 1];
+
+    *v = (vad_t) { .zcr = 0, .flatness = 1 };
+
+    if (n <= VAD_ORDER)
+        return;
+
+    // Widen the samples first, so the whole frame is handled a vector at a
+    // time.
+    d = formant_workspace_alloc(ws, sizeof(double) * n);
+    kern->widen(x, d, n);
+
+    for (size_t i = 0; i <= VAD_ORDER; i += 1)
+        r[i] = kern->dot(d, d + i, n - i);
+
+    v->rms = sqrt(r[0] / n);
+
+    if (r[0] == 0)
+        return;
+
+    // Count on the crossings of a Gaussian signal with the same spectrum,
+    // which follow from the first lag, rather than comparing every pair of
+    // samples.
+    v->zcr = acos(r[1] / r[0] < -1 ? -1 : r[1] / r[0]) / PI;
+    v->flatness = durbin_err(r);
+}
+
+bool vad_is_voiced(const vad_t *v, double floor) {
+    return v->rms >= floor && v->zcr < VAD_ZCR && v->flatness < VAD_FLATNESS;
+}
+
+#ifdef LIBFORMANT_TEST
+TEST test_vad() {
+    enum { RATE = 10000, N = 490 };
+    formant_workspace_t ws;
+    short x[N];
+    static const double formants[] = {500, 1500}, band[] = {100, 100};
+    uint32_t seed = 7;
+    vad_t v;
+
+    formant_workspace_init(&ws);
+
+    // A vowel: a pulse train through resonators at 500Hz and 1500Hz.
+    synth_voice(x, N, RATE, 120, formants, band, 2, 8000);
+
+    vad_measure(&ws, x, N, &v);
+    GREATEST_ASSERT(v.rms > 100);
+    GREATEST_ASSERT(vad_is_voiced(&v, 100));
+    GREATEST_ASSERT(!vad_is_voiced(&v, v.rms * 2));
+
+    // White noise is flat.
+    for (size_t i = 0; i < N; i += 1) {
+        seed = seed * 1664525 + 1013904223;
+        x[i] = (int)(seed >> 20) - 2048;
+    }
+
+    vad_measure(&ws, x, N, &v);
+    GREATEST_ASSERT(v.rms > 100);
+    GREATEST_ASSERT(v.flatness > 0.8);
+    GREATEST_ASSERT(!vad_is_voiced(&v, 100));
+
+    // A hiss near the Nyquist frequency isn't flat, but crosses zero at
+    // nearly every sample.
+    for (size_t i = 0; i < N; i += 1)
+        x[i] = (i % 2 ? 1000 : -1000) + (int)(i % 7) * 20;
+
+    vad_measure(&ws, x, N, &v);
+    GREATEST_ASSERT(v.zcr > 0.9);
+    GREATEST_ASSERT(!vad_is_voiced(&v, 100));
+
+    // Silence, and a frame too short to measure.
+    for (size_t i = 0; i < N; i += 1)
+        x[i] = 0;
+
+    vad_measure(&ws, x, N, &v);
+    GREATEST_ASSERT_EQ(v.rms, 0);
+    GREATEST_ASSERT(!vad_is_voiced(&v, 100));
+
+    vad_measure(&ws, x, 2, &v);
+    GREATEST_ASSERT(!vad_is_voiced(&v, 0));
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+SUITE(vad_suite) {
+    RUN_TEST(test_vad);
+}
+#endif
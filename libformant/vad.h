@@ -0,0 +1,36 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "workspace.h"
+
+// Measures of one frame of audio that tell voiced speech from silence and
+// noise.
+typedef struct {
+    // RMS amplitude of the frame, which is taken to have no DC offset.
+    double rms;
+    // Fraction of neighbouring samples that differ in sign, as expected of a
+    // Gaussian signal with the spectrum of the frame. Voiced speech is led by
+    // its lowest formants and crosses zero rarely, while fricatives cross it
+    // at most samples.
+    double zcr;
+    // Flatness of the spectrum, from 0 for a pure tone to 1 for white noise,
+    // taken as the error left by a low-order linear predictor relative to the
+    // energy of the frame.
+    double flatness;
+} vad_t;
+
+// Measure the n samples at x, which should be highpassed, and store the result
+// in v. Scratch is taken from the given workspace.
+void vad_measure(formant_workspace_t *ws, const short *x, size_t n, vad_t *v);
+
+// Check whether the given measures look like voiced speech, rather than
+// silence, taken as any frame quieter than the given RMS, or noise.
+bool vad_is_voiced(const vad_t *v, double floor);
+
+#endif
@@ -0,0 +1,197 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#include <stdlib.h>
+
+#include "bench.h"
+#include "workspace.h"
+
+#ifdef LIBFORMANT_TEST
+#include "greatest.h"
+#endif
+
+// Alignment of every allocation, which matches what malloc guarantees.
+enum { WS_ALIGN = 16 };
+
+#define WS_ROUND(n) (((n) + WS_ALIGN - 1) & ~(size_t)(WS_ALIGN - 1))
+
+// Header in front of every spilled allocation, in the room left for alignment.
+typedef struct ws_spill {
+    struct ws_spill *next;
+    size_t size;
+} ws_spill_t;
+
+_Static_assert(sizeof(ws_spill_t) <= WS_ALIGN, "spill header doesn't fit");
+
+// Seed used by a freshly initialized workspace.
+static const uint64_t WS_SEED = 0x9e3779b97f4a7c15;
+
+void formant_workspace_init(formant_workspace_t *ws) {
+    *ws = (formant_workspace_t) {
+        .mem = NULL,
+        .size = 0,
+        .used = 0,
+        .spill = NULL,
+        .spill_size = 0,
+        .peak = 0,
+    };
+
+    formant_workspace_seed(ws, WS_SEED);
+}
+
+// Free the spilled allocations made since the given one was, which is NULL for
+// all of them. Spilled memory is listed newest first, so these are the ones
+// ahead of it.
+static void free_spill(formant_workspace_t *ws, void *until) {
+    ws_spill_t *next;
+
+    for (ws_spill_t *p = ws->spill; p != until; p = next) {
+        next = p->next;
+        ws->spill_size -= p->size;
+        free(p);
+    }
+
+    ws->spill = until;
+}
+
+void formant_workspace_destroy(formant_workspace_t *ws) {
+    free_spill(ws, NULL);
+    free(ws->mem);
+}
+
+void formant_workspace_reset(formant_workspace_t *ws) {
+    free_spill(ws, NULL);
+
+    // Grow the block so everything fits next time. Allocations are released
+    // newest first, so the most ever held at once fits in a block of that
+    // size.
+    if (ws->peak > ws->size) {
+        free(ws->mem);
+        ws->size = ws->peak;
+        ws->mem = malloc(ws->size);
+        BENCH_ALLOC();
+
+        if (!ws->mem)
+            ws->size = 0;
+    }
+
+    ws->used = 0;
+    ws->peak = 0;
+}
+
+void formant_workspace_reserve(formant_workspace_t *ws, size_t size) {
+    formant_workspace_reset(ws);
+
+    if (ws->size >= size)
+        return;
+
+    free(ws->mem);
+    ws->size = WS_ROUND(size);
+    ws->mem = malloc(ws->size);
+    BENCH_ALLOC();
+
+    if (!ws->mem)
+        ws->size = 0;
+}
+
+void *formant_workspace_alloc(formant_workspace_t *ws, size_t size) {
+    ws_spill_t *p;
+
+    size = WS_ROUND(size);
+
+    if (ws->used + size <= ws->size) {
+        void *q = ws->mem + ws->used;
+
+        ws->used += size;
+
+        if (ws->used + ws->spill_size > ws->peak)
+            ws->peak = ws->used + ws->spill_size;
+
+        return q;
+    }
+
+    p = malloc(size + WS_ALIGN);
+    BENCH_ALLOC();
+    *p = (ws_spill_t) { .next = ws->spill, .size = size };
+    ws->spill = p;
+    ws->spill_size += size;
+
+    if (ws->used + ws->spill_size > ws->peak)
+        ws->peak = ws->used + ws->spill_size;
+
+    return (char *) p + WS_ALIGN;
+}
+
+formant_workspace_mark_t formant_workspace_mark(const formant_workspace_t *ws) {
+    return (formant_workspace_mark_t) {
+        .used = ws->used,
+        .spill = ws->spill,
+    };
+}
+
+void formant_workspace_release(formant_workspace_t *ws,
+                               formant_workspace_mark_t mark)
+{
+    // The most held at once is kept in peak, so the block still grows to fit
+    // at the next reset.
+    free_spill(ws, mark.spill);
+    ws->used = mark.used;
+}
+
+void formant_workspace_seed(formant_workspace_t *ws, uint64_t seed) {
+    // The generator gets stuck at zero, so steer clear of it.
+    ws->rng = seed ? seed : WS_SEED;
+}
+
+// This is xorshift64*, which is fast and plenty random for dithering.
+double formant_workspace_rand(formant_workspace_t *ws) {
+    uint64_t x = ws->rng;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    ws->rng = x;
+
+    // Use the top 53 bits to fill the mantissa.
+    return (x * UINT64_C(0x2545f4914f6cdd1d) >> 11) * (1.0 / (UINT64_C(1) << 53));
+}
+
+#ifdef LIBFORMANT_TEST
+TEST test_workspace_release() {
+    enum { ROUNDS = 1000, N = 10 };
+    formant_workspace_t ws;
+
+    formant_workspace_init(&ws);
+
+    // Memory released within a calculation is only counted while it's held,
+    // however many times it's taken again.
+    for (size_t k = 0; k < 3; k += 1) {
+        formant_workspace_reset(&ws);
+        formant_workspace_alloc(&ws, 1000);
+
+        for (size_t r = 0; r < ROUNDS; r += 1) {
+            formant_workspace_mark_t mark = formant_workspace_mark(&ws);
+
+            for (size_t i = 0; i < N; i += 1)
+                GREATEST_ASSERT(formant_workspace_alloc(&ws, 100 + r % 7));
+
+            formant_workspace_release(&ws, mark);
+            GREATEST_ASSERT_EQ(ws.used + ws.spill_size, 1008);
+        }
+
+        GREATEST_ASSERT(ws.size <= 1008 + N * 112);
+    }
+
+    // Once grown, the block holds everything.
+    GREATEST_ASSERT_EQ(ws.spill, NULL);
+    GREATEST_ASSERT(ws.size >= 1008 + N * 112);
+
+    formant_workspace_destroy(&ws);
+
+    PASS();
+}
+
+SUITE(workspace_suite) {
+    RUN_TEST(test_workspace_release);
+}
+#endif
@@ -0,0 +1,81 @@
+// Copyright 2014 Formant Industries. See the Copying file at the top-level
+// directory of this project.
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+// Scratch memory used while calculating formants. Allocations are carved out
+// of a single block and are all released at once by formant_workspace_reset.
+// If a calculation needs more memory than the block holds, the extra is taken
+// from the heap and the block is grown at the next reset, so a workspace that
+// is reused for similar calculations stops allocating altogether.
+typedef struct {
+    // The block allocations are carved from.
+    char *mem;
+    // Size of the block in bytes.
+    size_t size;
+    // Number of bytes of the block currently handed out.
+    size_t used;
+
+    // Memory that didn't fit in the block since the last reset, as a list
+    // linked through the first word of each allocation.
+    void *spill;
+    // Total size of the spilled memory in bytes.
+    size_t spill_size;
+    // Most bytes held at once since the last reset, in the block and spilled
+    // together, which the block is grown to at the next reset.
+    size_t peak;
+
+    // State of the random number generator used for dithering and restarting
+    // root searches.
+    uint64_t rng;
+
+    // What went on during the calculations made with the workspace.
+    formant_stats_t stats;
+} formant_workspace_t;
+
+// Initialize the given workspace to an empty state.
+void formant_workspace_init(formant_workspace_t *ws);
+
+// Release the memory held by the given workspace.
+void formant_workspace_destroy(formant_workspace_t *ws);
+
+// Release every allocation made from the given workspace.
+void formant_workspace_reset(formant_workspace_t *ws);
+
+// Release every allocation made from the given workspace, as reset does, and
+// make sure its block holds at least size bytes, so calculations known to need
+// that much never touch the heap.
+void formant_workspace_reserve(formant_workspace_t *ws, size_t size);
+
+// Allocate size bytes from the given workspace. The memory remains valid until
+// the next reset.
+void *formant_workspace_alloc(formant_workspace_t *ws, size_t size);
+
+// A point in the sequence of allocations made from a workspace.
+typedef struct {
+    size_t used;
+    void *spill;
+} formant_workspace_mark_t;
+
+// Get the current point in the allocations made from the given workspace.
+formant_workspace_mark_t formant_workspace_mark(const formant_workspace_t *ws);
+
+// Release every allocation made from the given workspace since the given mark
+// was taken, leaving the earlier ones alone.
+void formant_workspace_release(formant_workspace_t *ws,
+                               formant_workspace_mark_t mark);
+
+// Restart the random number sequence of the given workspace from the given
+// seed. Resetting the workspace leaves the sequence alone.
+void formant_workspace_seed(formant_workspace_t *ws, uint64_t seed);
+
+// Get the next random number in [0, 1) from the given workspace.
+double formant_workspace_rand(formant_workspace_t *ws);
+
+#endif
@@ -105,6 +105,9 @@ int main(int argc, char **argv) {
     sound_t sound;
     sound_init(&sound);
 
+    formant_workspace_t ws;
+    formant_workspace_init(&ws);
+
     system("tput civis");
 
     unsigned long long sumx, sumy;
@@ -115,7 +118,7 @@ int main(int argc, char **argv) {
     for (size_t s = 0; n_samples - s >= N_SAMPLES; s += N_SAMPLES) {
         sound_reset(&sound, SAMPLE_RATE, N_CHANNELS);
         sound_load_samples(&sound, &mem[s], N_SAMPLES);
-        sound_calc_formants(&sound, &opts);
+        sound_calc_formants(&sound, &opts, &ws);
 
         for (size_t i = 0; i < sound.n_samples; i += 1) {
             formant_sample_t f1 = sound_get_sample(&sound, 0, i);
@@ -134,5 +137,6 @@ int main(int argc, char **argv) {
     system("tput cnorm");
 
     sound_destroy(&sound);
+    formant_workspace_destroy(&ws);
 }
 